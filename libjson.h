@@ -15,6 +15,11 @@ extern "C" {
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 /*~ Data Structures ~*/
 
@@ -32,14 +37,49 @@ typedef enum JSONType {
 
 typedef struct JSONElement JSONElement;
 typedef struct JSONPair JSONPair;
+typedef struct JSONRecord JSONRecord;
+
+/**
+ * Storage flags of json values and containers.
+ */
+#define LIBJSON_INTEGER 0x1 /**< The number is held in @c integer rather than @c number. */
+#define LIBJSON_CACHED  0x2 /**< The container's output is held in a JSONCache, and it hasn't been modified since. */
+#define LIBJSON_PACKED  0x4 /**< The array holds only numbers, in @c doubles, or in @c integers with LIBJSON_INTEGER. */
+#define LIBJSON_SHAPED  0x8 /**< The object's keys are held in a JSONShape shared with other objects, and its values in @c record. */
+#define LIBJSON_INLINE  0x10 /**< The string, or raw number, is held in @c inlined rather than in its own allocation. */
+#define LIBJSON_RAW     0x20 /**< The number is held as its json text, in @c inlined or @c string, and only converted when read. */
+#define LIBJSON_ARENA   0x40 /**< The container and everything within it, or the string or raw number, is held in a JSONParser's arena and is read only. */
+#define LIBJSON_POOLED  0x80 /**< The string, or raw number, was allocated by libjson in a size class, and can go back to the JSONPool. */
+#define LIBJSON_INTERNED 0x100 /**< The string follows a JSONInterned, and is shared with every equal value parsed by the same parser. */
+#define LIBJSON_COMPACT 0x200 /**< The container's storage, or the string, is held in a JSONCompact block by o_compact or a_compact. */
+
+/**
+ * Strings shorter than this (including the null terminator) are held within the value itself.
+ */
+#define LIBJSON_INLINE_LENGTH 16
+
+/*
+ * Define LIBJSON_ESCAPE_UNICODE before including libjson.h to write characters
+ * outside of ASCII as \\u escapes, rather than as UTF-8.
+ *
+ * Define LIBJSON_VALIDATE_UTF8 before including libjson.h to replace invalid
+ * UTF-8 in parsed strings with U+FFFD.
+ *
+ * Define LIBJSON_POOL before including libjson.h to keep the memory freed by
+ * destroying json in per-thread free lists, which later json is built from.
+ */
 
 /**
  * A json object.
  * {}
  */ 
 typedef struct JSONObject {
-    JSONPair* elements;   /**< A sequence of key/value pairs. */
+    union {
+        JSONPair* elements; /**< A sequence of key/value pairs, unless the object is LIBJSON_SHAPED. */
+        JSONRecord* record; /**< The object's keys and values, if it's LIBJSON_SHAPED. */
+    };
     int numberOfElements; /**< How many key/value pairs the object has. */
+    int flags;            /**< LIBJSON_* container flags. */
 } JSONObject;
 
 /**
@@ -47,30 +87,43 @@ typedef struct JSONObject {
  * []
  */
 typedef struct JSONArray {
-    JSONElement* elements; /**< A sequence of values within the array. */
+    union {
+        JSONElement* elements; /**< A sequence of values within the array, unless it's LIBJSON_PACKED. */
+        double* doubles;       /**< The values, if the array is LIBJSON_PACKED without LIBJSON_INTEGER. */
+        int64_t* integers;     /**< The values, if the array is LIBJSON_PACKED with LIBJSON_INTEGER. */
+    };
     int numberOfElements;  /**< How many values the array has. */
+    int flags;             /**< LIBJSON_* container flags. */
 } JSONArray;
 
 /**
  * A boolean.
  * true / false
  */
+#ifndef __cplusplus
 typedef enum bool {
     false, /**< False */
     true   /**< True  */
 } bool;
+#endif
 
 /**
  * The value of a member contained in json.
+ * Only the member matching @c type (and @c flags, for numbers) is meaningful.
  */
 typedef struct JSONElement {
-    JSONType type;     /**< The data type of the value. */
-
-    JSONObject object;  /**< The value, if the type is an object. {} */
-    JSONArray array;    /**< The value, if the type is an array. [] */
-    bool boolean;       /**< The value, if the type is a boolean. true/false */
-    long double number; /**< The value, if the type is a number (integer or double). 3.14 */
-    char* string;       /**< The value, if the type is a string (not including quotes). "" */
+    JSONType type; /**< The data type of the value. */
+    int flags;     /**< How the value is stored. LIBJSON_* storage flags. */
+
+    union {
+        JSONObject object; /**< The value, if the type is an object. {} */
+        JSONArray array;   /**< The value, if the type is an array. [] */
+        bool boolean;      /**< The value, if the type is a boolean. true/false */
+        double number;     /**< The value, if the type is a number without LIBJSON_INTEGER. 3.14 */
+        int64_t integer;   /**< The value, if the type is a number with LIBJSON_INTEGER. 42 */
+        char* string;      /**< The value, if the type is a string without LIBJSON_INLINE (not including quotes). "" */
+        char inlined[LIBJSON_INLINE_LENGTH]; /**< The value, if the type is a string with LIBJSON_INLINE. Use e_getString to read either. */
+    };
 } JSONElement;
 
 /**
@@ -82,6 +135,361 @@ typedef struct JSONPair {
     JSONElement value; /**< The pair's value. **/
 } JSONPair;
 
+/**
+ * The keys of objects which have the same keys in the same order, shared between them.
+ */
+typedef struct JSONShape {
+    char** keys;      /**< The keys, in order. */
+    int numberOfKeys; /**< How many keys there are. */
+    int* table;       /**< An open-addressed table of the index+1 of each key by its hash, or 0 where unused. */
+    int capacity;     /**< How many entries @c table has space for. A power of two. */
+    int references;   /**< How many objects and parsers share the shape. */
+    uint64_t hash;    /**< A hash of every key, in order. */
+    bool plain;       /**< If no key has a backslash, so keys can be compared with json as written. */
+} JSONShape;
+
+/**
+ * The storage of a LIBJSON_SHAPED object.
+ */
+typedef struct JSONRecord {
+    JSONShape* shape;    /**< The object's keys. */
+    JSONElement* values; /**< A value for each key, in the same order, allocated along with the record. */
+} JSONRecord;
+
+/**
+ * The header of a LIBJSON_INTERNED string, which is allocated just after it.
+ * The string is read only, since the values sharing it can't see each other.
+ */
+typedef struct JSONInterned {
+    int references; /**< How many values, and parsers, share the string. */
+    int length;     /**< The string's length. */
+    uint64_t hash;  /**< A hash of the string. */
+} JSONInterned;
+
+/**
+ * The header of a block a json document was compacted into.
+ * Each container's storage and each string in the block follows a pointer back to the header.
+ * A container's keys follow its storage, and are part of it.
+ */
+typedef struct JSONCompact {
+    int references; /**< How many containers and strings still use the block. */
+} JSONCompact;
+
+/**
+ * A key to look up in many objects, which remembers where it was last found.
+ * Objects which share a shape, such as the records of an array, have it in the same place.
+ */
+typedef struct JSONSlot {
+    const char* key; /**< The key to look up. */
+    int index;       /**< Where the key was last found. */
+} JSONSlot;
+
+/**
+ * A position within a json object, for visiting its key/value pairs in order.
+ */
+typedef struct JSONObjectIterator {
+    const JSONObject* json;   /**< The object being visited. */
+    int next;                 /**< The index of the next pair to visit. */
+    const char* key;          /**< The key of the pair just visited. */
+    const JSONElement* value; /**< The value of the pair just visited. */
+} JSONObjectIterator;
+
+/**
+ * A position within a json array, for visiting its values in order.
+ */
+typedef struct JSONArrayIterator {
+    const JSONArray* json;    /**< The array being visited. */
+    int index;                /**< The index of the value just visited, or -1 before the first. */
+    const JSONElement* value; /**< The value just visited. Points to @c scratch if the array is packed. */
+    JSONElement scratch;      /**< Where a value of a packed array is decoded to, leaving the array as it is. */
+} JSONArrayIterator;
+
+/**
+ * A function visiting a key/value pair within a json object.
+ * 
+ * @param key     The pair's key.
+ * @param value   The pair's value.
+ * @param context The context given to o_forEach.
+ * @return True to keep visiting, false to stop.
+ */
+typedef bool (*JSONPairFunction)(const char* key, const JSONElement* value, void* context);
+
+/**
+ * A function visiting a value within a json array.
+ * 
+ * @param index   The index the value is located at.
+ * @param value   The value.
+ * @param context The context given to a_forEach.
+ * @return True to keep visiting, false to stop.
+ */
+typedef bool (*JSONElementFunction)(int index, const JSONElement* value, void* context);
+
+/**
+ * The type of every value within a column of a JSONTable.
+ */
+typedef enum JSONColumnType {
+    columnEmpty,   /**< No row has a value other than null. */
+    columnBoolean, /**< Held in @c booleans. */
+    columnInt,     /**< Held in @c integers. */
+    columnDouble,  /**< Held in @c doubles. */
+    columnString,  /**< Held in @c codes, each the index of a string in @c dictionary. */
+    columnMixed    /**< Values of different types, or objects and arrays, held in @c values. */
+} JSONColumnType;
+
+/**
+ * The values of one key, across every record of a JSONTable, stored contiguously.
+ * Rows without the key, or with a null, hold 0 in the typed storage.
+ */
+typedef struct JSONColumn {
+    char* key;           /**< The key the values are paired with. */
+    JSONColumnType type; /**< Which storage holds the values. */
+    uint64_t* present;   /**< A bit for each row, set if the row has the key. */
+    uint64_t* nulls;     /**< A bit for each row, set if the row's value is null. */
+
+    union {
+        bool* booleans;      /**< The values, if the type is columnBoolean. */
+        int64_t* integers;   /**< The values, if the type is columnInt. */
+        double* doubles;     /**< The values, if the type is columnDouble. */
+        int* codes;          /**< The values, if the type is columnString. */
+        JSONElement* values; /**< The values, if the type is columnMixed. */
+    };
+
+    char** dictionary;       /**< Each distinct string of a columnString column, once. */
+    int dictionarySize;      /**< How many strings @c dictionary has. */
+} JSONColumn;
+
+/**
+ * An array of records stored a column per key, rather than an object per record.
+ */
+typedef struct JSONTable {
+    JSONColumn* columns; /**< A column for each key, in the order they first appear. */
+    int numberOfColumns; /**< How many columns there are. */
+    int numberOfRows;    /**< How many records there are. */
+} JSONTable;
+
+/**
+ * A growable string used while serializing.
+ */
+typedef struct JSONBuffer {
+    char* data;   /**< The characters written so far, not null terminated. */
+    int length;   /**< How many characters have been written. */
+    int capacity; /**< How many characters @c data has space for. */
+} JSONBuffer;
+
+/**
+ * A tree of the keys to keep while parsing only part of a json object.
+ */
+typedef struct JSONProjection {
+    char* key;                         /**< The key this node keeps, or NULL for the root. */
+    struct JSONProjection* children;   /**< The keys to keep within this node's value. */
+    int numberOfChildren;              /**< How many keys are kept within this node's value. */
+    bool whole;                        /**< If this node's value is kept whole. */
+} JSONProjection;
+
+/**
+ * The serialized output of one container, held by a JSONCache.
+ */
+typedef struct JSONCacheEntry {
+    const void* elements;  /**< The storage of the container the output belongs to, or NULL if unused. */
+    char* text;            /**< The container's output. */
+    int length;            /**< How many characters @c text has. */
+    unsigned generation;   /**< The serialization the entry was last used by. */
+} JSONCacheEntry;
+
+/**
+ * Serialized output of containers, kept between serializations of a document
+ * so unmodified subtrees can be copied instead of converted again.
+ */
+typedef struct JSONCache {
+    JSONCacheEntry* entries; /**< An open-addressed table of cached output. */
+    int capacity;            /**< How many entries the table has space for. A power of two. */
+    int numberOfEntries;     /**< How many entries are in use. */
+    unsigned generation;     /**< How many serializations have used the cache. */
+} JSONCache;
+
+/**
+ * A function receiving the output of a JSONWriter.
+ * 
+ * @param data    The characters written, not null terminated.
+ * @param length  How many characters there are.
+ * @param context The context given when the writer was created.
+ */
+typedef void (*JSONWriteFunction)(const char* data, int length, void* context);
+
+/**
+ * How many characters a JSONWriter with a file or function holds before passing them on.
+ */
+#define LIBJSON_WRITER_FLUSH 4096
+
+/**
+ * Writes json directly to a string, file or function, without building JSONObjects.
+ */
+typedef struct JSONWriter {
+    JSONBuffer buffer;       /**< Characters not yet passed to @c file or @c write, or all output if neither is set. */
+    FILE* file;              /**< The file to write to, or NULL. */
+    JSONWriteFunction write; /**< The function to write to, or NULL. */
+    void* context;           /**< Passed along to @c write. */
+    int depth;               /**< How many objects and arrays are open. */
+    bool comma;              /**< If a comma is needed before the next key or value. */
+} JSONWriter;
+
+/**
+ * Minifies or pretty prints json a chunk at a time, copying strings, numbers and
+ * literals byte for byte, without parsing it into JSONObjects.
+ */
+typedef struct JSONFormatter {
+    JSONWriter* writer; /**< Where the output is written. */
+    int indent;         /**< How many spaces to indent each level by, or 0 to minify. */
+    int depth;          /**< How many objects and arrays are open. */
+    bool inString;      /**< If the next character is within a string. */
+    bool escaped;       /**< If the next character follows a backslash within a string. */
+    bool open;          /**< If an object or array was just opened, and nothing is in it yet. */
+} JSONFormatter;
+
+/**
+ * The deepest objects and arrays may be nested.
+ * Define LIBJSON_MAX_DEPTH before including libjson.h to change it.
+ */
+#ifndef LIBJSON_MAX_DEPTH
+#define LIBJSON_MAX_DEPTH 1024
+#endif
+
+/**
+ * The longest string value a JSONParser interns by default.
+ * Change @c internLength of a parser to choose another cutoff.
+ */
+#define LIBJSON_INTERN_LENGTH 64
+
+/**
+ * How many different strings a JSONParser interns, so that strings which don't repeat can't grow it without bound.
+ * Later strings are allocated as usual.
+ * Define LIBJSON_INTERN_LIMIT before including libjson.h to change it.
+ */
+#ifndef LIBJSON_INTERN_LIMIT
+#define LIBJSON_INTERN_LIMIT 4096
+#endif
+
+/**
+ * How many different shapes a JSONParser shares in one parse, so that objects whose keys don't repeat
+ * can't grow it without bound. Later objects with new keys are left as they are.
+ * Define LIBJSON_SHAPE_LIMIT before including libjson.h to change it.
+ */
+#ifndef LIBJSON_SHAPE_LIMIT
+#define LIBJSON_SHAPE_LIMIT 4096
+#endif
+
+/**
+ * How many size classes a JSONPool has. Class k holds blocks of 16 << k bytes, and larger blocks aren't pooled.
+ */
+#define LIBJSON_POOL_CLASSES 16
+
+/**
+ * How many bytes of free blocks a JSONPool keeps in each size class, so memory use stays bounded.
+ * Define LIBJSON_POOL_LIMIT before including libjson.h to change it.
+ */
+#ifndef LIBJSON_POOL_LIMIT
+#define LIBJSON_POOL_LIMIT (1 << 20)
+#endif
+
+/**
+ * Freed blocks of memory kept for reuse by one thread, with LIBJSON_POOL.
+ */
+typedef struct JSONPool {
+    void* blocks[LIBJSON_POOL_CLASSES]; /**< The free blocks of each class, each linked to the next through its first bytes. */
+    int sizes[LIBJSON_POOL_CLASSES];    /**< How many bytes of free blocks each class holds. */
+} JSONPool;
+
+/**
+ * What made json invalid.
+ */
+typedef enum JSONErrorKind {
+    errorNone,                /**< The json is valid. */
+    errorUnexpectedEnd,       /**< The json ended before a value, string, object or array was complete. */
+    errorUnexpectedCharacter, /**< A character which can't appear where it did. */
+    errorInvalidNumber,       /**< A number which doesn't follow the grammar. e.g. 01, 1., -e2 */
+    errorInvalidLiteral,      /**< A misspelt true, false or null. */
+    errorInvalidEscape,       /**< An unknown escape sequence in a string. */
+    errorControlCharacter,    /**< An unescaped control character in a string. */
+    errorInvalidUTF8,         /**< A string which isn't valid UTF-8. */
+    errorTooDeep,             /**< Objects and arrays nested deeper than LIBJSON_MAX_DEPTH. */
+    errorTrailingCharacters,  /**< Something other than whitespace after the value. */
+    errorRead,                /**< The json couldn't be read from where it's stored. */
+    errorOutOfMemory          /**< The document being built couldn't be allocated. */
+} JSONErrorKind;
+
+/**
+ * Why, and where, json is invalid.
+ */
+typedef struct JSONError {
+    JSONErrorKind kind; /**< What made the json invalid, or errorNone. */
+    int offset;         /**< The index of the character the error was found at. */
+} JSONError;
+
+/**
+ * A container being visited while walking a json tree without recursion.
+ */
+typedef struct JSONFrame {
+    JSONElement* element;       /**< The object or array being visited. */
+    char* key;                  /**< The key of the next value, while parsing an object. */
+    int next;                   /**< The index of the next value to visit. */
+    int start;                  /**< Where the container's output starts, while serializing. */
+    JSONShape* shape;           /**< While parsing, the shape an object's keys are expected to follow,
+                                     or the shape of the last object within an array. */
+    JSONProjection* projection; /**< While parsing only some values, the keys to keep within the container. */
+} JSONFrame;
+
+/**
+ * The containers enclosing the value being visited, innermost last.
+ */
+typedef struct JSONStack {
+    JSONFrame* frames; /**< The enclosing containers. */
+    int depth;         /**< How many containers are open. */
+    int capacity;      /**< How many frames @c frames has space for. */
+} JSONStack;
+
+/**
+ * The smallest block of memory a JSONArena allocates.
+ */
+#define LIBJSON_ARENA_BLOCK 16384
+
+/**
+ * Blocks of memory which documents are built in, handed out in order and reused from the start by each parse.
+ */
+typedef struct JSONArena {
+    char** blocks;      /**< The blocks, each at least LIBJSON_ARENA_BLOCK bytes. */
+    int* sizes;         /**< How many bytes each block has. */
+    int numberOfBlocks; /**< How many blocks there are. */
+    int block;          /**< The block being allocated from. */
+    int used;           /**< How many bytes of that block have been handed out. */
+    char* last;         /**< The most recent allocation, which can grow in place. */
+} JSONArena;
+
+/**
+ * Parses json without recursion, keeping its stack between uses.
+ */
+typedef struct JSONParser {
+    int maxDepth;            /**< The deepest objects and arrays may be nested. */
+    bool pack;               /**< If arrays of only numbers are parsed into LIBJSON_PACKED storage. */
+    bool share;              /**< If objects with the same keys are parsed into LIBJSON_SHAPED storage. */
+    bool raw;                /**< If numbers are kept as their json text (LIBJSON_RAW), and written back out unchanged. */
+    bool reuse;              /**< If documents are built in @c arena (LIBJSON_ARENA), which each parse reuses. */
+    bool intern;             /**< If string values up to @c internLength long are shared by equal values (LIBJSON_INTERNED).
+                                  Interned strings are read only, even though o_getString, a_getString and e_getString
+                                  return them as char*, since writing to one changes every value sharing it.
+                                  Their reference counts aren't atomic, so documents from the same parser must not
+                                  be copied or destroyed on different threads at the same time. */
+    int internLength;        /**< The longest string value which is interned. */
+    JSONStack stack;         /**< The containers being built. */
+    JSONArena arena;         /**< The memory documents are built in, with @c reuse. */
+    JSONShape** shapes;      /**< An open-addressed table of the shapes found by the current parse. */
+    int numberOfShapes;      /**< How many shapes the table holds. */
+    int shapeCapacity;       /**< How many shapes the table has space for. A power of two. */
+    JSONInterned** interned; /**< An open-addressed table of the strings interned so far, kept until the parser is destroyed. */
+    int numberOfInterned;    /**< How many strings the table holds. */
+    int internCapacity;      /**< How many strings the table has space for. A power of two. */
+    JSONError error;         /**< Why the last parse failed, or errorNone. */
+} JSONParser;
+
 /*~ Interface ~*/
 
 /*=============================================================================
@@ -96,44 +504,71 @@ void o_destroyJSONObject(JSONObject* json);
 
 // -- To String --
 char* o_JSONObjectToString(JSONObject json);
+char* o_JSONObjectToCachedString(JSONObject* json, JSONCache* cache);
 
 // -- Parser --
 JSONObject o_parseJSONObject(char* string);
+JSONObject o_parseJSONObjectFields(char* string, char** paths, int numberOfPaths);
 
 // -- Check --
-bool o_has(JSONObject json, char* key);
-bool o_isJSONObject(JSONObject json, char* key);
-bool o_isJSONArray(JSONObject json, char* key);
-bool o_isBoolean(JSONObject json, char* key);
-bool o_isInt(JSONObject json, char* key);
-bool o_isDouble(JSONObject json, char* key);
-bool o_isString(JSONObject json, char* key);
-bool o_isNull(JSONObject json, char* key);
+bool o_has(JSONObject json, const char* key);
+bool o_isJSONObject(JSONObject json, const char* key);
+bool o_isJSONArray(JSONObject json, const char* key);
+bool o_isBoolean(JSONObject json, const char* key);
+bool o_isInt(JSONObject json, const char* key);
+bool o_isDouble(JSONObject json, const char* key);
+bool o_isString(JSONObject json, const char* key);
+bool o_isNull(JSONObject json, const char* key);
 
 // -- Accessors --
-JSONObject  o_getJSONObject(JSONObject json, char* key);
-JSONArray   o_getJSONArray(JSONObject json, char* key);
-bool        o_getBoolean(JSONObject json, char* key);
-long        o_getInt(JSONObject json, char* key);
-long double o_getDouble(JSONObject json, char* key);
-char*       o_getString(JSONObject json, char* key);
-
-JSONObject  o_optJSONObject(JSONObject json, char* key, JSONObject dflt);
-JSONArray   o_optJSONArray(JSONObject json, char* key, JSONArray dflt);
-bool        o_optBoolean(JSONObject json, char* key, bool dflt);
-long        o_optInt(JSONObject json, char* key, long dflt);
-long double o_optDouble(JSONObject json, char* key, long double dflt);
-char*       o_optString(JSONObject json, char* key, char* dflt);
+JSONObject  o_getJSONObject(JSONObject json, const char* key);
+JSONArray   o_getJSONArray(JSONObject json, const char* key);
+bool        o_getBoolean(JSONObject json, const char* key);
+long        o_getInt(JSONObject json, const char* key);
+long double o_getDouble(JSONObject json, const char* key);
+char*       o_getString(JSONObject json, const char* key);
+
+JSONObject  o_optJSONObject(JSONObject json, const char* key, JSONObject dflt);
+JSONArray   o_optJSONArray(JSONObject json, const char* key, JSONArray dflt);
+bool        o_optBoolean(JSONObject json, const char* key, bool dflt);
+long        o_optInt(JSONObject json, const char* key, long dflt);
+long double o_optDouble(JSONObject json, const char* key, long double dflt);
+char*       o_optString(JSONObject json, const char* key, char* dflt);
+
+// -- References --
+JSONElement*       o_ref(JSONObject* json, const char* key);
+const JSONElement* o_cref(const JSONObject* json, const char* key);
+
+JSONSlot           o_slot(const char* key);
+const JSONElement* o_crefSlot(const JSONObject* json, JSONSlot* slot);
+
+// -- Iteration --
+JSONObjectIterator o_iterate(const JSONObject* json);
+bool               o_next(JSONObjectIterator* iterator);
+bool               o_forEach(const JSONObject* json, JSONPairFunction function, void* context);
+bool               o_forEachOfType(const JSONObject* json, JSONType type, JSONPairFunction function, void* context);
 
 // -- Mutators --
-void o_setJSONObject(JSONObject* json, char* key, JSONObject set);
-void o_setJSONArray(JSONObject* json, char* key, JSONArray set);
-void o_setBoolean(JSONObject* json, char* key, bool set);
-void o_setInt(JSONObject* json, char* key, long set);
-void o_setDouble(JSONObject* json, char* key, long double set);
-void o_setString(JSONObject* json, char* key, char* set);
-void o_setNull(JSONObject* json, char* key);
-void o_remove(JSONObject* json, char* key);
+void o_setJSONObject(JSONObject* json, const char* key, JSONObject set);
+void o_setJSONArray(JSONObject* json, const char* key, JSONArray set);
+void o_setBoolean(JSONObject* json, const char* key, bool set);
+void o_setInt(JSONObject* json, const char* key, long set);
+void o_setDouble(JSONObject* json, const char* key, long double set);
+void o_setString(JSONObject* json, const char* key, const char* set);
+void o_setNull(JSONObject* json, const char* key);
+void o_remove(JSONObject* json, const char* key);
+
+void        o_moveJSONElement(JSONObject* json, char* key, JSONElement set);
+void        o_moveString(JSONObject* json, char* key, char* set);
+JSONElement o_take(JSONObject* json, const char* key);
+void        o_splice(JSONObject* json, const char* key, JSONObject* from, const char* fromKey);
+
+// -- Patch --
+bool o_applyPatch(JSONObject* json, JSONArray patch);
+void o_mergePatch(JSONObject* json, JSONObject patch);
+
+// -- Compaction --
+bool o_compact(JSONObject* json);
 
 /*=============================================================================
     JSONArray []
@@ -147,6 +582,7 @@ void a_destroyJSONArray(JSONArray* json);
 
 // -- To String --
 char* a_JSONArrayToString(JSONArray json);
+char* a_JSONArrayToCachedString(JSONArray* json, JSONCache* cache);
 
 // -- Parser --
 JSONArray a_parseJSONArray(char* string);
@@ -168,6 +604,10 @@ long        a_getInt(JSONArray json, int index);
 long double a_getDouble(JSONArray json, int index);
 char*       a_getString(JSONArray json, int index);
 
+bool a_getDoubles(JSONArray json, double* out);
+bool a_getFloats(JSONArray json, float* out);
+bool a_getInts(JSONArray json, int64_t* out);
+
 JSONArray   a_optJSONArray(JSONArray json, int index, JSONArray dflt);
 JSONArray   a_optJSONArray(JSONArray json, int index, JSONArray dflt);
 bool        a_optBoolean(JSONArray json, int index, bool dflt);
@@ -175,40 +615,279 @@ long        a_optInt(JSONArray json, int index, long dflt);
 long double a_optDouble(JSONArray json, int index, long double dflt);
 char*       a_optString(JSONArray json, int index, char* dflt);
 
+// -- References --
+JSONElement*       a_ref(JSONArray* json, int index);
+const JSONElement* a_cref(const JSONArray* json, int index, JSONElement* scratch);
+
+// -- Iteration --
+JSONArrayIterator a_iterate(const JSONArray* json);
+bool              a_next(JSONArrayIterator* iterator);
+bool              a_forEach(const JSONArray* json, JSONElementFunction function, void* context);
+bool              a_forEachOfType(const JSONArray* json, JSONType type, JSONElementFunction function, void* context);
+
 // -- Mutators --
 void a_setJSONObject(JSONArray* json, int index, JSONObject set);
 void a_setJSONArray(JSONArray* json, int index, JSONArray set);
 void a_setBoolean(JSONArray* json, int index, bool set);
 void a_setInt(JSONArray* json, int index, long set);
 void a_setDouble(JSONArray* json, int index, long double set);
-void a_setString(JSONArray* json, int index, char* set);
+void a_setString(JSONArray* json, int index, const char* set);
 void a_setNull(JSONArray* json, int index);
 void a_remove(JSONArray* json, int index);
 
+void        a_moveJSONElement(JSONArray* json, int index, JSONElement set);
+void        a_moveString(JSONArray* json, int index, char* set);
+JSONElement a_take(JSONArray* json, int index);
+void        a_splice(JSONArray* json, int index, JSONArray* from, int fromIndex);
+
+// -- Compaction --
+bool a_compact(JSONArray* json);
+
+/*=============================================================================
+    JSONElement
+=============================================================================*/
+
+// -- Destructor --
+void e_destroyJSONElement(JSONElement* element);
+
+// -- Check --
+bool e_isInt(const JSONElement* element);
+
+// -- Accessors --
+JSONObject  e_getJSONObject(const JSONElement* element);
+JSONArray   e_getJSONArray(const JSONElement* element);
+bool        e_getBoolean(const JSONElement* element);
+long        e_getInt(const JSONElement* element);
+long double e_getDouble(const JSONElement* element);
+char*       e_getString(const JSONElement* element);
+
+/*=============================================================================
+    JSONTable
+=============================================================================*/
+
+// -- Constructor --
+JSONTable t_fromJSONArray(JSONArray json);
+
+// -- Destructor --
+void t_destroyJSONTable(JSONTable* table);
+
+// -- To String --
+char* t_JSONTableToString(const JSONTable* table);
+void  t_write(const JSONTable* table, JSONWriter* writer);
+
+// -- Accessors --
+const JSONColumn* t_getColumn(const JSONTable* table, const char* key);
+bool              t_isPresent(const JSONColumn* column, int row);
+bool              t_isNull(const JSONColumn* column, int row);
+
+/*=============================================================================
+    JSONCache
+=============================================================================*/
+
+// -- Constructor --
+JSONCache c_emptyJSONCache(void);
+
+// -- Destructor --
+void c_destroyJSONCache(JSONCache* cache);
+
+/*=============================================================================
+    JSONWriter
+=============================================================================*/
+
+// -- Constructor --
+JSONWriter w_bufferJSONWriter(void);
+JSONWriter w_fileJSONWriter(FILE* file);
+JSONWriter w_functionJSONWriter(JSONWriteFunction write, void* context);
+
+// -- Destructor --
+void w_destroyJSONWriter(JSONWriter* writer);
+
+// -- Output --
+char* w_JSONWriterToString(JSONWriter* writer);
+void  w_flush(JSONWriter* writer);
+
+// -- Structure --
+void w_beginJSONObject(JSONWriter* writer);
+void w_endJSONObject(JSONWriter* writer);
+void w_beginJSONArray(JSONWriter* writer);
+void w_endJSONArray(JSONWriter* writer);
+void w_key(JSONWriter* writer, const char* key);
+
+// -- Values --
+void w_boolean(JSONWriter* writer, bool value);
+void w_int(JSONWriter* writer, long value);
+void w_double(JSONWriter* writer, long double value);
+void w_string(JSONWriter* writer, const char* value);
+void w_null(JSONWriter* writer);
+void w_raw(JSONWriter* writer, const char* json);
+
+/*=============================================================================
+    JSONFormatter
+=============================================================================*/
+
+// -- Constructor --
+JSONFormatter f_emptyJSONFormatter(JSONWriter* writer, int indent);
+
+// -- Formatting --
+void f_format(JSONFormatter* formatter, const char* json, int length);
+bool f_formatFile(JSONFormatter* formatter, FILE* file);
+
+/*=============================================================================
+    JSONParser
+=============================================================================*/
+
+// -- Constructor --
+JSONParser p_emptyJSONParser(void);
+
+// -- Destructor --
+void p_destroyJSONParser(JSONParser* parser);
+
+// -- Parser --
+JSONObject p_parseJSONObject(JSONParser* parser, char* string);
+JSONArray  p_parseJSONArray(JSONParser* parser, char* string);
+JSONObject p_parseJSONObjectFields(JSONParser* parser, char* string, char** paths, int numberOfPaths);
+
+/*=============================================================================
+    Validation
+=============================================================================*/
+
+// -- Check --
+JSONError   v_validate(char* str, int length);
+const char* v_errorMessage(JSONErrorKind kind);
+
+/*=============================================================================
+    JSONPool
+=============================================================================*/
+
+// -- Destructor --
+void m_drainJSONPool(void);
+
 /*~ Implementation ~*/
 
 // -- Helper functions --
 static char*       libjson_emptyString(int size);
-static char*       libjson_extendString(char* str, int additionalSize);
-static char*       libjson_extractString(char* str);
-static char*       libjson_JSONElementToString(JSONElement element);
-static char*       libjson_JSONPairToString(JSONPair pair);
-static char*       libjson_extractRaw(char* str, char open, char close);
-static char*       libjson_strcpy(char* str);
+static char*       libjson_extractString(char* str, int end);
+static int         libjson_decodeString(char* str, int end, char* s);
+static void        libjson_extractStringElement(char* str, int end, JSONElement* element, JSONArena* arena);
+static void        libjson_internStringElement(JSONParser* parser, char* str, int end, JSONElement* element);
+static void        libjson_releaseInterned(char* str);
+static void        libjson_copyStringElement(const char* str, JSONElement* element);
+static int         libjson_skipWhitespace(char* str, int i);
+static int         libjson_skipString(char* str, int i, int length);
+static int         libjson_scanString(char* str, int i, int length);
+static int         libjson_scanUTF8(const char* str, int length);
+#ifdef LIBJSON_VALIDATE_UTF8
+static char*       libjson_repairUTF8(char* str, int length);
+#endif
+static int         libjson_skipValue(char* str, int i, int length);
+static int         libjson_parseValue(char* str, int i, int length, JSONElement* element, JSONParser* parser);
+static bool        libjson_keyEquals(char* str, int start, int end, const char* key);
+static void        libjson_addProjection(JSONProjection* root, char* path);
+static void        libjson_destroyProjection(JSONProjection* projection);
+static int         libjson_project(JSONParser* parser, char* str, int i, int length, JSONProjection* projection, JSONElement* root);
+static JSONProjection* libjson_projectIndex(JSONProjection* projection, int index);
+static char*       libjson_strcpy(const char* str);
 static bool        libjson_isdigit(char c);
 static bool        libjson_isspace(char c);
-static bool        libjson_strcmp(char* s1, char* s2);
+static bool        libjson_strcmp(const char* s1, const char* s2);
 static long double libjson_floor(long double d);
-static int         libjson_strlen(char* str);
+static int         libjson_strlen(const char* str);
 static JSONElement libjson_emptyJSONElement(void);
-static JSONElement o_getJSONElement(JSONObject json, char* key);
-static JSONElement a_getJSONElement(JSONArray json, int index);
-static void        o_setJSONElement(JSONObject* json, char* key, JSONElement set);
+static JSONElement libjson_parseNumber(char* str);
+static JSONElement libjson_decodeNumber(const JSONElement* element);
+static const JSONElement* o_getJSONElement(JSONObject json, const char* key);
+static const JSONElement* a_getJSONElement(JSONArray json, int index, JSONElement* scratch);
+static void        o_setJSONElement(JSONObject* json, const char* key, JSONElement set);
+static void        libjson_movePair(JSONObject* json, char* key, JSONElement set);
 static void        a_setJSONElement(JSONArray* json, int index, JSONElement set);
-static void        libjson_destroyJSONElement(JSONElement* element);
+static const JSONElement* libjson_elementAt(const JSONArray* json, int index, JSONElement* scratch);
+static bool        libjson_unpack(JSONArray* json);
+static int         libjson_parsePacked(char* str, int i, JSONArray* json, bool raw);
+static const char* libjson_keyAt(const JSONObject* json, int index);
+static JSONElement* libjson_valueAt(const JSONObject* json, int index);
+static int         libjson_find(const JSONObject* json, const char* key);
+static uint64_t    libjson_hashKey(const char* key);
+static JSONShape*  libjson_createShape(JSONObject* json, uint64_t hash);
+static void        libjson_releaseShape(JSONShape* shape);
+static void        libjson_releaseShapes(JSONParser* parser);
+static void        libjson_ownKeys(JSONFrame* frame);
+static JSONShape*  libjson_shapeObject(JSONParser* parser, JSONFrame* frame);
+static bool        libjson_unshape(JSONObject* json);
+static int         libjson_storageSize(const JSONElement* element);
+static void        libjson_releaseStorage(int flags, void* memory, int size);
+static char*       libjson_compactAlloc(JSONCompact* block, char** cursor, int size);
+static void        libjson_compactStorage(JSONCompact* block, char** cursor, JSONElement* element);
+static bool        libjson_compact(JSONElement* root);
+static bool        libjson_uncompactObject(JSONObject* json);
+static bool        libjson_uncompactArray(JSONArray* json);
+static int         libjson_lookup(int** table, int* capacity, char** keys, int numberOfKeys, const char* key, bool add);
+static int         libjson_columnIndex(JSONTable* table, char*** keys, int** lookup, int* capacity, const char* key);
+static void        libjson_classify(JSONColumn* column, const JSONElement* value);
 static void        libjson_destroyJSONPair(JSONPair* pair);
+static JSONElement libjson_copyValue(const JSONElement* element);
+static JSONElement libjson_copyJSONElement(const JSONElement* element);
+static bool        libjson_equalValues(const JSONElement* e1, const JSONElement* e2);
+static bool        libjson_equals(const JSONElement* e1, const JSONElement* e2);
+static char*       libjson_pointerToken(char* pointer, char* token);
+static int         libjson_pointerIndex(char* token, int size);
+static JSONElement* libjson_resolvePointer(JSONElement* root, char* pointer, char* token);
+static bool        libjson_addAt(JSONElement* root, char* pointer, JSONElement set);
+static bool        libjson_detachAt(JSONElement* root, char* pointer, JSONElement* detached);
+static void        libjson_mergePatch(JSONElement* target, const JSONElement* patch);
+static void        libjson_bufferAppend(JSONBuffer* buffer, const char* str, int length);
+static void        libjson_bufferAppendString(JSONBuffer* buffer, const char* str);
+static bool        libjson_needsEscape(char c, bool unicode);
+static int         libjson_escapeScan(const char* str, int length, bool unicode);
+static int         libjson_validateString(const char* str, int i, int length, JSONError* error);
+static int         libjson_validateNumber(const char* str, int i, int length, JSONError* error);
+static int         libjson_validateWhitespace(const char* str, int i, int length);
+static int         libjson_escapeCharacter(const char* str, char* out, int* consumed);
+static int         libjson_hexValue(char* str);
+static int         libjson_encodeUTF8(unsigned codePoint, char* out);
+static JSONCacheEntry* libjson_cacheFind(JSONCache* cache, const void* elements);
+static void        libjson_cacheStore(JSONCache* cache, const void* elements, const char* text, int length);
+static JSONFrame*  libjson_push(JSONStack* stack, JSONElement* element);
+static void*       libjson_arenaAlloc(JSONArena* arena, int size);
+static void*       libjson_arenaGrow(JSONArena* arena, void* memory, int size, int newSize);
+static char*       libjson_arenaString(JSONArena* arena, char* str, int end);
+static JSONElement* libjson_arenaAppend(JSONArena* arena, JSONElement* container, char* key);
+static int         libjson_parse(JSONParser* parser, char* str, int length, JSONElement* root);
+static void        libjson_destroyTree(JSONElement* root);
+static void        libjson_appendScalar(JSONBuffer* out, const JSONElement* element);
+static void        libjson_appendTree(JSONBuffer* out, JSONElement* root, JSONCache* cache);
+static bool        libjson_appendContainer(JSONBuffer* out, JSONStack* stack, JSONElement* element, JSONCache* cache);
+static void        libjson_formatDouble(double d, char* tmp);
+static void        libjson_writerAppend(JSONWriter* writer, const char* str, int length);
+static void        libjson_writerValue(JSONWriter* writer);
+static void        libjson_writeIndent(JSONFormatter* formatter);
+static int         libjson_whitespaceRun(const char* str, int length);
+static int         libjson_tokenRun(const char* str, int length, bool inString);
 static void        libjson_deallocate(void** p);
 #define libjson_dealloc(p) libjson_deallocate((void**)&p)
+static void*       libjson_allocate(int size);
+static void*       libjson_resize(void* memory, int size, int newSize);
+static void        libjson_release(void* memory, int size);
+static void        libjson_releaseString(char* str);
+static char*       libjson_adoptString(char* str);
+
+#ifdef LIBJSON_POOL
+static int         libjson_sizeClass(int size);
+
+#if defined(__cplusplus)
+#define LIBJSON_THREAD_LOCAL thread_local
+#else
+#define LIBJSON_THREAD_LOCAL _Thread_local
+#endif
+
+static LIBJSON_THREAD_LOCAL JSONPool libjson_pool; /**< The calling thread's free blocks. */
+#endif
+
+// C++17 has no designated initializers, so the union's first member, an empty object, is spelled out
+#ifdef __cplusplus
+static const JSONElement libjson_nullJSONElement = { null, 0, { { { NULL }, 0, 0 } } }; /**< Returned by lookups that find nothing. */
+#else
+static const JSONElement libjson_nullJSONElement = { .type = null, .flags = 0, .integer = 0 }; /**< Returned by lookups that find nothing. */
+#endif
 
 /*=============================================================================
     JSONObject {}
@@ -225,6 +904,7 @@ JSONObject o_emptyJSONObject(void) {
 
     empty.numberOfElements = 0;
     empty.elements = NULL;
+    empty.flags = 0;
 
     return empty;
 }
@@ -236,11 +916,14 @@ JSONObject o_emptyJSONObject(void) {
  * @param json The object to deallocate.
  */
 void o_destroyJSONObject(JSONObject* json) {
-    for(int i=0; i<json->numberOfElements; i++) {
-        libjson_destroyJSONPair(&json->elements[i]);
-    }
-    libjson_dealloc(json->elements);
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = object;
+    root.object = *json;
+
+    libjson_destroyTree(&root);
+    json->elements = NULL;
     json->numberOfElements = 0;
+    json->flags = 0;
 }
 
 // -- To String --
@@ -252,131 +935,83 @@ void o_destroyJSONObject(JSONObject* json) {
  * @return A string representation of the object.
  */
 char* o_JSONObjectToString(JSONObject json) {
-    char* str = libjson_emptyString(1 + (json.numberOfElements == 0));
-    str[0] = '{';
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = object;
+    root.object = json;
 
-    if(json.numberOfElements == 0) {
-        str[1] = '}';
-    }
+    JSONBuffer out = {NULL, 0, 0};
+    libjson_appendTree(&out, &root, NULL);
+    libjson_bufferAppend(&out, "", 1);
 
-    for(int i=0; i<json.numberOfElements; i++) {
-        char* pair = libjson_JSONPairToString(json.elements[i]);
-        char* temp = libjson_extendString(str, libjson_strlen(pair)+1);
-        if(!temp) {
-            fprintf(stderr, "Ran out of memory in JSONObjectToString");
-         libjson_dealloc(pair);
-         libjson_dealloc(str);
-            return NULL;
-        }
-        str = temp;
-        sprintf(str, "%s%s%s", str, pair, (i<json.numberOfElements-1?",":"}"));
-        libjson_dealloc(pair);
-        str = temp;
-    }
+    return out.data;
+}
 
-    return str;
+/**
+ * Convert a json object to a string, reusing the output of subtrees that
+ * haven't been modified since they were last converted with the same @p cache.
+ * Containers are marked as modified by every function which sets or removes
+ * values in them, or hands out a mutable reference to a value in them.
+ * @warning Containers modified through a copy of their struct, such as the
+ * return value of o_getJSONObject, aren't marked as modified. Use o_ref instead.
+ * @warning A document should always be converted with the same @p cache.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param json  The object to convert to string.
+ * @param cache The output kept from previous conversions.
+ * @return A string representation of the object.
+ */
+char* o_JSONObjectToCachedString(JSONObject* json, JSONCache* cache) {
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = object;
+    root.object = *json;
+
+    JSONBuffer out = {NULL, 0, 0};
+    cache->generation++;
+    libjson_appendTree(&out, &root, cache);
+    libjson_bufferAppend(&out, "", 1);
+
+    json->flags = root.object.flags;
+    return out.data;
 }
 
 // -- Parser --
 /**
  * Parse a string into a JSONObject.
+ * Objects and arrays may be nested up to LIBJSON_MAX_DEPTH deep. Use p_parseJSONObject
+ * to choose the limit, reuse the parser's memory, or find out why parsing failed.
  * @warning The @p str must be valid json.
  * 
  * @param str The json to parse.
- * @return The JSONObject representation of the parsed string.
+ * @return The JSONObject representation of the parsed string, or an empty object if it can't be parsed.
  */
 JSONObject o_parseJSONObject(char* str) {
-    bool firstBrace = true;
-    JSONObject o = o_emptyJSONObject();
-    char* key = NULL;
-    bool onValue = false;
-    int len = libjson_strlen(str);
-
-    for(int i=0; i<len; i++) {
-        char c = str[i];
-
-        if(libjson_isspace(c)) {
-            continue;
-        }
-
-        if(c == '{') {
-            if(firstBrace) {
-                firstBrace = false;
-            } else {
-                char* child = libjson_extractRaw(str+i, '{', '}');
-                o_setJSONObject(&o, key, o_parseJSONObject(child));
-                i+=libjson_strlen(child)-1;
-                libjson_dealloc(child);
-                libjson_dealloc(key);
-                onValue = false;
-            }
-        } else if(c == '}') {
-            // should be closing brace, and can be ignored.
-            libjson_dealloc(key);
-            break;
-        } else if(c == '\"') {
-            char* s = libjson_extractString(str+i);
-            i+=libjson_strlen(s)+1;
-            
-            if(onValue) {
-                o_setString(&o, key, s);
-                libjson_dealloc(s);
-                libjson_dealloc(key);
-                onValue = false;
-            } else {
-                key = s;
-            }
-        } else if(c == '[') {
-            char* child = libjson_extractRaw(str+i, '[', ']');
-            o_setJSONArray(&o, key, a_parseJSONArray(child));
-            i+=libjson_strlen(child)-1;
-            libjson_dealloc(child);
-            libjson_dealloc(key);
-            onValue = false;
-        } else if(c == 'n') {
-            o_setNull(&o, key);
-            libjson_dealloc(key);
-            onValue = false;
-            i+=3;
-        } else if(c == 't' || c == 'f') {
-            o_setBoolean(&o, key, c == 't');
-            libjson_dealloc(key);
-            onValue = false;
-            i+=3+(c != 't');
-        } else if(c == ':') {
-            onValue = true;
-        } else if(c == ',') {
-            //assert(!onValue)
-        } else if(libjson_isdigit(c) || c == '-') {
-            char tmp[128] = {0};
-            bool hadPoint = false;
-            int start = i;
-            long double num = 0;
-
-            for(int j=0; j+start<len; j++) {
-                char d = str[start+j];
-
-                if(d != '.' && !libjson_isdigit(d) && d != '-') {
-                    break;
-                }
-
-                if(d == '.' && !hadPoint) {
-                    hadPoint = true;
-                    tmp[j] = d;
-                } else if(d != '.') {
-                    if(!(d == '-' && j != 0)) {
-                        tmp[j] = d;
-                    }
-                }
-                i++;
-            }
-            sscanf(tmp, "%Lf", &num);
-            o_setDouble(&o, key, num);
+    JSONParser parser = p_emptyJSONParser();
+    JSONObject o = p_parseJSONObject(&parser, str);
+    p_destroyJSONParser(&parser);
+    return o;
+}
 
-            libjson_dealloc(key);
-            onValue = false;
-        }
-    }
+/**
+ * Parse only some of the values in a string into a JSONObject.
+ * Each path is either a key of the outermost object, or a JSON Pointer (RFC 6901) such as
+ * /user/name. The values the paths refer to are parsed whole, along with the objects
+ * containing them. Arrays along a path are kept, with the rest of the path applied to each of
+ * their values, or only to the values at the indexes given, such as /users/0/name, which are
+ * kept in order without the rest. Everything else is stepped over without being allocated, copied or converted.
+ * Objects and arrays may be nested up to LIBJSON_MAX_DEPTH deep. Use p_parseJSONObjectFields
+ * to choose the limit or find out why parsing failed.
+ * @warning The @p str must be valid json.
+ * 
+ * @param str           The json to parse.
+ * @param paths         The keys or JSON Pointers of the values to keep.
+ * @param numberOfPaths How many paths there are.
+ * @return The JSONObject representation of the requested values of the parsed string,
+ *         or an empty object if it can't be parsed.
+ */
+JSONObject o_parseJSONObjectFields(char* str, char** paths, int numberOfPaths) {
+    JSONParser parser = p_emptyJSONParser();
+    JSONObject o = p_parseJSONObjectFields(&parser, str, paths, numberOfPaths);
+    p_destroyJSONParser(&parser);
     return o;
 }
 
@@ -388,16 +1023,8 @@ JSONObject o_parseJSONObject(char* str) {
  * @param key  The key to check the object for.
  * @return True if the key is present. False otherwise.
  */
-bool o_has(JSONObject json, char* key) {
-    bool has = false;
-    for(int i=0; i<json.numberOfElements; i++) {
-        JSONPair temp = json.elements[i];
-        if(libjson_strcmp(key, temp.key)) {
-            has = true;
-            break;
-        }
-    }
-    return has;
+bool o_has(JSONObject json, const char* key) {
+    return o_cref(&json, key) != NULL;
 }
 
 /**
@@ -407,8 +1034,8 @@ bool o_has(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is an object, true. Otherwise, false.
  */
-bool o_isJSONObject(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).type == object;
+bool o_isJSONObject(JSONObject json, const char* key) {
+    return o_getJSONElement(json, key)->type == object;
 }
 
 /**
@@ -418,8 +1045,8 @@ bool o_isJSONObject(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is an array, true. Otherwise, false.
  */
-bool o_isJSONArray(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).type == array;
+bool o_isJSONArray(JSONObject json, const char* key) {
+    return o_getJSONElement(json, key)->type == array;
 }
 
 /**
@@ -429,8 +1056,8 @@ bool o_isJSONArray(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is a boolean, true. Otherwise, false.
  */
-bool o_isBoolean(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).type == boolean;
+bool o_isBoolean(JSONObject json, const char* key) {
+    return o_getJSONElement(json, key)->type == boolean;
 }
 
 /**
@@ -440,9 +1067,8 @@ bool o_isBoolean(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is an integer, true. Otherwise, false.
  */
-bool o_isInt(JSONObject json, char* key) {
-    JSONElement element = o_getJSONElement(json, key);
-    return element.type == number && element.number == libjson_floor(element.number);
+bool o_isInt(JSONObject json, const char* key) {
+    return e_isInt(o_getJSONElement(json, key));
 }
 
 /**
@@ -452,8 +1078,8 @@ bool o_isInt(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is a double, true. Otherwise, false.
  */
-bool o_isDouble(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).type == number;
+bool o_isDouble(JSONObject json, const char* key) {
+    return o_getJSONElement(json, key)->type == number;
 }
 
 /**
@@ -463,8 +1089,8 @@ bool o_isDouble(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is a string, true. Otherwise, false.
  */
-bool o_isString(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).type == string;
+bool o_isString(JSONObject json, const char* key) {
+    return o_getJSONElement(json, key)->type == string;
 }
 
 /**
@@ -474,8 +1100,8 @@ bool o_isString(JSONObject json, char* key) {
  * @param key  The key the value is paired with.
  * @return If the value is null or if the key isn't present, true. Otherwise, false.
  */
-bool o_isNull(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).type == null;
+bool o_isNull(JSONObject json, const char* key) {
+    return o_getJSONElement(json, key)->type == null;
 }
 
 // -- Accessors --
@@ -486,8 +1112,8 @@ bool o_isNull(JSONObject json, char* key) {
  * @param key  The key the object is paired with.
  * @return The object, or a json null if the key isn't present.
  */
-JSONObject o_getJSONObject(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).object;
+JSONObject o_getJSONObject(JSONObject json, const char* key) {
+    return e_getJSONObject(o_getJSONElement(json, key));
 }
 
 /**
@@ -497,8 +1123,8 @@ JSONObject o_getJSONObject(JSONObject json, char* key) {
  * @param key  The key the array is paired with.
  * @return The array, or a json null if the key isn't present.
  */
-JSONArray o_getJSONArray(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).array;
+JSONArray o_getJSONArray(JSONObject json, const char* key) {
+    return e_getJSONArray(o_getJSONElement(json, key));
 }
 
 /**
@@ -508,8 +1134,8 @@ JSONArray o_getJSONArray(JSONObject json, char* key) {
  * @param key  The key the boolean is paired with.
  * @return The boolean, or a json null if the key isn't present.
  */
-bool o_getBoolean(JSONObject json, char* key){
-    return o_getJSONElement(json, key).boolean;
+bool o_getBoolean(JSONObject json, const char* key){
+    return e_getBoolean(o_getJSONElement(json, key));
 }
 
 /**
@@ -519,8 +1145,8 @@ bool o_getBoolean(JSONObject json, char* key){
  * @param key  The key the integer is paired with.
  * @return The integer, or a json null if the key isn't present.
  */
-long o_getInt(JSONObject json, char* key) {
-    return (long)o_getJSONElement(json, key).number;
+long o_getInt(JSONObject json, const char* key) {
+    return e_getInt(o_getJSONElement(json, key));
 }
 
 /**
@@ -530,19 +1156,20 @@ long o_getInt(JSONObject json, char* key) {
  * @param key  The key the double is paired with.
  * @return The double, or a json null if the key isn't present.
  */
-long double o_getDouble(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).number;
+long double o_getDouble(JSONObject json, const char* key) {
+    return e_getDouble(o_getJSONElement(json, key));
 }
 
 /**
  * Get a string from a json object by it's key.
+ * @warning Interned strings (LIBJSON_INTERNED) are shared with equal values, so they mustn't be written to.
  * 
  * @param json The object to get a string from.
  * @param key  The key the string is paired with.
  * @return The string, or a json null if the key isn't present.
  */
-char* o_getString(JSONObject json, char* key) {
-    return o_getJSONElement(json, key).string;
+char* o_getString(JSONObject json, const char* key) {
+    return e_getString(o_getJSONElement(json, key));
 }
 
 /**
@@ -553,12 +1180,12 @@ char* o_getString(JSONObject json, char* key) {
  * @param dflt The default object to return if the key isn't present.
  * @return The object, or @p dflt if the key isn't present.
  */
-JSONObject o_optJSONObject(JSONObject json, char* key, JSONObject dflt) {
-    JSONElement element = o_getJSONElement(json, key);
-    if(element.type == null) {
+JSONObject o_optJSONObject(JSONObject json, const char* key, JSONObject dflt) {
+    const JSONElement* element = o_getJSONElement(json, key);
+    if(element->type == null) {
         return dflt;
     }
-    return element.object;
+    return e_getJSONObject(element);
 }
 
 /**
@@ -569,12 +1196,12 @@ JSONObject o_optJSONObject(JSONObject json, char* key, JSONObject dflt) {
  * @param dflt The default array to return if the key isn't present.
  * @return The array, or @p dflt if the key isn't present.
  */
-JSONArray o_optJSONArray(JSONObject json, char* key, JSONArray dflt) {
-    JSONElement element = o_getJSONElement(json, key);
-    if(element.type == null) {
+JSONArray o_optJSONArray(JSONObject json, const char* key, JSONArray dflt) {
+    const JSONElement* element = o_getJSONElement(json, key);
+    if(element->type == null) {
         return dflt;
     }
-    return element.array;
+    return e_getJSONArray(element);
 }
 
 /**
@@ -585,12 +1212,12 @@ JSONArray o_optJSONArray(JSONObject json, char* key, JSONArray dflt) {
  * @param dflt The default boolean to return if the key isn't present.
  * @return The boolean, or @p dflt if the key isn't present.
  */
-bool o_optBoolean(JSONObject json, char* key, bool dflt) {
-    JSONElement element = o_getJSONElement(json, key);
-    if(element.type == null) {
+bool o_optBoolean(JSONObject json, const char* key, bool dflt) {
+    const JSONElement* element = o_getJSONElement(json, key);
+    if(element->type == null) {
         return dflt;
     }
-    return element.boolean;
+    return e_getBoolean(element);
 }
 
 /**
@@ -601,12 +1228,12 @@ bool o_optBoolean(JSONObject json, char* key, bool dflt) {
  * @param dflt The default integer to return if the key isn't present.
  * @return The integer, or @p dflt if the key isn't present.
  */
-long o_optInt(JSONObject json, char* key, long dflt) {
-    JSONElement element = o_getJSONElement(json, key);
-    if(element.type == null) {
+long o_optInt(JSONObject json, const char* key, long dflt) {
+    const JSONElement* element = o_getJSONElement(json, key);
+    if(element->type == null) {
         return dflt;
     }
-    return (long)element.number;
+    return e_getInt(element);
 }
 
 /**
@@ -617,12 +1244,12 @@ long o_optInt(JSONObject json, char* key, long dflt) {
  * @param dflt The default double to return if the key isn't present.
  * @return The double, or @p dflt if the key isn't present.
  */
-long double o_optDouble(JSONObject json, char* key, long double dflt) {
-    JSONElement element = o_getJSONElement(json, key);
-    if(element.type == null) {
+long double o_optDouble(JSONObject json, const char* key, long double dflt) {
+    const JSONElement* element = o_getJSONElement(json, key);
+    if(element->type == null) {
         return dflt;
     }
-    return element.number;
+    return e_getDouble(element);
 }
 
 /**
@@ -633,37 +1260,187 @@ long double o_optDouble(JSONObject json, char* key, long double dflt) {
  * @param dflt The default string to return if the key isn't present.
  * @return The string, or @p dflt if the key isn't present.
  */
-char* o_optString(JSONObject json, char* key, char* dflt) {
-    JSONElement element = o_getJSONElement(json, key);
-    if(element.type == null) {
+char* o_optString(JSONObject json, const char* key, char* dflt) {
+    const JSONElement* element = o_getJSONElement(json, key);
+    if(element->type == null) {
         return dflt;
     }
-    return element.string;
+    return e_getString(element);
 }
 
-// -- Mutators --
+// -- References --
 /**
- * Set a json object for a key in a json object.
+ * Get a value from a json object by it's key, in place.
+ * The value may be modified through the returned pointer, including setting
+ * values inside a nested object or array, without setting it again in @p json.
+ * @warning The pointer is only valid until a value is next set in, or removed from, @p json,
+ * or @p json is converted to string with a JSONCache.
  * 
- * @param json The object to set the object in.
- * @param key  The key the object is paired with.
- * @param set  The object to set.
+ * @param json The object to get a value from.
+ * @param key  The key the value is paired with.
+ * @return The value, or NULL if the key isn't present or @p json was built in a parser's arena.
  */
-void o_setJSONObject(JSONObject* json, char* key, JSONObject set) {
-    JSONElement element = libjson_emptyJSONElement();
-    element.type = object;
-    element.object = set;
-    o_setJSONElement(json, key, element);
+JSONElement* o_ref(JSONObject* json, const char* key) {
+    if(json->flags & LIBJSON_ARENA) {
+        return NULL;
+    }
+    json->flags &= ~LIBJSON_CACHED;
+
+    int index = libjson_find(json, key);
+    return index < 0 ? NULL : libjson_valueAt(json, index);
 }
 
 /**
- * Set a json array for a key in a json object.
+ * Get a read-only value from a json object by it's key, in place.
+ * @warning The pointer is only valid until a value is next set in, or removed from, @p json,
+ * or @p json is converted to string with a JSONCache.
  * 
- * @param json The object to set the array in.
- * @param key  The key the array is paired with.
+ * @param json The object to get a value from.
+ * @param key  The key the value is paired with.
+ * @return The value, or NULL if the key isn't present.
+ */
+const JSONElement* o_cref(const JSONObject* json, const char* key) {
+    int index = libjson_find(json, key);
+    return index < 0 ? NULL : libjson_valueAt(json, index);
+}
+
+/**
+ * Create a slot to look up a key in many objects with o_crefSlot.
+ * 
+ * @param key The key to look up. Must outlive the slot.
+ * @return The slot.
+ */
+JSONSlot o_slot(const char* key) {
+    JSONSlot slot;
+    slot.key = key;
+    slot.index = 0;
+    return slot;
+}
+
+/**
+ * Get a read-only value from a json object by a slot's key, in place.
+ * Where the key was last found is checked first, so looking it up in objects
+ * with the same keys, such as the records of an array, skips searching for it.
+ * @warning The pointer is only valid until a value is next set in, or removed from, @p json,
+ * or @p json is converted to string with a JSONCache.
+ * 
+ * @param json The object to get a value from.
+ * @param slot The key to look up, which remembers where it's found.
+ * @return The value, or NULL if the key isn't present.
+ */
+const JSONElement* o_crefSlot(const JSONObject* json, JSONSlot* slot) {
+    if(slot->index < json->numberOfElements && libjson_strcmp(slot->key, libjson_keyAt(json, slot->index))) {
+        return libjson_valueAt(json, slot->index);
+    }
+
+    int index = libjson_find(json, slot->key);
+    if(index < 0) {
+        return NULL;
+    }
+    slot->index = index;
+    return libjson_valueAt(json, index);
+}
+
+// -- Iteration --
+/**
+ * Start visiting the key/value pairs of a json object, in order.
+ * Call o_next to move to each pair.
+ * @warning The iterator is only valid until a value is next set in, or removed from, @p json.
+ * 
+ * @code
+ * JSONObjectIterator it = o_iterate(&json);
+ * while(o_next(&it)) {
+ *     printf("%s\n", it.key);
+ * }
+ * @endcode
+ * 
+ * @param json The object to visit.
+ * @return An iterator before the first pair.
+ */
+JSONObjectIterator o_iterate(const JSONObject* json) {
+    JSONObjectIterator iterator;
+    iterator.json = json;
+    iterator.next = 0;
+    iterator.key = NULL;
+    iterator.value = NULL;
+    return iterator;
+}
+
+/**
+ * Move to the next key/value pair of a json object.
+ * 
+ * @param iterator The iterator to move. Its @c key and @c value are set to the pair.
+ * @return If there was another pair, true. Otherwise, false.
+ */
+bool o_next(JSONObjectIterator* iterator) {
+    if(iterator->next == iterator->json->numberOfElements) {
+        return false;
+    }
+    iterator->key = libjson_keyAt(iterator->json, iterator->next);
+    iterator->value = libjson_valueAt(iterator->json, iterator->next);
+    iterator->next++;
+    return true;
+}
+
+/**
+ * Call a function with each key/value pair of a json object, in order.
+ * 
+ * @param json     The object to visit.
+ * @param function The function to call. Returns false to stop.
+ * @param context  Passed along to @p function.
+ * @return If every pair was visited, true. If @p function stopped early, false.
+ */
+bool o_forEach(const JSONObject* json, JSONPairFunction function, void* context) {
+    for(int i=0; i<json->numberOfElements; i++) {
+        if(!function(libjson_keyAt(json, i), libjson_valueAt(json, i), context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Call a function with each key/value pair of a json object whose value has a type, in order.
+ * 
+ * @param json     The object to visit.
+ * @param type     The type of the values to visit.
+ * @param function The function to call. Returns false to stop.
+ * @param context  Passed along to @p function.
+ * @return If every matching pair was visited, true. If @p function stopped early, false.
+ */
+bool o_forEachOfType(const JSONObject* json, JSONType type, JSONPairFunction function, void* context) {
+    for(int i=0; i<json->numberOfElements; i++) {
+        const JSONElement* value = libjson_valueAt(json, i);
+        if(value->type == type && !function(libjson_keyAt(json, i), value, context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -- Mutators --
+/**
+ * Set a json object for a key in a json object.
+ * 
+ * @param json The object to set the object in.
+ * @param key  The key the object is paired with.
+ * @param set  The object to set.
+ */
+void o_setJSONObject(JSONObject* json, const char* key, JSONObject set) {
+    JSONElement element = libjson_emptyJSONElement();
+    element.type = object;
+    element.object = set;
+    o_setJSONElement(json, key, element);
+}
+
+/**
+ * Set a json array for a key in a json object.
+ * 
+ * @param json The object to set the array in.
+ * @param key  The key the array is paired with.
  * @param set  The array to set.
  */
-void o_setJSONArray(JSONObject* json, char* key, JSONArray set) {
+void o_setJSONArray(JSONObject* json, const char* key, JSONArray set) {
     JSONElement element = libjson_emptyJSONElement();
     element.type = array;
     element.array = set;
@@ -677,7 +1454,7 @@ void o_setJSONArray(JSONObject* json, char* key, JSONArray set) {
  * @param key  The key the boolean is paired with.
  * @param set  The boolean to set.
  */
-void o_setBoolean(JSONObject* json, char* key, bool set) {
+void o_setBoolean(JSONObject* json, const char* key, bool set) {
     JSONElement element = libjson_emptyJSONElement();
     element.type = boolean;
     element.boolean = set;
@@ -691,10 +1468,11 @@ void o_setBoolean(JSONObject* json, char* key, bool set) {
  * @param key  The key the integer is paired with.
  * @param set  The integer to set.
  */
-void o_setInt(JSONObject* json, char* key, long set) {
+void o_setInt(JSONObject* json, const char* key, long set) {
     JSONElement element = libjson_emptyJSONElement();
     element.type = number;
-    element.number = (long double)set;
+    element.flags = LIBJSON_INTEGER;
+    element.integer = (int64_t)set;
     o_setJSONElement(json, key, element);
 }
 
@@ -705,10 +1483,10 @@ void o_setInt(JSONObject* json, char* key, long set) {
  * @param key  The key the double is paired with.
  * @param set  The double to set.
  */
-void o_setDouble(JSONObject* json, char* key, long double set) {
+void o_setDouble(JSONObject* json, const char* key, long double set) {
     JSONElement element = libjson_emptyJSONElement();
     element.type = number;
-    element.number = set;
+    element.number = (double)set;
     o_setJSONElement(json, key, element);
 }
 
@@ -719,10 +1497,9 @@ void o_setDouble(JSONObject* json, char* key, long double set) {
  * @param key  The key the string is paired with.
  * @param set  The string to set.
  */
-void o_setString(JSONObject* json, char* key, char* set) {
+void o_setString(JSONObject* json, const char* key, const char* set) {
     JSONElement element = libjson_emptyJSONElement();
-    element.type = string;
-    element.string = libjson_strcpy(set);
+    libjson_copyStringElement(set, &element);
     o_setJSONElement(json, key, element);
 }
 
@@ -732,7 +1509,7 @@ void o_setString(JSONObject* json, char* key, char* set) {
  * @param json The object to set the null in.
  * @param key  The key the null is paired with.
  */
-void o_setNull(JSONObject* json, char* key) {
+void o_setNull(JSONObject* json, const char* key) {
     o_setJSONElement(json, key, libjson_emptyJSONElement());
 }
 
@@ -742,9 +1519,20 @@ void o_setNull(JSONObject* json, char* key) {
  * @param json The json object to remove a value from.
  * @param key  The key the value to be removed is paired with.
  */
-void o_remove(JSONObject* json, char* key) {
+void o_remove(JSONObject* json, const char* key) {
     int index = 0;
     bool exists = false;
+
+    if(json->flags & LIBJSON_ARENA) {
+        return;
+    }
+    if((json->flags & LIBJSON_SHAPED) && (libjson_find(json, key) < 0 || !libjson_unshape(json))) {
+        return;
+    }
+    if((json->flags & LIBJSON_COMPACT) && (libjson_find(json, key) < 0 || !libjson_uncompactObject(json))) {
+        return;
+    }
+
     for(int i=0; i<json->numberOfElements; i++) {
         JSONPair temp = json->elements[i];
         if(libjson_strcmp(key, temp.key)) {
@@ -755,13 +1543,281 @@ void o_remove(JSONObject* json, char* key) {
         }
     }
     if(exists) {
+        json->flags &= ~LIBJSON_CACHED;
+
         for(int i=index; i<json->numberOfElements-1; i++) {
             json->elements[i] = json->elements[i+1];
         }
 
         json->numberOfElements--;
-        json->elements = realloc(json->elements, sizeof(JSONPair)*json->numberOfElements);
+        json->elements = (JSONPair*)libjson_resize(json->elements, sizeof(JSONPair)*(json->numberOfElements+1), sizeof(JSONPair)*json->numberOfElements);
+    }
+}
+
+/**
+ * Set a value for a key in a json object without copying anything.
+ * The object takes ownership of both @p key and any heap memory used by @p set.
+ * @warning @p key must have been allocated with malloc, and must not be used by the caller afterwards.
+ * 
+ * @param json The object to set the value in.
+ * @param key  The key the value is paired with.
+ * @param set  The value to set.
+ */
+void o_moveJSONElement(JSONObject* json, char* key, JSONElement set) {
+    char* adopted = libjson_adoptString(key);
+    if(!adopted) {
+        fprintf(stderr, "Ran out of memory in moveJSONElement");
+        libjson_dealloc(key);
+        e_destroyJSONElement(&set);
+        return;
+    }
+    libjson_movePair(json, adopted, set);
+}
+
+/**
+ * Set a value for a key in a json object, taking ownership of a key allocated by libjson.
+ * 
+ * @param json The object to set the value in.
+ * @param key  The key the value is paired with.
+ * @param set  The value to set.
+ */
+static void libjson_movePair(JSONObject* json, char* key, JSONElement set) {
+    // Documents built in a parser's arena are read only
+    if(json->flags & LIBJSON_ARENA) {
+        libjson_releaseString(key);
+        e_destroyJSONElement(&set);
+        return;
+    }
+    o_remove(json, key);
+
+    int n = json->numberOfElements;
+    JSONPair* tmp = libjson_unshape(json) && libjson_uncompactObject(json) ? (JSONPair*)libjson_resize(json->elements, sizeof(JSONPair)*n, sizeof(JSONPair)*(n + 1)) : NULL;
+
+    if(!tmp) {
+        fprintf(stderr, "Ran out of memory in moveJSONElement");
+        libjson_releaseString(key);
+        e_destroyJSONElement(&set);
+    } else {
+        json->elements = tmp;
+        json->flags &= ~LIBJSON_CACHED;
+
+        JSONPair pair;
+        pair.value = set;
+        pair.key = key;
+
+        json->elements[json->numberOfElements] = pair;
+        json->numberOfElements++;
+    }
+}
+
+/**
+ * Set a string for a key in a json object without copying either of them.
+ * The object takes ownership of both @p key and @p set.
+ * @warning @p key and @p set must have been allocated with malloc, and must not be used by the caller afterwards.
+ * 
+ * @param json The object to set the string in.
+ * @param key  The key the string is paired with.
+ * @param set  The string to set.
+ */
+void o_moveString(JSONObject* json, char* key, char* set) {
+    JSONElement element = libjson_emptyJSONElement();
+    element.type = string;
+    element.string = set;
+    o_moveJSONElement(json, key, element);
+}
+
+/**
+ * Detach a value from a json object, leaving a json null paired with its key.
+ * The caller takes ownership of the returned value.
+ * @warning Return value should be destroyed with e_destroyJSONElement when no longer needed.
+ * 
+ * @param json The object to take a value from.
+ * @param key  The key the value is paired with.
+ * @return The value, or a json null if the key isn't present.
+ */
+JSONElement o_take(JSONObject* json, const char* key) {
+    JSONElement element = libjson_emptyJSONElement();
+    JSONElement* ref = o_ref(json, key);
+    if(ref) {
+        element = *ref;
+        *ref = libjson_emptyJSONElement();
     }
+    return element;
+}
+
+/**
+ * Move a value out of one json object and into another, without copying it.
+ * A json null is left paired with @p fromKey in @p from.
+ * 
+ * @param json    The object to set the value in.
+ * @param key     The key the value will be paired with.
+ * @param from    The object to take the value from.
+ * @param fromKey The key the value is paired with in @p from.
+ */
+void o_splice(JSONObject* json, const char* key, JSONObject* from, const char* fromKey) {
+    if((json->flags | from->flags) & LIBJSON_ARENA) {
+        return;
+    }
+    o_setJSONElement(json, key, o_take(from, fromKey));
+}
+
+// -- Patch --
+/**
+ * Apply a JSON Patch (RFC 6902) to a json object, in place.
+ * Each operation resolves its path once, and only the containers along that path are touched.
+ * Supports the add, remove, replace, move, copy and test operations.
+ * @note Values in @p patch are copied, so the patch may be reused.
+ * @warning Operations are applied in order, and those before a failing operation remain applied.
+ * 
+ * @param json  The object to patch. Objects built in a parser's arena are left as they are.
+ * @param patch The array of operation objects to apply.
+ * @return If every operation succeeded, true. Otherwise, false.
+ */
+bool o_applyPatch(JSONObject* json, JSONArray patch) {
+    if(json->flags & LIBJSON_ARENA) {
+        return false;
+    }
+
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = object;
+    root.object = *json;
+
+    bool ok = true;
+
+    for(int i=0; i<patch.numberOfElements && ok; i++) {
+        JSONObject operation = a_getJSONObject(patch, i);
+        char* op = o_getString(operation, "op");
+        char* path = o_getString(operation, "path");
+        char* from = o_getString(operation, "from");
+        const JSONElement* value = o_cref(&operation, "value");
+
+        if(!op || !path) {
+            ok = false;
+        } else if(libjson_strcmp(op, "add")) {
+            ok = value && libjson_addAt(&root, path, libjson_copyJSONElement(value));
+        } else if(libjson_strcmp(op, "remove")) {
+            JSONElement removed;
+            ok = libjson_detachAt(&root, path, &removed);
+            if(ok) {
+                e_destroyJSONElement(&removed);
+            }
+        } else if(libjson_strcmp(op, "replace")) {
+            char* token = libjson_emptyString(libjson_strlen(path));
+            JSONElement* parent = libjson_resolvePointer(&root, path, token);
+            JSONElement* target = NULL;
+
+            if(path[0] == '\0') {
+                target = value && value->type == object ? &root : NULL;
+            } else if(parent && parent->type == object) {
+                target = o_ref(&parent->object, token);
+            } else if(parent && parent->type == array) {
+                target = a_ref(&parent->array, libjson_pointerIndex(token, parent->array.numberOfElements));
+            }
+            libjson_dealloc(token);
+
+            ok = value && target;
+            if(ok) {
+                e_destroyJSONElement(target);
+                *target = libjson_copyJSONElement(value);
+            }
+        } else if(libjson_strcmp(op, "move")) {
+            int len = libjson_strlen(from);
+            bool intoSelf = from && libjson_strlen(path) > len && path[len] == '/';
+            for(int j=0; intoSelf && j<len; j++) {
+                intoSelf = path[j] == from[j];
+            }
+
+            JSONElement moved;
+            ok = from && !intoSelf && libjson_detachAt(&root, from, &moved);
+            if(ok) {
+                ok = libjson_addAt(&root, path, moved);
+            }
+        } else if(libjson_strcmp(op, "copy")) {
+            char* token = libjson_emptyString(libjson_strlen(from));
+            JSONElement* parent = from ? libjson_resolvePointer(&root, from, token) : NULL;
+            JSONElement* source = NULL;
+
+            if(from && from[0] == '\0') {
+                source = &root;
+            } else if(parent && parent->type == object) {
+                source = o_ref(&parent->object, token);
+            } else if(parent && parent->type == array) {
+                source = a_ref(&parent->array, libjson_pointerIndex(token, parent->array.numberOfElements));
+            }
+            libjson_dealloc(token);
+
+            ok = source && libjson_addAt(&root, path, libjson_copyJSONElement(source));
+        } else if(libjson_strcmp(op, "test")) {
+            char* token = libjson_emptyString(libjson_strlen(path));
+            JSONElement* parent = libjson_resolvePointer(&root, path, token);
+            JSONElement* target = NULL;
+
+            if(path[0] == '\0') {
+                target = &root;
+            } else if(parent && parent->type == object) {
+                target = o_ref(&parent->object, token);
+            } else if(parent && parent->type == array) {
+                target = a_ref(&parent->array, libjson_pointerIndex(token, parent->array.numberOfElements));
+            }
+            libjson_dealloc(token);
+
+            ok = value && target && libjson_equals(target, value);
+        } else {
+            ok = false;
+        }
+    }
+
+    *json = root.object;
+    return ok;
+}
+
+/**
+ * Apply a JSON Merge Patch (RFC 7396) to a json object, in place.
+ * Members of @p patch that are null are removed from @p json, nested objects are merged,
+ * and any other value replaces the one in @p json.
+ * @note Values in @p patch are copied, so the patch may be reused.
+ * 
+ * @param json  The object to patch. Objects built in a parser's arena are left as they are.
+ * @param patch The merge patch to apply.
+ */
+void o_mergePatch(JSONObject* json, JSONObject patch) {
+    if(json->flags & LIBJSON_ARENA) {
+        return;
+    }
+
+    JSONElement target = libjson_emptyJSONElement();
+    target.type = object;
+    target.object = *json;
+
+    JSONElement source = libjson_emptyJSONElement();
+    source.type = object;
+    source.object = patch;
+
+    libjson_mergePatch(&target, &source);
+    *json = target.object;
+}
+
+// -- Compaction --
+/**
+ * Rebuild a json object into one block of memory, with the storage of each object and array
+ * followed by its keys and then its values, depth first, as it's read.
+ * This suits documents which live long and are modified often, whose parts end up spread around memory.
+ * Containers which are modified afterwards are moved back out into memory of their own.
+ * @warning Every handle into @p json taken before compacting it is no longer valid. That includes
+ * pointers from o_ref and o_cref, iterators, strings from o_getString, and nested objects and arrays
+ * from o_getJSONObject and o_getJSONArray, at any depth. Only @p json itself is updated.
+ * 
+ * @param json The object to compact. Objects built in a parser's arena are left as they are.
+ * @return If the object was compacted. If there wasn't enough memory, it's left as it was.
+ */
+bool o_compact(JSONObject* json) {
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = object;
+    root.object = *json;
+
+    bool compacted = libjson_compact(&root);
+    *json = root.object;
+    return compacted;
 }
 
 /*=============================================================================
@@ -779,6 +1835,7 @@ JSONArray a_emptyJSONArray(void) {
 
     json.numberOfElements = 0;
     json.elements = NULL;
+    json.flags = 0;
 
     return json;
 }
@@ -790,11 +1847,14 @@ JSONArray a_emptyJSONArray(void) {
  * @param json The array to deallocate.
  */
 void a_destroyJSONArray(JSONArray* json) {
-    for(int i=0; i<json->numberOfElements; i++) {
-        libjson_destroyJSONElement(&json->elements[i]);
-    }
-    libjson_dealloc(json->elements);
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = array;
+    root.array = *json;
+
+    libjson_destroyTree(&root);
+    json->elements = NULL;
     json->numberOfElements = 0;
+    json->flags = 0;
 }
 
 // -- To String --
@@ -806,106 +1866,59 @@ void a_destroyJSONArray(JSONArray* json) {
  * @return A string representation of the array.
  */
 char* a_JSONArrayToString(JSONArray json) {
-    char* str = libjson_emptyString(1 + (json.numberOfElements == 0));
-    str[0] = '[';
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = array;
+    root.array = json;
 
-    if(json.numberOfElements == 0) {
-        str[1] = ']';
-    }
+    JSONBuffer out = {NULL, 0, 0};
+    libjson_appendTree(&out, &root, NULL);
+    libjson_bufferAppend(&out, "", 1);
 
-    for(int i=0; i<json.numberOfElements; i++) {
-        char* elem = libjson_JSONElementToString(json.elements[i]);
-        char* temp = libjson_extendString(str, libjson_strlen(elem)+1);
-        if(!temp) {
-            fprintf(stderr, "Ran out of memory in JSONArrayToString");
-            libjson_dealloc(elem);
-            libjson_dealloc(str);
-            return NULL;
-        }
-        str = temp;
-        sprintf(str, "%s%s%s", str, elem, (i<json.numberOfElements-1?",":"]"));
-        libjson_dealloc(elem);
-    }
+    return out.data;
+}
 
-    return str;
+/**
+ * Convert a json array to a string, reusing the output of subtrees that
+ * haven't been modified since they were last converted with the same @p cache.
+ * Containers are marked as modified by every function which sets or removes
+ * values in them, or hands out a mutable reference to a value in them.
+ * @warning Containers modified through a copy of their struct, such as the
+ * return value of a_getJSONArray, aren't marked as modified. Use a_ref instead.
+ * @warning A document should always be converted with the same @p cache.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param json  The array to convert to string.
+ * @param cache The output kept from previous conversions.
+ * @return A string representation of the array.
+ */
+char* a_JSONArrayToCachedString(JSONArray* json, JSONCache* cache) {
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = array;
+    root.array = *json;
+
+    JSONBuffer out = {NULL, 0, 0};
+    cache->generation++;
+    libjson_appendTree(&out, &root, cache);
+    libjson_bufferAppend(&out, "", 1);
+
+    json->flags = root.array.flags;
+    return out.data;
 }
 
 // -- Parser --
 /**
  * Parse a string into a JSONArray.
+ * Objects and arrays may be nested up to LIBJSON_MAX_DEPTH deep. Use p_parseJSONArray
+ * to choose the limit, reuse the parser's memory, or find out why parsing failed.
  * @warning The @p str must be valid json.
  * 
  * @param str The json to parse.
- * @return The JSONArray representation of the parsed string.
+ * @return The JSONArray representation of the parsed string, or an empty array if it can't be parsed.
  */
 JSONArray a_parseJSONArray(char* str) {
-    bool firstBrace = true;
-    JSONArray a = a_emptyJSONArray();
-    int len = libjson_strlen(str);
-
-    for(int i=0; i<len; i++) {
-        char c = str[i];
-
-        if(libjson_isspace(c)) {
-            continue;
-        } else if(c == '[') {
-            if(firstBrace) {
-                firstBrace = false;
-                continue;
-            } else {
-                char* child = libjson_extractRaw(str+i, '[', ']');
-                a_setJSONArray(&a, a.numberOfElements, a_parseJSONArray(child));
-                i+=libjson_strlen(child)-1;
-                libjson_dealloc(child);
-            }
-        } else if(c == ']') {
-            // should be closing brace, and can be ignored.
-            break;
-        } else if(c == '\"') {
-            char* s = libjson_extractString(str+i);
-            a_setString(&a, a.numberOfElements, s);
-            i+=libjson_strlen(s)+1;
-            libjson_dealloc(s);
-        } else if(c == '{') {
-            char* child = libjson_extractRaw(str+i, '{', '}');
-            a_setJSONObject(&a, a.numberOfElements, o_parseJSONObject(child));
-            i+=libjson_strlen(child)-1;
-            libjson_dealloc(child);
-        } else if(c == 'n') {
-            a_setNull(&a, a.numberOfElements);
-            i+=3;
-        } else if(c == 't' || c == 'f') {
-            a_setBoolean(&a, a.numberOfElements, c == 't');
-            i+=3+(c != 't');
-        } else if(c == ',') {
-            //safe to ignore?
-        } else if(libjson_isdigit(c) || c == '-') {
-            char tmp[128] = {0};
-            bool hadPoint = false;
-            int start = i;
-            long double num = 0;
-
-            for(int j=0; j+start<len; j++) {
-                char d = str[start+j];
-
-                if(d != '.' && !libjson_isdigit(d) && d != '-') {
-                    break;
-                }
-
-                if(d == '.' && !hadPoint) {
-                    hadPoint = true;
-                    tmp[j] = d;
-                } else if(d != '.') {
-                    if(!(d == '-' && j != 0)) {
-                        tmp[j] = d;
-                    }
-                }
-                i++;
-            }
-            sscanf(tmp, "%Lf", &num);
-            a_setDouble(&a, a.numberOfElements, num);
-        }
-    }
+    JSONParser parser = p_emptyJSONParser();
+    JSONArray a = p_parseJSONArray(&parser, str);
+    p_destroyJSONParser(&parser);
     return a;
 }
 
@@ -918,7 +1931,8 @@ JSONArray a_parseJSONArray(char* str) {
  * @return If the value is an object, true. Otherwise, false.
  */
 bool a_isJSONObject(JSONArray json, int index) {
-    return a_getJSONElement(json, index).type == object;
+    JSONElement scratch;
+    return a_getJSONElement(json, index, &scratch)->type == object;
 }
 
 /**
@@ -929,7 +1943,8 @@ bool a_isJSONObject(JSONArray json, int index) {
  * @return If the value is an array, true. Otherwise, false.
  */
 bool a_isJSONArray(JSONArray json, int index) {
-    return a_getJSONElement(json, index).type == array;
+    JSONElement scratch;
+    return a_getJSONElement(json, index, &scratch)->type == array;
 }
 
 /**
@@ -940,7 +1955,8 @@ bool a_isJSONArray(JSONArray json, int index) {
  * @return If the value is a boolean, true. Otherwise, false.
  */
 bool a_isBoolean(JSONArray json, int index) {
-    return a_getJSONElement(json, index).type == boolean;
+    JSONElement scratch;
+    return a_getJSONElement(json, index, &scratch)->type == boolean;
 }
 
 /**
@@ -951,8 +1967,8 @@ bool a_isBoolean(JSONArray json, int index) {
  * @return If the value is an integer, true. Otherwise, false.
  */
 bool a_isInt(JSONArray json, int index) {
-    JSONElement element = a_getJSONElement(json, index);
-    return element.type == number && element.number == libjson_floor(element.number);
+    JSONElement scratch;
+    return e_isInt(a_getJSONElement(json, index, &scratch));
 }
 
 /**
@@ -963,7 +1979,8 @@ bool a_isInt(JSONArray json, int index) {
  * @return If the value is a double, true. Otherwise, false.
  */
 bool a_isDouble(JSONArray json, int index) {
-    return a_getJSONElement(json, index).type == number;
+    JSONElement scratch;
+    return a_getJSONElement(json, index, &scratch)->type == number;
 }
 
 /**
@@ -974,7 +1991,8 @@ bool a_isDouble(JSONArray json, int index) {
  * @return If the value is a string, true. Otherwise, false.
  */
 bool a_isString(JSONArray json, int index) {
-    return a_getJSONElement(json, index).type == string;
+    JSONElement scratch;
+    return a_getJSONElement(json, index, &scratch)->type == string;
 }
 
 /**
@@ -985,7 +2003,8 @@ bool a_isString(JSONArray json, int index) {
  * @return If the value is null or if the index is out of bounds, true. Otherwise, false.
  */
 bool a_isNull(JSONArray json, int index) {
-    return a_getJSONElement(json, index).type == null;
+    JSONElement scratch;
+    return a_getJSONElement(json, index, &scratch)->type == null;
 }
 
 // -- Accessors --
@@ -997,7 +2016,8 @@ bool a_isNull(JSONArray json, int index) {
  * @return The object, or a json null if the index is not in bounds.
  */
 JSONObject a_getJSONObject(JSONArray json, int index) {
-    return a_getJSONElement(json, index).object;
+    JSONElement scratch;
+    return e_getJSONObject(a_getJSONElement(json, index, &scratch));
 }
 
 /**
@@ -1008,7 +2028,8 @@ JSONObject a_getJSONObject(JSONArray json, int index) {
  * @return The array, or a json null if the index is not in bounds.
  */
 JSONArray a_getJSONArray(JSONArray json, int index) {
-    return a_getJSONElement(json, index).array;
+    JSONElement scratch;
+    return e_getJSONArray(a_getJSONElement(json, index, &scratch));
 }
 
 /**
@@ -1019,7 +2040,8 @@ JSONArray a_getJSONArray(JSONArray json, int index) {
  * @return The boolean, or a json null if the index is not in bounds.
  */
 bool a_getBoolean(JSONArray json, int index) {
-    return a_getJSONElement(json, index).boolean;
+    JSONElement scratch;
+    return e_getBoolean(a_getJSONElement(json, index, &scratch));
 }
 
 /**
@@ -1030,7 +2052,8 @@ bool a_getBoolean(JSONArray json, int index) {
  * @return The integer, or a json null if the index is not in bounds.
  */
 long a_getInt(JSONArray json, int index) {
-    return (long)a_getJSONElement(json, index).number;
+    JSONElement scratch;
+    return e_getInt(a_getJSONElement(json, index, &scratch));
 }
 
 /**
@@ -1041,18 +2064,111 @@ long a_getInt(JSONArray json, int index) {
  * @return The double, or a json null if the index is not in bounds.
  */
 long double a_getDouble(JSONArray json, int index) {
-    return a_getJSONElement(json, index).number;
+    JSONElement scratch;
+    return e_getDouble(a_getJSONElement(json, index, &scratch));
 }
 
 /**
  * Get a string from a json array at an index.
+ * @warning Interned strings (LIBJSON_INTERNED) are shared with equal values, so they mustn't be written to.
  * 
  * @param json  The array to get a string from.
  * @param index The index the string is located at.
  * @return The string, or a json null if the index is not in bounds.
  */
 char* a_getString(JSONArray json, int index) {
-    return a_getJSONElement(json, index).string;
+    JSONElement scratch;
+    return e_getString(a_getJSONElement(json, index, &scratch));
+}
+
+/**
+ * Get every value of a json array of numbers as doubles, in one pass.
+ * Packed arrays are converted without visiting a JSONElement for each value.
+ * 
+ * @param json The array to get the values from.
+ * @param out  Where to put the values. Must have space for @c json.numberOfElements doubles.
+ * @return If every value is a number, true. Otherwise, false, and @p out may have been partly written.
+ */
+bool a_getDoubles(JSONArray json, double* out) {
+    if((json.flags & LIBJSON_PACKED) && (json.flags & LIBJSON_INTEGER)) {
+        for(int i=0; i<json.numberOfElements; i++) {
+            out[i] = (double)json.integers[i];
+        }
+        return true;
+    } else if(json.flags & LIBJSON_PACKED) {
+        for(int i=0; i<json.numberOfElements; i++) {
+            out[i] = json.doubles[i];
+        }
+        return true;
+    }
+
+    for(int i=0; i<json.numberOfElements; i++) {
+        if(json.elements[i].type != number) {
+            return false;
+        }
+        JSONElement element = libjson_decodeNumber(&json.elements[i]);
+        out[i] = element.flags & LIBJSON_INTEGER ? (double)element.integer : element.number;
+    }
+    return true;
+}
+
+/**
+ * Get every value of a json array of numbers as floats, in one pass.
+ * Packed arrays are converted without visiting a JSONElement for each value.
+ * 
+ * @param json The array to get the values from.
+ * @param out  Where to put the values. Must have space for @c json.numberOfElements floats.
+ * @return If every value is a number, true. Otherwise, false, and @p out may have been partly written.
+ */
+bool a_getFloats(JSONArray json, float* out) {
+    if((json.flags & LIBJSON_PACKED) && (json.flags & LIBJSON_INTEGER)) {
+        for(int i=0; i<json.numberOfElements; i++) {
+            out[i] = (float)json.integers[i];
+        }
+        return true;
+    } else if(json.flags & LIBJSON_PACKED) {
+        for(int i=0; i<json.numberOfElements; i++) {
+            out[i] = (float)json.doubles[i];
+        }
+        return true;
+    }
+
+    for(int i=0; i<json.numberOfElements; i++) {
+        if(json.elements[i].type != number) {
+            return false;
+        }
+        JSONElement element = libjson_decodeNumber(&json.elements[i]);
+        out[i] = element.flags & LIBJSON_INTEGER ? (float)element.integer : (float)element.number;
+    }
+    return true;
+}
+
+/**
+ * Get every value of a json array of integers, in one pass.
+ * Packed arrays are copied without visiting a JSONElement for each value.
+ * 
+ * @param json The array to get the values from.
+ * @param out  Where to put the values. Must have space for @c json.numberOfElements integers.
+ * @return If every value is an integer, true. Otherwise, false, and @p out may have been partly written.
+ */
+bool a_getInts(JSONArray json, int64_t* out) {
+    if((json.flags & LIBJSON_PACKED) && (json.flags & LIBJSON_INTEGER)) {
+        for(int i=0; i<json.numberOfElements; i++) {
+            out[i] = json.integers[i];
+        }
+        return true;
+    }
+
+    for(int i=0; i<json.numberOfElements; i++) {
+        JSONElement scratch;
+        const JSONElement* element = libjson_elementAt(&json, i, &scratch);
+        if(!e_isInt(element)) {
+            return false;
+        }
+        JSONElement decoded = libjson_decodeNumber(element);
+        out[i] = decoded.flags & LIBJSON_INTEGER ? decoded.integer : (int64_t)decoded.number;
+    }
+    return true;
 }
 
 /**
@@ -1064,11 +2180,12 @@ char* a_getString(JSONArray json, int index) {
  * @return The object, or @p dflt if the index is not in bounds.
  */
 JSONObject a_optJSONObject(JSONArray json, int index, JSONObject dflt) {
-    JSONElement element = a_getJSONElement(json, index);
-    if(element.type == null) {
+    JSONElement scratch;
+    const JSONElement* element = a_getJSONElement(json, index, &scratch);
+    if(element->type == null) {
         return dflt;
     }
-    return element.object;
+    return e_getJSONObject(element);
 }
 
 /**
@@ -1080,11 +2197,12 @@ JSONObject a_optJSONObject(JSONArray json, int index, JSONObject dflt) {
  * @return The array, or @p dflt if the index is not in bounds.
  */
 JSONArray a_optJSONArray(JSONArray json, int index, JSONArray dflt) {
-    JSONElement element = a_getJSONElement(json, index);
-    if(element.type == null) {
+    JSONElement scratch;
+    const JSONElement* element = a_getJSONElement(json, index, &scratch);
+    if(element->type == null) {
         return dflt;
     }
-    return element.array;
+    return e_getJSONArray(element);
 }
 
 /**
@@ -1096,11 +2214,12 @@ JSONArray a_optJSONArray(JSONArray json, int index, JSONArray dflt) {
  * @return The boolean, or @p dflt if the index is not in bounds.
  */
 bool a_optBoolean(JSONArray json, int index, bool dflt) {
-    JSONElement element = a_getJSONElement(json, index);
-    if(element.type == null) {
+    JSONElement scratch;
+    const JSONElement* element = a_getJSONElement(json, index, &scratch);
+    if(element->type == null) {
         return dflt;
     }
-    return element.boolean;
+    return e_getBoolean(element);
 }
 
 /**
@@ -1112,11 +2231,12 @@ bool a_optBoolean(JSONArray json, int index, bool dflt) {
  * @return The integer, or @p dflt if the index is not in bounds.
  */
 long a_optInt(JSONArray json, int index, long dflt) {
-    JSONElement element = a_getJSONElement(json, index);
-    if(element.type == null) {
+    JSONElement scratch;
+    const JSONElement* element = a_getJSONElement(json, index, &scratch);
+    if(element->type == null) {
         return dflt;
     }
-    return (long)element.number;
+    return e_getInt(element);
 }
 
 /**
@@ -1128,11 +2248,12 @@ long a_optInt(JSONArray json, int index, long dflt) {
  * @return The double, or @p dflt if the index is not in bounds.
  */
 long double a_optDouble(JSONArray json, int index, long double dflt) {
-    JSONElement element = a_getJSONElement(json, index);
-    if(element.type == null) {
+    JSONElement scratch;
+    const JSONElement* element = a_getJSONElement(json, index, &scratch);
+    if(element->type == null) {
         return dflt;
     }
-    return element.number;
+    return e_getDouble(element);
 }
 
 /**
@@ -1144,27 +2265,147 @@ long double a_optDouble(JSONArray json, int index, long double dflt) {
  * @return The string, or @p dflt if the index is not in bounds.
  */
 char* a_optString(JSONArray json, int index, char* dflt) {
-    JSONElement element = a_getJSONElement(json, index);
-    if(element.type == null) {
+    JSONElement scratch;
+    const JSONElement* element = a_getJSONElement(json, index, &scratch);
+    if(element->type == null) {
         return dflt;
     }
-    return element.string;
+    return e_getString(element);
 }
 
-// -- Mutators --
+// -- References --
 /**
- * Add a json object at the end of a json array.
+ * Get a value from a json array at an index, in place.
+ * The value may be modified through the returned pointer, including setting
+ * values inside a nested object or array, without setting it again in @p json.
+ * @warning The pointer is only valid until a value is next added to, or removed from, @p json,
+ * or @p json is converted to string with a JSONCache.
  * 
- * @param json The array to add the object to.
- * @param index The index to add the value at.
- * @param set  The object to add.
+ * @param json  The array to get a value from.
+ * @param index The index the value is located at.
+ * @return The value, or NULL if the index is not in bounds or @p json was built in a parser's arena.
  */
-void a_setJSONObject(JSONArray* json, int index, JSONObject set) {
-    JSONElement element = libjson_emptyJSONElement();
-    element.type = object;
-    element.object = set;
-    a_setJSONElement(json, index, element);
-}
+JSONElement* a_ref(JSONArray* json, int index) {
+    if(json->flags & LIBJSON_ARENA) {
+        return NULL;
+    }
+    json->flags &= ~LIBJSON_CACHED;
+
+    if(index < 0 || index >= json->numberOfElements || !libjson_unpack(json)) {
+        return NULL;
+    }
+    return &json->elements[index];
+}
+
+/**
+ * Get a read-only value from a json array at an index, in place.
+ * A value of a packed array is decoded into @p scratch instead, so the array is never modified.
+ * @warning The pointer is only valid until a value is next added to, or removed from, @p json,
+ * or @p json is converted to string with a JSONCache, or @p scratch is reused.
+ * 
+ * @param json    The array to get a value from.
+ * @param index   The index the value is located at.
+ * @param scratch Where to decode the value if the array is packed.
+ * @return The value, or NULL if the index is not in bounds.
+ */
+const JSONElement* a_cref(const JSONArray* json, int index, JSONElement* scratch) {
+    if(index < 0 || index >= json->numberOfElements) {
+        return NULL;
+    }
+    return libjson_elementAt(json, index, scratch);
+}
+
+// -- Iteration --
+/**
+ * Start visiting the values of a json array, in order, without copying each one.
+ * Call a_next to move to each value. Values of a packed array are decoded into the iterator one at a time, leaving the array as it is.
+ * @warning The iterator is only valid until a value is next added to, or removed from, @p json.
+ * 
+ * @param json The array to visit.
+ * @return An iterator before the first value.
+ */
+JSONArrayIterator a_iterate(const JSONArray* json) {
+    JSONArrayIterator iterator;
+    iterator.json = json;
+    iterator.index = -1;
+    iterator.value = NULL;
+    iterator.scratch = libjson_emptyJSONElement();
+    return iterator;
+}
+
+/**
+ * Move to the next value of a json array.
+ * 
+ * @param iterator The iterator to move. Its @c index and @c value are set to the value.
+ * @return If there was another value, true. Otherwise, false.
+ */
+bool a_next(JSONArrayIterator* iterator) {
+    if(iterator->index+1 >= iterator->json->numberOfElements) {
+        return false;
+    }
+    iterator->index++;
+    iterator->value = libjson_elementAt(iterator->json, iterator->index, &iterator->scratch);
+    return true;
+}
+
+/**
+ * Call a function with each value of a json array, in order.
+ * 
+ * @param json     The array to visit.
+ * @param function The function to call. Returns false to stop.
+ * @param context  Passed along to @p function.
+ * @return If every value was visited, true. If @p function stopped early, false.
+ */
+bool a_forEach(const JSONArray* json, JSONElementFunction function, void* context) {
+    JSONElement scratch;
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        if(!function(i, libjson_elementAt(json, i, &scratch), context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Call a function with each value of a json array which has a type, in order.
+ * 
+ * @param json     The array to visit.
+ * @param type     The type of the values to visit.
+ * @param function The function to call. Returns false to stop.
+ * @param context  Passed along to @p function.
+ * @return If every matching value was visited, true. If @p function stopped early, false.
+ */
+bool a_forEachOfType(const JSONArray* json, JSONType type, JSONElementFunction function, void* context) {
+    JSONElement scratch;
+
+    if((json->flags & LIBJSON_PACKED) && type != number) {
+        return true;
+    }
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        const JSONElement* element = libjson_elementAt(json, i, &scratch);
+        if(element->type == type && !function(i, element, context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -- Mutators --
+/**
+ * Add a json object at the end of a json array.
+ * 
+ * @param json The array to add the object to.
+ * @param index The index to add the value at.
+ * @param set  The object to add.
+ */
+void a_setJSONObject(JSONArray* json, int index, JSONObject set) {
+    JSONElement element = libjson_emptyJSONElement();
+    element.type = object;
+    element.object = set;
+    a_setJSONElement(json, index, element);
+}
 
 /**
  * Add a json array at the end of a json array.
@@ -1204,7 +2445,8 @@ void a_setBoolean(JSONArray* json, int index, bool set) {
 void a_setInt(JSONArray* json, int index, long set) {
     JSONElement element = libjson_emptyJSONElement();
     element.type = number;
-    element.number = (long double)set;
+    element.flags = LIBJSON_INTEGER;
+    element.integer = (int64_t)set;
     a_setJSONElement(json, index, element);
 }
 
@@ -1218,7 +2460,7 @@ void a_setInt(JSONArray* json, int index, long set) {
 void a_setDouble(JSONArray* json, int index, long double set) {
     JSONElement element = libjson_emptyJSONElement();
     element.type = number;
-    element.number = set;
+    element.number = (double)set;
     a_setJSONElement(json, index, element);
 }
 
@@ -1229,10 +2471,9 @@ void a_setDouble(JSONArray* json, int index, long double set) {
  * @param index The index to add the value at.
  * @param set  The string to add.
  */
-void a_setString(JSONArray* json, int index, char* set) {
+void a_setString(JSONArray* json, int index, const char* set) {
     JSONElement element = libjson_emptyJSONElement();
-    element.type = string;
-    element.string = libjson_strcpy(set);
+    libjson_copyStringElement(set, &element);
     a_setJSONElement(json, index, element);
 }
 
@@ -1254,355 +2495,4828 @@ void a_setNull(JSONArray* json, int index) {
  * @param index The index the value to be removed is located at.
  */
 void a_remove(JSONArray* json, int index) {
+    if((json->flags & LIBJSON_ARENA) || index < 0 || index >= json->numberOfElements || !libjson_unpack(json) || !libjson_uncompactArray(json)) {
+        return;
+    }
+    json->flags &= ~LIBJSON_CACHED;
+    e_destroyJSONElement(&json->elements[index]);
+
     for(int i=index; i<json->numberOfElements-1; i++) {
         json->elements[i] = json->elements[i+1];
     }
 
     json->numberOfElements--;
-    json->elements = realloc(json->elements, sizeof(JSONElement)*json->numberOfElements);
+    json->elements = (JSONElement*)libjson_resize(json->elements, sizeof(JSONElement)*(json->numberOfElements+1), sizeof(JSONElement)*json->numberOfElements);
 }
 
-// -- Helper functions --
-
 /**
- * Create an empty, or null, json value.
+ * Add a value to a json array without copying it.
+ * The array takes ownership of any heap memory used by @p set.
  * 
- * @return An empty json value.
+ * @param json  The array to add the value to.
+ * @param index The index to add the value at.
+ * @param set   The value to add.
  */
-static JSONElement libjson_emptyJSONElement(void) {
-    JSONElement empty;
-
-    empty.type = null;
-    empty.object = o_emptyJSONObject();
-    empty.array = a_emptyJSONArray();
-    empty.boolean = false;
-    empty.number = 0;
-    empty.string = NULL;
-
-    return empty;
+void a_moveJSONElement(JSONArray* json, int index, JSONElement set) {
+    a_setJSONElement(json, index, set);
 }
 
 /**
- * Free all heap memory used by a json value.
+ * Add a string to a json array without copying it.
+ * The array takes ownership of @p set.
+ * @warning @p set must have been allocated with malloc, and must not be freed by the caller.
  * 
- * @param element The value to deallocate.
+ * @param json  The array to add the string to.
+ * @param index The index to add the value at.
+ * @param set   The string to add.
  */
-static void libjson_destroyJSONElement(JSONElement* element) {
-    if(element->type == object) {
-        o_destroyJSONObject(&element->object);
-    } else if(element->type == array) {
-        a_destroyJSONArray(&element->array);
-    } else if(element->type == string) {
-        libjson_dealloc(element->string);
-    }
-    element->type = null;
+void a_moveString(JSONArray* json, int index, char* set) {
+    JSONElement element = libjson_emptyJSONElement();
+    element.type = string;
+    element.string = set;
+    a_setJSONElement(json, index, element);
 }
 
 /**
- * Allocate more memory space at the end of a string.
- * @note Appended memory is initialized to null bytes.
- * @warning Return value should be freed when no longer needed.
- * 
- * @param str            The original string to append space after.
- * @param additionalSize The number of additioal bytes to allocate.
+ * Detach a value from a json array, leaving a json null at its index.
+ * The caller takes ownership of the returned value.
+ * @warning Return value should be destroyed with e_destroyJSONElement when no longer needed.
  * 
- * @return The reallocated string, or NULL if it fails.
+ * @param json  The array to take a value from.
+ * @param index The index the value is located at.
+ * @return The value, or a json null if the index is not in bounds.
  */
-static char* libjson_extendString(char* str, int additionalSize) {
-    int len = libjson_strlen(str);
-    int size = len + additionalSize + 1;
-
-    char* extended = realloc(str, size);
-
-    if(extended) {
-        for(int i=len; i<size; i++) {
-            extended[i] = '\0';
-        }
+JSONElement a_take(JSONArray* json, int index) {
+    JSONElement element = libjson_emptyJSONElement();
+    JSONElement* ref = a_ref(json, index);
+    if(ref) {
+        element = *ref;
+        *ref = libjson_emptyJSONElement();
     }
-    return extended;
+    return element;
 }
 
 /**
- * Allocate memory for use by a string.
- * @note Memory is initialized to null bytes.
- * @warning Return value should be freed when no longer needed.
- * 
- * @param size The number of characters in the string.
+ * Move a value out of one json array and into another, without copying it.
+ * A json null is left at @p fromIndex in @p from.
  * 
- * @return The allocated string, or NULL if it fails.
+ * @param json      The array to add the value to.
+ * @param index     The index to add the value at.
+ * @param from      The array to take the value from.
+ * @param fromIndex The index the value is located at in @p from.
  */
-static char* libjson_emptyString(int size) {
-    size++;
-    char* memory = malloc(size+1);
-
-    if(memory) {
-        for(int i=0; i<=size; i++) {
-            memory[i] = '\0';
-        }
+void a_splice(JSONArray* json, int index, JSONArray* from, int fromIndex) {
+    if((json->flags | from->flags) & LIBJSON_ARENA) {
+        return;
     }
-    return memory;
+    a_setJSONElement(json, index, a_take(from, fromIndex));
 }
 
+// -- Compaction --
 /**
- * Copy the string enclosed by quotation marks from the beginning of @p str.
- * @note The extracted string may contain quotation marks as \".
- * @warning The first character of @p str must be ", and there must eventually be an unescaped ".
- * @warning Return value should be freed when no longer needed.
+ * Rebuild a json array into one block of memory, as o_compact does for an object.
+ * @warning Every handle into @p json taken before compacting it is no longer valid. That includes
+ * pointers from a_ref and a_cref, iterators, strings from a_getString, and nested objects and arrays
+ * from a_getJSONObject and a_getJSONArray, at any depth. Only @p json itself is updated.
  * 
- * @param str The string to extract a json string from.
- * @return The json string with no enclosing quotation marks.
+ * @param json The array to compact. Arrays built in a parser's arena are left as they are.
+ * @return If the array was compacted. If there wasn't enough memory, it's left as it was.
  */
-static char* libjson_extractString(char* str) {
-    int len = libjson_strlen(str);
-    int escapes = 0;
-    int end = 0;
-
-    for(int i=0; i<len; i++) {
-        char c = str[i];
-
-        if(c == '\\') {
-            escapes++;
-        }
-
-        if(c == '\"' && i > 0 && escapes % 2 == 0) {
-            end = i;
-            break;
-        }
+bool a_compact(JSONArray* json) {
+    JSONElement root = libjson_emptyJSONElement();
+    root.type = array;
+    root.array = *json;
+
+    bool compacted = libjson_compact(&root);
+    *json = root.array;
+    return compacted;
+}
 
-        if(c != '\\') {
-            escapes = 0;
-        }
-    }
+/*=============================================================================
+    JSONElement
+=============================================================================*/
 
-    char* s = libjson_emptyString(end-1);
-    for(int i=1; i<end; i++) {
-        s[i-1] = str[i];
+// -- Destructor --
+/**
+ * Free all heap memory used by a json value.
+ * 
+ * @param element The value to deallocate.
+ */
+void e_destroyJSONElement(JSONElement* element) {
+    if(element->type == object || element->type == array) {
+        libjson_destroyTree(element);
+    } else if(element->type == string && (element->flags & LIBJSON_INTERNED)) {
+        libjson_releaseInterned(element->string);
+    } else if((element->type == string || (element->flags & LIBJSON_RAW)) && (element->flags & LIBJSON_COMPACT)) {
+        libjson_releaseStorage(element->flags, element->string, 0);
+    } else if((element->type == string || (element->flags & LIBJSON_RAW)) && (element->flags & LIBJSON_POOLED)) {
+        libjson_releaseString(element->string);
+    } else if((element->type == string || (element->flags & LIBJSON_RAW)) && !(element->flags & (LIBJSON_INLINE | LIBJSON_ARENA))) {
+        libjson_dealloc(element->string);
     }
-    s[end] = '\0';
-
-    return s;
+    element->type = null;
+    element->flags = 0;
 }
 
+// -- Check --
 /**
- * Get a token from a string beginning with a character, and ending with another.
- * This is used for returning a string containing a json object or array, using 
- * @p open = { and @p close = } or @p open = [ and @p close = ] respectively.
- * @note Characters within strings (enclosed by quotations) aren't used for tokenizing.
- * @warning The first character of @p str must be @p open, and there must eventually be an @p close which is not eclosed in quotation marks.
- * @warning Return value should be freed when no longer needed.
+ * Check if a json value is an integer.
  * 
- * @param str   The string to get the token from.
- * @param open  The character to begin tokenizing with.
- * @param close The character to end tokenizing with.
- * @return A string beginning with @p open, and ending with the first occurence of @p close in @p str.
+ * @param element The value to check.
+ * @return If the value is an integer, true. Otherwise, false.
  */
-static char* libjson_extractRaw(char* str, char open, char close) {
-    int depth = 0;
-    int len = libjson_strlen(str);
-    int end = 0;
-
-    for(int i=0; i<len; i++) {
-        char c = str[i];
-
-        if(c == open) {
-            depth++;
-        } else if(c == close) {
-            depth--;
-            if(depth == 0) {
-                end = i;
-                break;
-            }
-        } else if(c == '\"') {
-            char* e = libjson_extractString(str+i);
-            i+=libjson_strlen(e)+1;
-            libjson_dealloc(e);
-        }
-    }
-
-    char* token = libjson_emptyString(end+1);
-    for(int i=0; i<=end; i++) {
-        token[i] = str[i];
+bool e_isInt(const JSONElement* element) {
+    if(element->type != number) {
+        return false;
     }
-    token[end+1] = '\0';
-
-    return token;
+    JSONElement decoded = libjson_decodeNumber(element);
+    return (decoded.flags & LIBJSON_INTEGER) || decoded.number == libjson_floor(decoded.number);
 }
 
+// -- Accessors --
 /**
- * Convert a json value to a string.
- * @warning Return value should be freed when no longer needed.
+ * Get a json object from a json value.
  * 
- * @param element The value to convert to string.
- * @return A string representation of the value.
+ * @param element The value to get an object from.
+ * @return The object, or an empty object if the value isn't one.
  */
-static char* libjson_JSONElementToString(JSONElement element) {
-    char* str = NULL;
-    char tmp[128] = {0};
-
-    switch(element.type) {
-        case object:
-            str = o_JSONObjectToString(element.object);
-            break;
-        case array:
-            str = a_JSONArrayToString(element.array);
-            break;
-        case boolean:
-            if(element.boolean) {
-                str = libjson_strcpy("true");
-            } else {
-                str = libjson_strcpy("false");
-            }
-            break;
-        case number:
-            sprintf(tmp, "%Lf", element.number);
-            int lastNonZero = 0;
-            int decimal = 0;
-            int len = libjson_strlen(tmp);
-
-            for(int i=0; i<len; i++) {
-                if(tmp[i] != '0') {
-                    lastNonZero = i;
-                    
-                    if(tmp[i] == '.') {
-                        decimal = i;
-                    }
-                }
-            }
-
-            if(decimal) {
-                if(lastNonZero == decimal) {
-                    tmp[decimal] = '\0';
-                } else {
-                    tmp[lastNonZero+1] = '\0';
-                }
-            }
-            str = libjson_strcpy(tmp);
-            break;
-        case string:
-            str = libjson_emptyString(libjson_strlen(element.string)+2);
-            sprintf(str, "\"%s\"", element.string);
-            break;
-        case null:
-            str = libjson_strcpy("null");
-            break;
-    }
-    return str;
+JSONObject e_getJSONObject(const JSONElement* element) {
+    return element->type == object ? element->object : o_emptyJSONObject();
 }
 
 /**
- * Free all heap memory used by a json key/value pair.
+ * Get a json array from a json value.
  * 
- * @param pair The key/value pair to deallocate.
+ * @param element The value to get an array from.
+ * @return The array, or an empty array if the value isn't one.
  */
-static void libjson_destroyJSONPair(JSONPair* pair) {
-    libjson_dealloc(pair->key);
-    libjson_destroyJSONElement(&pair->value);
+JSONArray e_getJSONArray(const JSONElement* element) {
+    return element->type == array ? element->array : a_emptyJSONArray();
 }
 
 /**
- * Get a value from a json object by it's key.
+ * Get a boolean from a json value.
  * 
- * @param json The object to get a value from.
- * @param key  The key the value is paired with.
- * @return The value, or a json null if the key isn't present.
+ * @param element The value to get a boolean from.
+ * @return The boolean, or false if the value isn't one.
  */
-static JSONElement o_getJSONElement(JSONObject json, char* key) {
-    JSONElement element = libjson_emptyJSONElement();
-    for(int i=0; i<json.numberOfElements; i++) {
-        JSONPair temp = json.elements[i];
-        if(libjson_strcmp(key, temp.key)) {
-            element = temp.value;
-            break;
-        }
-    }
-    return element;
+bool e_getBoolean(const JSONElement* element) {
+    return element->type == boolean ? element->boolean : false;
 }
 
 /**
- * Set a value for a key in a json object. If the key already exists, the old data will be overwritten.
+ * Get an integer from a json value.
  * 
- * @param json The object to set the value in.
- * @param key  The key the value is paired with.
- * @param set  The value to set.
+ * @param element The value to get an integer from.
+ * @return The integer, or 0 if the value isn't a number.
  */
-static void o_setJSONElement(JSONObject* json, char* key, JSONElement set) {
-    o_remove(json, key);
-
-    JSONPair* tmp = realloc(json->elements, sizeof(JSONPair)*(json->numberOfElements + 1));
-
-    if(!tmp) {
-        fprintf(stderr, "Ran out of memory in setJSONElement");
-    } else {
-        json->elements = tmp;
-
-        JSONPair pair;
-        pair.value = set;
-        pair.key = libjson_strcpy(key);
-
-        json->elements[json->numberOfElements] = pair;
-        json->numberOfElements++;
+long e_getInt(const JSONElement* element) {
+    if(element->type != number) {
+        return 0;
     }
+    JSONElement decoded = libjson_decodeNumber(element);
+    return decoded.flags & LIBJSON_INTEGER ? (long)decoded.integer : (long)decoded.number;
 }
 
 /**
- * Convert a key/value pair to a string.
- * @warning Return value should be freed when no longer needed.
+ * Get a double from a json value.
  * 
- * @param pair The key/value pair to convert to string.
- * @return A string representation of the key/value pair.
+ * @param element The value to get a double from.
+ * @return The double, or 0 if the value isn't a number.
  */
-static char* libjson_JSONPairToString(JSONPair pair) {
-    char* value = libjson_JSONElementToString(pair.value);
-    char* str = libjson_emptyString(libjson_strlen(value)+3+libjson_strlen(pair.key));
-    sprintf(str, "\"%s\":%s", pair.key, value);
-    libjson_dealloc(value);
-    return str;
+long double e_getDouble(const JSONElement* element) {
+    if(element->type != number) {
+        return 0;
+    }
+    JSONElement decoded = libjson_decodeNumber(element);
+    return decoded.flags & LIBJSON_INTEGER ? (long double)decoded.integer : (long double)decoded.number;
 }
 
 /**
- * Get a value from a json array at an index.
+ * Get a string from a json value.
+ * @warning Short strings are held within the value, so the string only lives as long as the value stays where it is.
+ * @warning Interned strings (LIBJSON_INTERNED) are shared with equal values, so they mustn't be written to.
  * 
- * @param json  The array to get a value from.
- * @param index The index the value is located at.
- * @return The value, or a json null if the index is not in bounds.
+ * @param element The value to get a string from.
+ * @return The string, or NULL if the value isn't one.
  */
-static JSONElement a_getJSONElement(JSONArray json, int index) {
-    if(index < 0 || index >= json.numberOfElements) {
-        return libjson_emptyJSONElement();
+char* e_getString(const JSONElement* element) {
+    if(element->type != string) {
+        return NULL;
     }
-    return json.elements[index];
+    return element->flags & LIBJSON_INLINE ? (char*)element->inlined : element->string;
 }
 
+/*=============================================================================
+    JSONTable
+=============================================================================*/
+
+// -- Constructor --
 /**
- * Add a value at an index to a json array. This will push other elements later into the array.
- * If the @p index is less than or equal to 0, the item will be put at the start of the array.
- * If the @p index is greater than or equal to the length of the array, the item will be put at
- * the end of the array.
+ * Convert an array of records into a table with a column per key, so the values of
+ * one key can be read or aggregated without visiting the others.
+ * Strings are dictionary encoded, and objects, arrays and columns of mixed types are copied.
+ * Values which aren't objects become rows without any keys.
+ * @warning Return value should be destroyed with t_destroyJSONTable when no longer needed.
  * 
- * @param json  The array to add the value to.
- * @param index The index to add the value at.
- * @param set   The value to add.
+ * @param json The array of records to convert.
+ * @return The table.
  */
-static void a_setJSONElement(JSONArray* json, int index, JSONElement set) {
-    if(index < 0) {
-        index = 0;
-    } else if(index > json->numberOfElements) {
-        index = json->numberOfElements;
-    }
-    JSONElement* tmp = realloc(json->elements, sizeof(JSONElement)*(json->numberOfElements + 1));
-
-    if(!tmp) {
-        fprintf(stderr, "Ran out of memory in addJSONElement");
-    } else {
-        for(int i=json->numberOfElements; i>index; i--) {
-            json->elements[i] = json->elements[i-1];
+JSONTable t_fromJSONArray(JSONArray json) {
+    JSONTable table;
+    table.columns = NULL;
+    table.numberOfColumns = 0;
+    table.numberOfRows = json.numberOfElements;
+
+    char** keys = NULL;
+    int* lookup = NULL;
+    int capacity = 0;
+    JSONElement scratch;
+
+    // Find every key, and the type its values need
+    for(int row=0; row<json.numberOfElements; row++) {
+        const JSONElement* record = libjson_elementAt(&json, row, &scratch);
+        if(record->type != object) {
+            continue;
         }
 
-        json->numberOfElements++;
-        json->elements = tmp;
-        json->elements[index] = set;
+        for(int i=0; i<record->object.numberOfElements; i++) {
+            int index = libjson_columnIndex(&table, &keys, &lookup, &capacity, libjson_keyAt(&record->object, i));
+            if(index >= 0) {
+                libjson_classify(&table.columns[index], libjson_valueAt(&record->object, i));
+            }
+        }
     }
-}
+
+    int words = (json.numberOfElements+63)/64;
+    int** dictionaries = (int**)calloc(table.numberOfColumns ? table.numberOfColumns : 1, sizeof(int*));
+    int* dictionaryCapacities = (int*)calloc(table.numberOfColumns ? table.numberOfColumns : 1, sizeof(int));
+
+    for(int i=0; i<table.numberOfColumns; i++) {
+        JSONColumn* column = &table.columns[i];
+        if(column->type == columnString && (!dictionaries || !dictionaryCapacities)) {
+            column->type = columnMixed;
+        }
+
+        int size = column->type == columnBoolean ? (int)sizeof(bool)
+                 : column->type == columnString ? (int)sizeof(int)
+                 : column->type == columnMixed ? (int)sizeof(JSONElement) : 8;
+
+        column->present = (uint64_t*)calloc(words ? words : 1, sizeof(uint64_t));
+        column->nulls = (uint64_t*)calloc(words ? words : 1, sizeof(uint64_t));
+        column->integers = column->type == columnEmpty ? NULL : (int64_t*)calloc(json.numberOfElements ? json.numberOfElements : 1, size);
+
+        if(!column->present || !column->nulls || (column->type != columnEmpty && !column->integers)) {
+            fprintf(stderr, "Ran out of memory in fromJSONArray");
+            libjson_dealloc(column->integers);
+            column->type = columnEmpty;
+        }
+    }
+
+    // Fill in each row. Records sharing a shape share the column of each of their values.
+    const JSONShape* shape = NULL;
+    int* columnOf = NULL;
+
+    for(int row=0; row<json.numberOfElements; row++) {
+        const JSONElement* record = libjson_elementAt(&json, row, &scratch);
+        if(record->type != object) {
+            continue;
+        }
+
+        bool shaped = record->object.flags & LIBJSON_SHAPED;
+        if(shaped && record->object.record->shape != shape) {
+            int* tmp = (int*)realloc(columnOf, sizeof(int)*record->object.numberOfElements);
+            shape = tmp ? record->object.record->shape : NULL;
+            columnOf = tmp ? tmp : columnOf;
+
+            for(int i=0; shape && i<record->object.numberOfElements; i++) {
+                columnOf[i] = libjson_columnIndex(&table, &keys, &lookup, &capacity, libjson_keyAt(&record->object, i));
+            }
+        }
+
+        for(int i=0; i<record->object.numberOfElements; i++) {
+            int index = shaped && shape == record->object.record->shape ? columnOf[i]
+                      : libjson_columnIndex(&table, &keys, &lookup, &capacity, libjson_keyAt(&record->object, i));
+            if(index < 0 || !table.columns[index].present) {
+                continue;
+            }
+
+            JSONColumn* column = &table.columns[index];
+            const JSONElement* value = libjson_valueAt(&record->object, i);
+            column->present[row/64] |= (uint64_t)1 << (row%64);
+
+            if(value->type == null) {
+                column->nulls[row/64] |= (uint64_t)1 << (row%64);
+                if(column->type == columnMixed) {
+                    column->values[row] = libjson_emptyJSONElement();
+                }
+                continue;
+            }
+
+            switch(column->type) {
+                case columnBoolean:
+                    column->booleans[row] = value->boolean;
+                    break;
+                case columnInt:
+                    column->integers[row] = libjson_decodeNumber(value).integer;
+                    break;
+                case columnDouble:
+                    column->doubles[row] = (double)e_getDouble(value);
+                    break;
+                case columnString: {
+                    int size = column->dictionarySize;
+                    column->codes[row] = libjson_lookup(&dictionaries[index], &dictionaryCapacities[index],
+                                                        column->dictionary, size, e_getString(value), false);
+
+                    // The dictionary's capacity doubles whenever its size reaches a power of two
+                    if(column->codes[row] == size && (size & (size-1)) == 0) {
+                        char** tmp = (char**)realloc(column->dictionary, sizeof(char*)*(size ? size*2 : 1));
+                        if(!tmp) {
+                            fprintf(stderr, "Ran out of memory in fromJSONArray");
+                            column->codes[row] = -1;
+                        } else {
+                            column->dictionary = tmp;
+                        }
+                    }
+                    if(column->codes[row] == size) {
+                        column->codes[row] = libjson_lookup(&dictionaries[index], &dictionaryCapacities[index],
+                                                            column->dictionary, size, e_getString(value), true);
+                    }
+                    if(column->codes[row] == size) {
+                        column->dictionary[column->dictionarySize++] = libjson_strcpy(e_getString(value));
+                    }
+
+                    // Rows whose string couldn't be stored read as null
+                    if(column->codes[row] < 0) {
+                        column->codes[row] = 0;
+                        column->nulls[row/64] |= (uint64_t)1 << (row%64);
+                    }
+                    break;
+                }
+                case columnMixed:
+                    column->values[row] = libjson_copyJSONElement(value);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    for(int i=0; dictionaries && i<table.numberOfColumns; i++) {
+        libjson_dealloc(dictionaries[i]);
+    }
+    libjson_dealloc(dictionaries);
+    libjson_dealloc(dictionaryCapacities);
+    libjson_dealloc(columnOf);
+    libjson_dealloc(keys);
+    libjson_dealloc(lookup);
+    return table;
+}
+
+// -- Destructor --
+/**
+ * Free all heap memory used by a table.
+ * 
+ * @param table The table to deallocate.
+ */
+void t_destroyJSONTable(JSONTable* table) {
+    for(int i=0; i<table->numberOfColumns; i++) {
+        JSONColumn* column = &table->columns[i];
+
+        if(column->type == columnMixed && column->values) {
+            for(int row=0; row<table->numberOfRows; row++) {
+                e_destroyJSONElement(&column->values[row]);
+            }
+        }
+        for(int j=0; j<column->dictionarySize; j++) {
+            libjson_dealloc(column->dictionary[j]);
+        }
+
+        libjson_dealloc(column->key);
+        libjson_dealloc(column->present);
+        libjson_dealloc(column->nulls);
+        libjson_dealloc(column->integers);
+        libjson_dealloc(column->dictionary);
+    }
+    libjson_dealloc(table->columns);
+    table->numberOfColumns = 0;
+    table->numberOfRows = 0;
+}
+
+// -- To String --
+/**
+ * Convert a table back into a json array of records.
+ * Each record's keys are written in the order of the table's columns.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param table The table to convert to string.
+ * @return The string representation of the table.
+ */
+char* t_JSONTableToString(const JSONTable* table) {
+    JSONWriter writer = w_bufferJSONWriter();
+    t_write(table, &writer);
+
+    char* str = w_JSONWriterToString(&writer);
+    w_destroyJSONWriter(&writer);
+    return str;
+}
+
+/**
+ * Write a table to a writer as a json array of records, a row at a time.
+ * Each record's keys are written in the order of the table's columns.
+ * 
+ * @param table  The table to write.
+ * @param writer The writer to write to.
+ */
+void t_write(const JSONTable* table, JSONWriter* writer) {
+    w_beginJSONArray(writer);
+
+    for(int row=0; row<table->numberOfRows; row++) {
+        w_beginJSONObject(writer);
+
+        for(int i=0; i<table->numberOfColumns; i++) {
+            const JSONColumn* column = &table->columns[i];
+            if(!t_isPresent(column, row)) {
+                continue;
+            }
+
+            w_key(writer, column->key);
+            if(t_isNull(column, row)) {
+                w_null(writer);
+                continue;
+            }
+
+            switch(column->type) {
+                case columnBoolean:
+                    w_boolean(writer, column->booleans[row]);
+                    break;
+                case columnInt:
+                    w_int(writer, (long)column->integers[row]);
+                    break;
+                case columnDouble:
+                    w_double(writer, column->doubles[row]);
+                    break;
+                case columnString:
+                    w_string(writer, column->dictionary[column->codes[row]]);
+                    break;
+                case columnMixed: {
+                    JSONBuffer buffer = {NULL, 0, 0};
+                    libjson_appendTree(&buffer, &column->values[row], NULL);
+                    libjson_writerValue(writer);
+                    libjson_writerAppend(writer, buffer.data, buffer.length);
+                    libjson_dealloc(buffer.data);
+                    break;
+                }
+                default:
+                    w_null(writer);
+                    break;
+            }
+        }
+        w_endJSONObject(writer);
+    }
+    w_endJSONArray(writer);
+}
+
+// -- Accessors --
+/**
+ * Get the column of a key from a table.
+ * 
+ * @param table The table to get a column from.
+ * @param key   The key of the column.
+ * @return The column, or NULL if no record has the key.
+ */
+const JSONColumn* t_getColumn(const JSONTable* table, const char* key) {
+    for(int i=0; i<table->numberOfColumns; i++) {
+        if(libjson_strcmp(key, table->columns[i].key)) {
+            return &table->columns[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Check if a row of a table has a column's key.
+ * 
+ * @param column The column to check.
+ * @param row    The index of the row.
+ * @return If the row has the key, true. Otherwise, false.
+ */
+bool t_isPresent(const JSONColumn* column, int row) {
+    return column->present && (column->present[row/64] >> (row%64)) & 1;
+}
+
+/**
+ * Check if a row of a table has a null for a column's key.
+ * 
+ * @param column The column to check.
+ * @param row    The index of the row.
+ * @return If the row's value is null, true. Otherwise, false.
+ */
+bool t_isNull(const JSONColumn* column, int row) {
+    return column->nulls && (column->nulls[row/64] >> (row%64)) & 1;
+}
+
+/*=============================================================================
+    JSONCache
+=============================================================================*/
+
+// -- Constructor --
+/**
+ * Create an empty cache of serialized output.
+ * 
+ * @return An empty cache.
+ */
+JSONCache c_emptyJSONCache(void) {
+    JSONCache cache;
+
+    cache.entries = NULL;
+    cache.capacity = 0;
+    cache.numberOfEntries = 0;
+    cache.generation = 0;
+
+    return cache;
+}
+
+// -- Destructor --
+/**
+ * Free all heap memory used by a cache of serialized output.
+ * 
+ * @param cache The cache to deallocate.
+ */
+void c_destroyJSONCache(JSONCache* cache) {
+    for(int i=0; i<cache->capacity; i++) {
+        libjson_dealloc(cache->entries[i].text);
+    }
+    libjson_dealloc(cache->entries);
+    cache->capacity = 0;
+    cache->numberOfEntries = 0;
+}
+
+/*=============================================================================
+    JSONWriter
+=============================================================================*/
+
+// -- Constructor --
+/**
+ * Create a writer which keeps its output in memory, to be taken with w_JSONWriterToString.
+ * 
+ * @return A writer with no output.
+ */
+JSONWriter w_bufferJSONWriter(void) {
+    JSONWriter writer;
+
+    writer.buffer.data = NULL;
+    writer.buffer.length = 0;
+    writer.buffer.capacity = 0;
+    writer.file = NULL;
+    writer.write = NULL;
+    writer.context = NULL;
+    writer.depth = 0;
+    writer.comma = false;
+
+    return writer;
+}
+
+/**
+ * Create a writer which writes its output to a file.
+ * Output is held until LIBJSON_WRITER_FLUSH characters are pending, or until w_flush is called.
+ * 
+ * @param file The file to write to.
+ * @return A writer with no output.
+ */
+JSONWriter w_fileJSONWriter(FILE* file) {
+    JSONWriter writer = w_bufferJSONWriter();
+    writer.file = file;
+    return writer;
+}
+
+/**
+ * Create a writer which passes its output to a function.
+ * Output is held until LIBJSON_WRITER_FLUSH characters are pending, or until w_flush is called.
+ * 
+ * @param write   The function to pass output to.
+ * @param context Passed along to @p write.
+ * @return A writer with no output.
+ */
+JSONWriter w_functionJSONWriter(JSONWriteFunction write, void* context) {
+    JSONWriter writer = w_bufferJSONWriter();
+    writer.write = write;
+    writer.context = context;
+    return writer;
+}
+
+// -- Destructor --
+/**
+ * Pass on any pending output, and free all heap memory used by a writer.
+ * 
+ * @param writer The writer to deallocate.
+ */
+void w_destroyJSONWriter(JSONWriter* writer) {
+    w_flush(writer);
+    libjson_dealloc(writer->buffer.data);
+    writer->buffer.length = 0;
+    writer->buffer.capacity = 0;
+}
+
+// -- Output --
+/**
+ * Take the output of a writer created with w_bufferJSONWriter. The writer is left empty.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param writer The writer to take the output of.
+ * @return The json written, or NULL if the writer has a file or function.
+ */
+char* w_JSONWriterToString(JSONWriter* writer) {
+    if(writer->file || writer->write) {
+        return NULL;
+    }
+
+    libjson_bufferAppend(&writer->buffer, "", 1);
+    char* str = writer->buffer.data;
+
+    writer->buffer.data = NULL;
+    writer->buffer.length = 0;
+    writer->buffer.capacity = 0;
+    writer->depth = 0;
+    writer->comma = false;
+
+    return str;
+}
+
+/**
+ * Pass any pending output of a writer on to its file or function.
+ * Does nothing for writers created with w_bufferJSONWriter.
+ * 
+ * @param writer The writer to flush.
+ */
+void w_flush(JSONWriter* writer) {
+    if(writer->buffer.length == 0) {
+        return;
+    }
+
+    if(writer->file) {
+        fwrite(writer->buffer.data, 1, writer->buffer.length, writer->file);
+    } else if(writer->write) {
+        writer->write(writer->buffer.data, writer->buffer.length, writer->context);
+    } else {
+        return;
+    }
+    writer->buffer.length = 0;
+}
+
+// -- Structure --
+/**
+ * Start writing an object. Its members are written with w_key followed by a value.
+ * 
+ * @param writer The writer to write to.
+ */
+void w_beginJSONObject(JSONWriter* writer) {
+    libjson_writerValue(writer);
+    libjson_writerAppend(writer, "{", 1);
+    writer->depth++;
+    writer->comma = false;
+}
+
+/**
+ * Finish writing the innermost object.
+ * 
+ * @param writer The writer to write to.
+ */
+void w_endJSONObject(JSONWriter* writer) {
+    libjson_writerAppend(writer, "}", 1);
+    writer->depth--;
+    writer->comma = true;
+}
+
+/**
+ * Start writing an array.
+ * 
+ * @param writer The writer to write to.
+ */
+void w_beginJSONArray(JSONWriter* writer) {
+    libjson_writerValue(writer);
+    libjson_writerAppend(writer, "[", 1);
+    writer->depth++;
+    writer->comma = false;
+}
+
+/**
+ * Finish writing the innermost array.
+ * 
+ * @param writer The writer to write to.
+ */
+void w_endJSONArray(JSONWriter* writer) {
+    libjson_writerAppend(writer, "]", 1);
+    writer->depth--;
+    writer->comma = true;
+}
+
+/**
+ * Write the key of the next member of the innermost object.
+ * @warning Must be followed by exactly one value.
+ * 
+ * @param writer The writer to write to.
+ * @param key    The key.
+ */
+void w_key(JSONWriter* writer, const char* key) {
+    libjson_writerValue(writer);
+    libjson_bufferAppendString(&writer->buffer, key);
+    libjson_writerAppend(writer, ":", 1);
+    writer->comma = false;
+}
+
+// -- Values --
+/**
+ * Write a boolean.
+ * 
+ * @param writer The writer to write to.
+ * @param value  The value to write.
+ */
+void w_boolean(JSONWriter* writer, bool value) {
+    libjson_writerValue(writer);
+    if(value) {
+        libjson_writerAppend(writer, "true", 4);
+    } else {
+        libjson_writerAppend(writer, "false", 5);
+    }
+}
+
+/**
+ * Write an integer.
+ * 
+ * @param writer The writer to write to.
+ * @param value  The value to write.
+ */
+void w_int(JSONWriter* writer, long value) {
+    char tmp[32] = {0};
+
+    libjson_writerValue(writer);
+    sprintf(tmp, "%ld", value);
+    libjson_writerAppend(writer, tmp, libjson_strlen(tmp));
+}
+
+/**
+ * Write a floating point number, with as many digits as it takes to read back the same double.
+ * Infinity and NaN, which json can't hold, are written as null.
+ * 
+ * @param writer The writer to write to.
+ * @param value  The value to write.
+ */
+void w_double(JSONWriter* writer, long double value) {
+    char tmp[512] = {0};
+
+    libjson_writerValue(writer);
+    libjson_formatDouble((double)value, tmp);
+    libjson_writerAppend(writer, tmp, libjson_strlen(tmp));
+}
+
+/**
+ * Write a string.
+ * 
+ * @param writer The writer to write to.
+ * @param value  The value to write (not including quotes).
+ */
+void w_string(JSONWriter* writer, const char* value) {
+    libjson_writerValue(writer);
+    libjson_bufferAppendString(&writer->buffer, value);
+
+    if(writer->buffer.length >= LIBJSON_WRITER_FLUSH) {
+        w_flush(writer);
+    }
+}
+
+/**
+ * Write a null.
+ * 
+ * @param writer The writer to write to.
+ */
+void w_null(JSONWriter* writer) {
+    libjson_writerValue(writer);
+    libjson_writerAppend(writer, "null", 4);
+}
+
+/**
+ * Write a value which is already json, as is.
+ * @warning The @p json must be a single valid json value.
+ * 
+ * @param writer The writer to write to.
+ * @param json   The json to write.
+ */
+void w_raw(JSONWriter* writer, const char* json) {
+    libjson_writerValue(writer);
+    libjson_writerAppend(writer, json, libjson_strlen(json));
+}
+
+/*=============================================================================
+    JSONParser
+=============================================================================*/
+
+// -- Constructor --
+/**
+ * Create a parser which allows objects and arrays to be nested up to LIBJSON_MAX_DEPTH deep.
+ * Change @c maxDepth to choose another limit, and set @c pack to parse arrays of only
+ * numbers into LIBJSON_PACKED storage, which a_getDoubles and a_getInts read directly.
+ * Set @c share to parse objects with the same keys into LIBJSON_SHAPED storage, sharing one
+ * copy of their keys, and @c raw to keep numbers as their json text.
+ * Set @c reuse to build documents in the parser's own memory, which each parse reuses, so that
+ * parsing many small documents with one parser stops allocating once it has enough. Such
+ * documents are read only, as setting, removing, taking or referencing values in them does nothing,
+ * and they only last until the parser's next parse. @c pack and @c share are ignored.
+ * Set @c intern to share one copy of each string value up to @c internLength long between every value
+ * equal to it, in this and later documents, which suits strings which repeat, such as names of types.
+ * @warning With @c intern, documents from the same parser share memory, so must be destroyed on one thread at a time.
+ * 
+ * @return A parser.
+ */
+JSONParser p_emptyJSONParser(void) {
+    JSONParser parser;
+
+    parser.maxDepth = LIBJSON_MAX_DEPTH;
+    parser.pack = false;
+    parser.share = false;
+    parser.raw = false;
+    parser.reuse = false;
+    parser.intern = false;
+    parser.internLength = LIBJSON_INTERN_LENGTH;
+    parser.stack.frames = NULL;
+    parser.stack.depth = 0;
+    parser.stack.capacity = 0;
+    parser.arena.blocks = NULL;
+    parser.arena.sizes = NULL;
+    parser.arena.numberOfBlocks = 0;
+    parser.arena.block = 0;
+    parser.arena.used = 0;
+    parser.arena.last = NULL;
+    parser.shapes = NULL;
+    parser.numberOfShapes = 0;
+    parser.shapeCapacity = 0;
+    parser.interned = NULL;
+    parser.numberOfInterned = 0;
+    parser.internCapacity = 0;
+    parser.error.kind = errorNone;
+    parser.error.offset = 0;
+
+    return parser;
+}
+
+// -- Destructor --
+/**
+ * Free all heap memory used by a parser.
+ * 
+ * @param parser The parser to deallocate.
+ */
+void p_destroyJSONParser(JSONParser* parser) {
+    for(int i=0; i<parser->arena.numberOfBlocks; i++) {
+        libjson_dealloc(parser->arena.blocks[i]);
+    }
+    libjson_dealloc(parser->arena.blocks);
+    libjson_dealloc(parser->arena.sizes);
+    parser->arena.numberOfBlocks = 0;
+    parser->arena.block = 0;
+    parser->arena.used = 0;
+    parser->arena.last = NULL;
+
+    libjson_release(parser->stack.frames, sizeof(JSONFrame)*parser->stack.capacity);
+    parser->stack.frames = NULL;
+    libjson_dealloc(parser->shapes);
+    parser->shapeCapacity = 0;
+    parser->stack.depth = 0;
+    parser->stack.capacity = 0;
+
+    // Strings still used by documents are freed with the last of them
+    for(int i=0; i<parser->internCapacity; i++) {
+        if(parser->interned[i]) {
+            libjson_releaseInterned((char*)(parser->interned[i]+1));
+        }
+    }
+    libjson_dealloc(parser->interned);
+    parser->numberOfInterned = 0;
+    parser->internCapacity = 0;
+}
+
+// -- Parser --
+/**
+ * Parse a string into a JSONObject, without recursion.
+ * If parsing fails, @c error of the parser says why and where.
+ * @warning The @p str must be valid json.
+ * @warning With @c reuse, the result is read only, and only lasts until the parser's next parse.
+ * Setting, removing, taking or referencing values in it does nothing.
+ * 
+ * @param parser The parser to parse with. Its memory is reused by later parses.
+ * @param str    The json to parse.
+ * @return The JSONObject representation of the parsed string, or an empty object if it can't be parsed.
+ */
+JSONObject p_parseJSONObject(JSONParser* parser, char* str) {
+    JSONElement root = libjson_emptyJSONElement();
+
+    if(libjson_parse(parser, str, libjson_strlen(str), &root) >= 0 && root.type != object) {
+        parser->error.offset = libjson_skipWhitespace(str, 0);
+        parser->error.kind = str[parser->error.offset] == '\0' ? errorUnexpectedEnd : errorUnexpectedCharacter;
+        e_destroyJSONElement(&root);
+    }
+    return root.type == object ? root.object : o_emptyJSONObject();
+}
+
+/**
+ * Parse a string into a JSONArray, without recursion.
+ * If parsing fails, @c error of the parser says why and where.
+ * @warning The @p str must be valid json.
+ * @warning With @c reuse, the result is read only, and only lasts until the parser's next parse.
+ * Setting, removing, taking or referencing values in it does nothing.
+ * 
+ * @param parser The parser to parse with. Its memory is reused by later parses.
+ * @param str    The json to parse.
+ * @return The JSONArray representation of the parsed string, or an empty array if it can't be parsed.
+ */
+JSONArray p_parseJSONArray(JSONParser* parser, char* str) {
+    JSONElement root = libjson_emptyJSONElement();
+
+    if(libjson_parse(parser, str, libjson_strlen(str), &root) >= 0 && root.type != array) {
+        parser->error.offset = libjson_skipWhitespace(str, 0);
+        parser->error.kind = str[parser->error.offset] == '\0' ? errorUnexpectedEnd : errorUnexpectedCharacter;
+        e_destroyJSONElement(&root);
+    }
+    return root.type == array ? root.array : a_emptyJSONArray();
+}
+
+/**
+ * Parse only some of the values in a string into a JSONObject, without recursion.
+ * The paths are the same as for o_parseJSONObjectFields. Values kept whole, and the containers
+ * leading to them, may be nested up to the parser's @c maxDepth deep.
+ * If parsing fails, @c error of the parser says why and where.
+ * @warning The @p str must be valid json.
+ * 
+ * @param parser        The parser to parse with. Only its stack and depth limit are used.
+ * @param str           The json to parse.
+ * @param paths         The keys or JSON Pointers of the values to keep.
+ * @param numberOfPaths How many paths there are.
+ * @return The JSONObject representation of the requested values of the parsed string,
+ *         or an empty object if it can't be parsed.
+ */
+JSONObject p_parseJSONObjectFields(JSONParser* parser, char* str, char** paths, int numberOfPaths) {
+    JSONElement root = libjson_emptyJSONElement();
+    JSONProjection projection = {NULL, NULL, 0, false};
+
+    parser->error.kind = errorNone;
+    parser->error.offset = 0;
+
+    for(int i=0; i<numberOfPaths; i++) {
+        libjson_addProjection(&projection, paths[i]);
+    }
+
+    int i = libjson_skipWhitespace(str, 0);
+    if(str[i] == '{') {
+        root.type = object;
+        root.object = o_emptyJSONObject();
+        if(libjson_project(parser, str, i, libjson_strlen(str), &projection, &root) < 0) {
+            e_destroyJSONElement(&root);
+        }
+    } else {
+        parser->error.kind = str[i] == '\0' ? errorUnexpectedEnd : errorUnexpectedCharacter;
+        parser->error.offset = i;
+    }
+    libjson_destroyProjection(&projection);
+
+    return root.type == object ? root.object : o_emptyJSONObject();
+}
+
+/*=============================================================================
+    Validation
+=============================================================================*/
+
+// -- Check --
+/**
+ * Check that a string is well-formed json (RFC 8259), without allocating anything.
+ * Any value is accepted at the top level, surrounded by optional whitespace.
+ * Strings must be valid UTF-8, and objects and arrays may be nested up to LIBJSON_MAX_DEPTH deep.
+ * 
+ * @param str    The json to check. Doesn't need to be null terminated.
+ * @param length How many characters @p str has.
+ * @return The kind and offset of the first error, or errorNone if the json is valid.
+ */
+JSONError v_validate(char* str, int length) {
+    JSONError error = {errorNone, 0};
+    uint64_t objects[(LIBJSON_MAX_DEPTH+63)/64] = {0};
+    int depth = 0;
+    bool expectKey = false;
+    bool expectValue = true;
+    int i = libjson_validateWhitespace(str, 0, length);
+
+    while(error.kind == errorNone) {
+        if(i >= length) {
+            if(expectValue || depth > 0) {
+                error.kind = errorUnexpectedEnd;
+                error.offset = i;
+            }
+            break;
+        }
+
+        char c = str[i];
+
+        if(expectKey) {
+            if(c != '\"') {
+                error.kind = errorUnexpectedCharacter;
+                error.offset = i;
+                break;
+            }
+
+            i = libjson_validateWhitespace(str, libjson_validateString(str, i, length, &error), length);
+            if(error.kind == errorNone && (i >= length || str[i] != ':')) {
+                error.kind = i >= length ? errorUnexpectedEnd : errorUnexpectedCharacter;
+                error.offset = i;
+            }
+            i = libjson_validateWhitespace(str, i+1, length);
+            expectKey = false;
+            expectValue = true;
+        } else if(expectValue) {
+            if(c == '{' || c == '[') {
+                if(depth == LIBJSON_MAX_DEPTH) {
+                    error.kind = errorTooDeep;
+                    error.offset = i;
+                    break;
+                }
+
+                if(c == '{') {
+                    objects[depth/64] |= (uint64_t)1 << (depth%64);
+                } else {
+                    objects[depth/64] &= ~((uint64_t)1 << (depth%64));
+                }
+                depth++;
+                i = libjson_validateWhitespace(str, i+1, length);
+
+                if(i < length && str[i] == (c == '{' ? '}' : ']')) {
+                    depth--;
+                    i = libjson_validateWhitespace(str, i+1, length);
+                    expectValue = false;
+                } else {
+                    expectKey = c == '{';
+                    expectValue = c == '[';
+                }
+                continue;
+            }
+
+            if(c == '\"') {
+                i = libjson_validateString(str, i, length, &error);
+            } else if(c == '-' || libjson_isdigit(c)) {
+                i = libjson_validateNumber(str, i, length, &error);
+            } else if(c == 't' || c == 'f' || c == 'n') {
+                const char* literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+                int j = 0;
+
+                for(; literal[j] != '\0' && i+j < length && str[i+j] == literal[j]; j++);
+
+                if(literal[j] != '\0') {
+                    error.kind = i+j >= length ? errorUnexpectedEnd : errorInvalidLiteral;
+                    error.offset = i+j;
+                }
+                i += j;
+            } else {
+                error.kind = errorUnexpectedCharacter;
+                error.offset = i;
+            }
+            expectValue = false;
+        } else {
+            bool inObject = depth > 0 && (objects[(depth-1)/64] >> ((depth-1)%64) & 1);
+
+            if(depth == 0) {
+                error.kind = errorTrailingCharacters;
+                error.offset = i;
+            } else if(c == ',') {
+                expectKey = inObject;
+                expectValue = !inObject;
+                i = libjson_validateWhitespace(str, i+1, length);
+                continue;
+            } else if(c == (inObject ? '}' : ']')) {
+                depth--;
+                i++;
+            } else {
+                error.kind = errorUnexpectedCharacter;
+                error.offset = i;
+            }
+        }
+
+        if(error.kind == errorNone) {
+            i = libjson_validateWhitespace(str, i, length);
+        }
+    }
+    return error;
+}
+
+/**
+ * Describe a kind of validation error.
+ * 
+ * @param kind The kind of error.
+ * @return A description of the error.
+ */
+const char* v_errorMessage(JSONErrorKind kind) {
+    switch(kind) {
+        case errorNone:                return "No error";
+        case errorUnexpectedEnd:       return "Unexpected end of json";
+        case errorUnexpectedCharacter: return "Unexpected character";
+        case errorInvalidNumber:       return "Invalid number";
+        case errorInvalidLiteral:      return "Invalid literal";
+        case errorInvalidEscape:       return "Invalid escape sequence";
+        case errorControlCharacter:    return "Unescaped control character in string";
+        case errorInvalidUTF8:         return "Invalid UTF-8 in string";
+        case errorTooDeep:             return "Nested too deeply";
+        case errorTrailingCharacters:  return "Trailing characters after json";
+        case errorRead:                return "Couldn't read json";
+        case errorOutOfMemory:         return "Ran out of memory";
+    }
+    return "Unknown error";
+}
+
+/*=============================================================================
+    JSONFormatter
+=============================================================================*/
+
+// -- Constructor --
+/**
+ * Create a formatter which writes json minified, or pretty printed.
+ * 
+ * @param writer The writer to write the output to. Its own tracking of objects and arrays isn't used.
+ * @param indent How many spaces to indent each level by, or 0 to minify.
+ * @return A formatter at the start of a document.
+ */
+JSONFormatter f_emptyJSONFormatter(JSONWriter* writer, int indent) {
+    JSONFormatter formatter;
+
+    formatter.writer = writer;
+    formatter.indent = indent;
+    formatter.depth = 0;
+    formatter.inString = false;
+    formatter.escaped = false;
+    formatter.open = false;
+
+    return formatter;
+}
+
+// -- Formatting --
+/**
+ * Minify or pretty print the next chunk of a json document.
+ * Chunks may be split anywhere, including within strings and numbers.
+ * Whitespace outside of strings is dropped or replaced, and everything else is copied as is.
+ * @warning The json isn't validated.
+ * 
+ * @param formatter The formatter to format with.
+ * @param json      The next chunk of the document. Doesn't need to be null terminated.
+ * @param length    How many characters @p json has.
+ */
+void f_format(JSONFormatter* formatter, const char* json, int length) {
+    JSONWriter* writer = formatter->writer;
+    int i = 0;
+
+    while(i < length) {
+        if(formatter->escaped) {
+            libjson_writerAppend(writer, json+i, 1);
+            formatter->escaped = false;
+            i++;
+            continue;
+        }
+
+        if(formatter->inString) {
+            int run = libjson_tokenRun(json+i, length-i, true);
+            libjson_writerAppend(writer, json+i, run);
+            i += run;
+
+            if(i < length) {
+                libjson_writerAppend(writer, json+i, 1);
+                formatter->escaped = json[i] == '\\';
+                formatter->inString = json[i] != '\"';
+                i++;
+            }
+            continue;
+        }
+
+        char c = json[i];
+
+        if(c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            i += libjson_whitespaceRun(json+i, length-i);
+            continue;
+        }
+
+        if(formatter->indent == 0 && c != '\"') {
+            int run = libjson_tokenRun(json+i, length-i, false);
+            libjson_writerAppend(writer, json+i, run);
+            i += run;
+            continue;
+        }
+
+        if(c == '}' || c == ']') {
+            formatter->depth--;
+            if(!formatter->open) {
+                libjson_writeIndent(formatter);
+            }
+            formatter->open = false;
+            libjson_writerAppend(writer, json+i, 1);
+            i++;
+            continue;
+        }
+
+        if(formatter->open) {
+            libjson_writeIndent(formatter);
+            formatter->open = false;
+        }
+
+        if(c == ',') {
+            libjson_writerAppend(writer, ",", 1);
+            libjson_writeIndent(formatter);
+            i++;
+        } else if(c == ':') {
+            libjson_writerAppend(writer, formatter->indent ? ": " : ":", formatter->indent ? 2 : 1);
+            i++;
+        } else if(c == '{' || c == '[') {
+            libjson_writerAppend(writer, json+i, 1);
+            formatter->depth++;
+            formatter->open = true;
+            i++;
+        } else if(c == '\"') {
+            libjson_writerAppend(writer, json+i, 1);
+            formatter->inString = true;
+            i++;
+        } else {
+            int run = libjson_tokenRun(json+i, length-i, false);
+            for(int j=0; j<run; j++) {
+                char d = json[i+j];
+                if(d == ',' || d == ':' || d == '{' || d == '}' || d == '[' || d == ']') {
+                    run = j;
+                    break;
+                }
+            }
+            libjson_writerAppend(writer, json+i, run);
+            i += run;
+        }
+    }
+}
+
+/**
+ * Minify or pretty print the rest of a file, a chunk at a time.
+ * 
+ * @param formatter The formatter to format with.
+ * @param file      The file to read json from.
+ * @return If the whole file was read, true. If reading failed, false.
+ */
+bool f_formatFile(JSONFormatter* formatter, FILE* file) {
+    char chunk[LIBJSON_WRITER_FLUSH];
+    size_t length;
+
+    while((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        f_format(formatter, chunk, (int)length);
+    }
+    return !ferror(file);
+}
+
+/*=============================================================================
+    JSONPool
+=============================================================================*/
+
+// -- Destructor --
+/**
+ * Free the blocks the calling thread's JSONPool is keeping, such as before the thread exits.
+ * Does nothing without LIBJSON_POOL.
+ */
+void m_drainJSONPool(void) {
+#ifdef LIBJSON_POOL
+    for(int k=0; k<LIBJSON_POOL_CLASSES; k++) {
+        while(libjson_pool.blocks[k]) {
+            void* block = libjson_pool.blocks[k];
+            libjson_pool.blocks[k] = *(void**)block;
+            free(block);
+        }
+        libjson_pool.sizes[k] = 0;
+    }
+#endif
+}
+
+// -- Helper functions --
+
+/**
+ * Create an empty, or null, json value.
+ * 
+ * @return An empty json value.
+ */
+static JSONElement libjson_emptyJSONElement(void) {
+    JSONElement empty;
+
+    empty.type = null;
+    empty.flags = 0;
+    empty.object = o_emptyJSONObject();
+
+    return empty;
+}
+
+/**
+ * Convert the characters of a json number into a json value.
+ * Numbers without a fraction or exponent that fit in 64 bits are held as integers.
+ * 
+ * @param str The number to convert.
+ * @return The number as a json value.
+ */
+static JSONElement libjson_parseNumber(char* str) {
+    JSONElement element = libjson_emptyJSONElement();
+    element.type = number;
+
+    bool negative = str[0] == '-';
+    bool overflow = false;
+    uint64_t magnitude = 0;
+    int start = negative ? 1 : 0;
+    int i = start;
+
+    for(; libjson_isdigit(str[i]); i++) {
+        uint64_t digit = (uint64_t)(str[i] - '0');
+        if(magnitude > (UINT64_MAX - digit) / 10) {
+            overflow = true;
+            break;
+        }
+        magnitude = magnitude*10 + digit;
+    }
+
+    if(str[i] == '\0' && i > start && !overflow && magnitude <= (uint64_t)INT64_MAX + (uint64_t)start) {
+        element.flags = LIBJSON_INTEGER;
+        element.integer = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    } else {
+        sscanf(str, "%lf", &element.number);
+    }
+    return element;
+}
+
+/**
+ * Convert a number held as its json text into an integer or a double.
+ * 
+ * @param element The number to convert.
+ * @return The converted number, or @p element itself if it isn't LIBJSON_RAW.
+ */
+static JSONElement libjson_decodeNumber(const JSONElement* element) {
+    if(!(element->flags & LIBJSON_RAW)) {
+        return *element;
+    }
+    return libjson_parseNumber(element->flags & LIBJSON_INLINE ? (char*)element->inlined : element->string);
+}
+
+/**
+ * Allocate memory for use by a string.
+ * @note Memory is initialized to null bytes.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param size The number of characters in the string.
+ * 
+ * @return The allocated string, or NULL if it fails.
+ */
+static char* libjson_emptyString(int size) {
+    size++;
+    char* memory = (char*)libjson_allocate(size+1);
+
+    if(memory) {
+        for(int i=0; i<=size; i++) {
+            memory[i] = '\0';
+        }
+    }
+    return memory;
+}
+
+/**
+ * Copy the string enclosed by quotation marks from the beginning of @p str.
+ * @note Escape sequences are decoded, with \\u escapes (including surrogate pairs) written as UTF-8.
+ * Unpaired surrogates are written as U+FFFD.
+ * @warning The first character of @p str must be ", and there must eventually be an unescaped ".
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param str The string to extract a json string from.
+ * @param end The index just after the closing ".
+ * @return The json string with no enclosing quotation marks.
+ */
+static char* libjson_extractString(char* str, int end) {
+    char* s = libjson_emptyString(end-2);
+
+#ifdef LIBJSON_VALIDATE_UTF8
+    int length = libjson_decodeString(str, end, s);
+    if(libjson_scanUTF8(s, length) < length) {
+        // Copied so that the string is allocated like any other, and can go back to the JSONPool
+        char* repaired = libjson_repairUTF8(s, length);
+        libjson_releaseString(s);
+        s = libjson_strcpy(repaired);
+        libjson_dealloc(repaired);
+    }
+#else
+    libjson_decodeString(str, end, s);
+#endif
+    return s;
+}
+
+/**
+ * Decode the contents of a json string, without its quotation marks.
+ * @warning @p s must have space for at least @p end-1 characters.
+ * 
+ * @param str The json string, starting with its opening ".
+ * @param end The index just after the closing ".
+ * @param s   Where to write the decoded string. It is null terminated.
+ * @return The length of the decoded string.
+ */
+static int libjson_decodeString(char* str, int end, char* s) {
+    int length = 0;
+    int i = 1;
+
+    while(i < end-1) {
+        int next = libjson_scanString(str, i, end-1);
+        for(; i<next; i++) {
+            s[length++] = str[i];
+        }
+
+        if(str[i] != '\\') {
+            break;
+        }
+
+        char c = str[++i];
+        switch(c) {
+            case 'b': s[length++] = '\b'; break;
+            case 'f': s[length++] = '\f'; break;
+            case 'n': s[length++] = '\n'; break;
+            case 'r': s[length++] = '\r'; break;
+            case 't': s[length++] = '\t'; break;
+            case 'u': {
+                int codePoint = libjson_hexValue(str+i+1);
+                if(codePoint < 0) {
+                    s[length++] = c;
+                    break;
+                }
+                i += 4;
+
+                if(codePoint >= 0xD800 && codePoint <= 0xDBFF && str[i+1] == '\\' && str[i+2] == 'u') {
+                    int low = libjson_hexValue(str+i+3);
+                    if(low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+
+                if(codePoint >= 0xD800 && codePoint <= 0xDFFF) {
+                    codePoint = 0xFFFD;
+                }
+                length += libjson_encodeUTF8((unsigned)codePoint, s+length);
+                break;
+            }
+            default:
+                s[length++] = c;
+                break;
+        }
+        i++;
+    }
+    s[length] = '\0';
+    return length;
+}
+
+/**
+ * Extract the string enclosed by quotation marks from the beginning of @p str into a value,
+ * holding it within the value if it's short enough.
+ * @warning The first character of @p str must be ", and there must eventually be an unescaped ".
+ * 
+ * @param str     The string to extract a json string from.
+ * @param end     The index just after the closing ".
+ * @param element Where to store the string.
+ * @param arena   The arena to put a long string in, or NULL to allocate it.
+ */
+static void libjson_extractStringElement(char* str, int end, JSONElement* element, JSONArena* arena) {
+    element->type = string;
+    element->flags = 0;
+
+    // Escapes only ever shorten a string, so its length in json bounds its decoded length
+    if(end-1 > LIBJSON_INLINE_LENGTH) {
+        element->string = arena ? libjson_arenaString(arena, str, end) : libjson_extractString(str, end);
+        element->flags = arena ? LIBJSON_ARENA : LIBJSON_POOLED;
+        return;
+    }
+
+    element->flags = LIBJSON_INLINE;
+
+#ifdef LIBJSON_VALIDATE_UTF8
+    int length = libjson_decodeString(str, end, element->inlined);
+    if(libjson_scanUTF8(element->inlined, length) < length) {
+        char* repaired = libjson_repairUTF8(element->inlined, length);
+        element->string = arena ? repaired : libjson_strcpy(repaired);
+        element->flags = arena ? LIBJSON_ARENA : LIBJSON_POOLED;
+
+        if(!arena) {
+            libjson_dealloc(repaired);
+        } else if(repaired) {
+            element->string = (char*)libjson_arenaAlloc(arena, libjson_strlen(repaired)+1);
+            for(int i=0; element->string && i<=libjson_strlen(repaired); i++) {
+                element->string[i] = repaired[i];
+            }
+            libjson_dealloc(repaired);
+        }
+    }
+#else
+    libjson_decodeString(str, end, element->inlined);
+#endif
+}
+
+/**
+ * Copy a string into a value, holding it within the value if it's short enough.
+ * 
+ * @param str     The string to copy.
+ * @param element Where to store the string.
+ */
+static void libjson_copyStringElement(const char* str, JSONElement* element) {
+    element->type = string;
+    element->flags = 0;
+
+    int length = libjson_strlen(str);
+    if(length >= LIBJSON_INLINE_LENGTH) {
+        element->string = libjson_strcpy(str);
+        element->flags = LIBJSON_POOLED;
+        return;
+    }
+
+    for(int i=0; i<=length; i++) {
+        element->inlined[i] = str[i];
+    }
+    element->flags = LIBJSON_INLINE;
+}
+
+/**
+ * Extract the string enclosed by quotation marks from the beginning of @p str into a value,
+ * sharing the parser's copy of it if it has one, and interning it if not.
+ * Strings which are short enough to be held within the value, long strings, and strings with escapes are extracted as usual.
+ * @warning The first character of @p str must be ", and there must eventually be an unescaped ".
+ * 
+ * @param parser  The parser whose interned strings to use.
+ * @param str     The string to extract a json string from.
+ * @param end     The index just after the closing ".
+ * @param element Where to store the string.
+ */
+static void libjson_internStringElement(JSONParser* parser, char* str, int end, JSONElement* element) {
+    int length = end-2;
+    bool plain = length >= LIBJSON_INLINE_LENGTH && length <= parser->internLength;
+
+    uint64_t hash = 14695981039346656037ull;
+    for(int i=1; plain && i<end-1; i++) {
+        plain = str[i] != '\\';
+        hash = (hash ^ (unsigned char)str[i]) * 1099511628211ull;
+    }
+#ifdef LIBJSON_VALIDATE_UTF8
+    plain = plain && libjson_scanUTF8(str+1, length) == length;
+#endif
+
+    if(!plain) {
+        libjson_extractStringElement(str, end, element, NULL);
+        return;
+    }
+
+    unsigned mask = (unsigned)(parser->internCapacity-1);
+    unsigned slot = (unsigned)hash & mask;
+    for(; parser->internCapacity > 0 && parser->interned[slot]; slot = (slot+1) & mask) {
+        JSONInterned* candidate = parser->interned[slot];
+        if(candidate->hash == hash && candidate->length == length && libjson_keyEquals(str, 1, end-1, (char*)(candidate+1))) {
+            candidate->references++;
+            element->type = string;
+            element->flags = LIBJSON_INTERNED;
+            element->string = (char*)(candidate+1);
+            return;
+        }
+    }
+
+    if(parser->numberOfInterned >= LIBJSON_INTERN_LIMIT) {
+        libjson_extractStringElement(str, end, element, NULL);
+        return;
+    }
+
+    // Grow the table before it's half full
+    if((parser->numberOfInterned+1)*2 > parser->internCapacity) {
+        int capacity = parser->internCapacity ? parser->internCapacity*2 : 64;
+        JSONInterned** interned = (JSONInterned**)calloc(capacity, sizeof(JSONInterned*));
+        if(!interned) {
+            fprintf(stderr, "Ran out of memory in internStringElement");
+            libjson_extractStringElement(str, end, element, NULL);
+            return;
+        }
+
+        for(int i=0; i<parser->internCapacity; i++) {
+            if(parser->interned[i]) {
+                unsigned s = (unsigned)parser->interned[i]->hash & (unsigned)(capacity-1);
+                while(interned[s]) {
+                    s = (s+1) & (unsigned)(capacity-1);
+                }
+                interned[s] = parser->interned[i];
+            }
+        }
+        libjson_dealloc(parser->interned);
+        parser->interned = interned;
+        parser->internCapacity = capacity;
+        mask = (unsigned)(capacity-1);
+    }
+
+    JSONInterned* interned = (JSONInterned*)libjson_allocate(sizeof(JSONInterned) + length+1);
+    if(!interned) {
+        fprintf(stderr, "Ran out of memory in internStringElement");
+        libjson_extractStringElement(str, end, element, NULL);
+        return;
+    }
+
+    interned->references = 2;
+    interned->length = length;
+    interned->hash = hash;
+
+    char* text = (char*)(interned+1);
+    for(int i=0; i<length; i++) {
+        text[i] = str[i+1];
+    }
+    text[length] = '\0';
+
+    slot = (unsigned)hash & mask;
+    while(parser->interned[slot]) {
+        slot = (slot+1) & mask;
+    }
+    parser->interned[slot] = interned;
+    parser->numberOfInterned++;
+
+    element->type = string;
+    element->flags = LIBJSON_INTERNED;
+    element->string = text;
+}
+
+/**
+ * Give up a reference to an interned string, freeing it once nothing references it.
+ * 
+ * @param str The string, just after its JSONInterned.
+ */
+static void libjson_releaseInterned(char* str) {
+    JSONInterned* interned = (JSONInterned*)str - 1;
+    if(--interned->references > 0) {
+        return;
+    }
+    libjson_release(interned, sizeof(JSONInterned) + interned->length+1);
+}
+
+/**
+ * Find the first character at or after an index that isn't whitespace.
+ * 
+ * @param str The string to search.
+ * @param i   The index to start at.
+ * @return The index of the first character which isn't whitespace.
+ */
+static int libjson_skipWhitespace(char* str, int i) {
+    while(libjson_isspace(str[i])) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Step over a json string without copying it.
+ * @warning The character at @p i must be ".
+ * 
+ * @param str    The string containing json.
+ * @param i      The index of the opening quotation mark.
+ * @param length How many characters @p str has.
+ * @return The index just after the closing quotation mark, or -1 if the string isn't terminated.
+ */
+static int libjson_skipString(char* str, int i, int length) {
+    for(i++;; i+=2) {
+        i = libjson_scanString(str, i, length);
+
+        if(i < length && str[i] == '\"') {
+            return i+1;
+        }
+
+        if(i+1 >= length) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Find the next character within a json string which ends a run of plain characters.
+ * The string is searched a vector at a time, then a character at a time for the last partial vector.
+ * 
+ * @param str    The string containing json.
+ * @param i      The index to start searching from.
+ * @param length How many characters @p str has.
+ * @return The index of the next " or \, or @p length if there isn't one.
+ */
+static int libjson_scanString(char* str, int i, int length) {
+#if defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('\"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+
+    for(; i+32 <= length; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(str+i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i quote16 = _mm_set1_epi8('\"');
+    const __m128i backslash16 = _mm_set1_epi8('\\');
+
+    for(; i+16 <= length; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str+i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote16), _mm_cmpeq_epi8(v, backslash16));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    while(i < length && str[i] != '\"' && str[i] != '\\') {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Check a json string, stepping over runs of plain characters a vector at a time.
+ * @warning The character at @p i must be ".
+ * 
+ * @param str    The json being checked.
+ * @param i      The index of the opening quotation mark.
+ * @param length How many characters @p str has.
+ * @param error  Where to store the error, if the string is invalid.
+ * @return The index just after the closing quotation mark.
+ */
+static int libjson_validateString(const char* str, int i, int length, JSONError* error) {
+    for(i++; i < length;) {
+        int run = libjson_escapeScan(str+i, length-i, false);
+        int valid = libjson_scanUTF8(str+i, run);
+
+        if(valid < run) {
+            error->kind = errorInvalidUTF8;
+            error->offset = i+valid;
+            return i+valid;
+        }
+        i += run;
+
+        if(i >= length) {
+            break;
+        }
+
+        char c = str[i];
+        if(c == '\"') {
+            return i+1;
+        }
+
+        if(c != '\\') {
+            error->kind = errorControlCharacter;
+            error->offset = i;
+            return i;
+        }
+
+        if(i+1 >= length) {
+            break;
+        }
+
+        c = str[i+1];
+        if(c == 'u') {
+            if(i+6 > length) {
+                i = length;
+                break;
+            }
+
+            if(libjson_hexValue((char*)str+i+2) < 0) {
+                error->kind = errorInvalidEscape;
+                error->offset = i;
+                return i;
+            }
+            i += 6;
+        } else if(c == '\"' || c == '\\' || c == '/' || c == 'b' || c == 'f' || c == 'n' || c == 'r' || c == 't') {
+            i += 2;
+        } else {
+            error->kind = errorInvalidEscape;
+            error->offset = i;
+            return i;
+        }
+    }
+
+    error->kind = errorUnexpectedEnd;
+    error->offset = length;
+    return length;
+}
+
+/**
+ * Check a json number.
+ * 
+ * @param str    The json being checked.
+ * @param i      The index of the first character of the number.
+ * @param length How many characters @p str has.
+ * @param error  Where to store the error, if the number is invalid.
+ * @return The index just after the number.
+ */
+static int libjson_validateNumber(const char* str, int i, int length, JSONError* error) {
+    int start = i;
+
+    if(str[i] == '-') {
+        i++;
+    }
+
+    if(i < length && str[i] == '0') {
+        i++;
+    } else if(i < length && libjson_isdigit(str[i])) {
+        for(; i < length && libjson_isdigit(str[i]); i++);
+    } else {
+        error->kind = i >= length ? errorUnexpectedEnd : errorInvalidNumber;
+        error->offset = i;
+        return i;
+    }
+
+    if(i < length && str[i] == '.') {
+        int digits = ++i;
+        for(; i < length && libjson_isdigit(str[i]); i++);
+
+        if(i == digits) {
+            error->kind = i >= length ? errorUnexpectedEnd : errorInvalidNumber;
+            error->offset = i;
+            return i;
+        }
+    }
+
+    if(i < length && (str[i] == 'e' || str[i] == 'E')) {
+        i++;
+        if(i < length && (str[i] == '+' || str[i] == '-')) {
+            i++;
+        }
+
+        int digits = i;
+        for(; i < length && libjson_isdigit(str[i]); i++);
+
+        if(i == digits) {
+            error->kind = i >= length ? errorUnexpectedEnd : errorInvalidNumber;
+            error->offset = i;
+            return i;
+        }
+    }
+
+    if(i < length && (libjson_isdigit(str[i]) || str[i] == '.')) {
+        error->kind = errorInvalidNumber;
+        error->offset = start;
+    }
+    return i;
+}
+
+/**
+ * Step over the whitespace json allows between values: spaces, tabs, line feeds and carriage returns.
+ * 
+ * @param str    The json being checked.
+ * @param i      The index to start from.
+ * @param length How many characters @p str has.
+ * @return The index of the first character which isn't whitespace, or @p length.
+ */
+static int libjson_validateWhitespace(const char* str, int i, int length) {
+    while(i < length && (str[i] == ' ' || str[i] == '\t' || str[i] == '\n' || str[i] == '\r')) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Find the first invalid UTF-8 in a string.
+ * Overlong encodings, surrogates and code points above U+10FFFF are invalid.
+ * Runs of ASCII are stepped over a vector at a time.
+ * 
+ * @param str    The string to check.
+ * @param length How many characters @p str has.
+ * @return The index of the first invalid sequence, or @p length if there is none.
+ */
+static int libjson_scanUTF8(const char* str, int length) {
+    int i = 0;
+
+    while(i < length) {
+#if defined(__AVX2__)
+        while(i+32 <= length && _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(str+i))) == 0) {
+            i += 32;
+        }
+#endif
+#if defined(__SSE2__)
+        while(i+16 <= length && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(str+i))) == 0) {
+            i += 16;
+        }
+#endif
+        if(i >= length) {
+            break;
+        }
+
+        unsigned char c = (unsigned char)str[i];
+        if(c < 0x80) {
+            i++;
+            continue;
+        }
+
+        int continuation = c >= 0xF5 ? -1 : c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC2 ? 1 : -1;
+        if(continuation < 0 || i+continuation >= length) {
+            return i;
+        }
+
+        unsigned codePoint = c & (0x3F >> continuation);
+        for(int j=1; j<=continuation; j++) {
+            unsigned char next = (unsigned char)str[i+j];
+            if((next & 0xC0) != 0x80) {
+                return i;
+            }
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+
+        if((continuation == 2 && codePoint < 0x800) || (continuation == 3 && codePoint < 0x10000) ||
+           (codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF) {
+            return i;
+        }
+        i += continuation+1;
+    }
+    return length;
+}
+
+#ifdef LIBJSON_VALIDATE_UTF8
+/**
+ * Copy a string, replacing each byte of invalid UTF-8 with U+FFFD.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param str    The string to copy.
+ * @param length How many characters @p str has.
+ * @return The repaired copy.
+ */
+static char* libjson_repairUTF8(char* str, int length) {
+    JSONBuffer out = {NULL, 0, 0};
+    int i = 0;
+
+    while(i < length) {
+        int valid = libjson_scanUTF8(str+i, length-i);
+        libjson_bufferAppend(&out, str+i, valid);
+        i += valid;
+
+        if(i < length) {
+            libjson_bufferAppend(&out, "\xEF\xBF\xBD", 3);
+            i++;
+        }
+    }
+    libjson_bufferAppend(&out, "", 1);
+    return out.data;
+}
+#endif
+
+/**
+ * Step over a json value without allocating, copying or converting anything.
+ * Objects and arrays are stepped over by balancing brackets, and strings within them are skipped whole.
+ * @warning The character at @p i must be the first character of the value.
+ * 
+ * @param str    The string containing json.
+ * @param i      The index of the first character of the value.
+ * @param length How many characters @p str has.
+ * @return The index just after the value, or -1 if the value isn't terminated.
+ */
+static int libjson_skipValue(char* str, int i, int length) {
+    if(str[i] == '\"') {
+        return libjson_skipString(str, i, length);
+    }
+
+    if(str[i] != '{' && str[i] != '[') {
+        while(str[i] != '\0' && str[i] != ',' && str[i] != '}' && str[i] != ']' && !libjson_isspace(str[i])) {
+            i++;
+        }
+        return i;
+    }
+
+    int depth = 0;
+    while(str[i] != '\0') {
+        char c = str[i];
+
+        if(c == '\"') {
+            i = libjson_skipString(str, i, length);
+            if(i < 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        if(c == '{' || c == '[') {
+            depth++;
+        } else if(c == '}' || c == ']') {
+            if(--depth == 0) {
+                return i+1;
+            }
+        }
+        i++;
+    }
+    return -1;
+}
+
+/**
+ * Parse a json value starting at an index of a string.
+ * @warning The character at @p i must be the first character of the value.
+ * 
+ * @param str     The string containing json.
+ * @param i       The index of the first character of the value.
+ * @param length  How many characters @p str has.
+ * @param element Where to store the parsed value.
+ * @param parser  The parser whose options and arena to use, or NULL.
+ * @return The index just after the value, or -1 if the value isn't terminated.
+ */
+static int libjson_parseValue(char* str, int i, int length, JSONElement* element, JSONParser* parser) {
+    char c = str[i];
+    bool raw = parser && parser->raw;
+    JSONArena* arena = parser && parser->reuse ? &parser->arena : NULL;
+    *element = libjson_emptyJSONElement();
+
+    if(c == '{' || c == '[') {
+        JSONParser parser = p_emptyJSONParser();
+        parser.raw = raw;
+        int end = libjson_parse(&parser, str+i, length-i, element);
+        p_destroyJSONParser(&parser);
+        return end < 0 ? -1 : i+end;
+    }
+
+    int end = libjson_skipValue(str, i, length);
+    if(end < 0) {
+        return -1;
+    }
+
+    if(c == '\"' && parser && parser->intern && !arena) {
+        libjson_internStringElement(parser, str+i, end-i, element);
+    } else if(c == '\"') {
+        libjson_extractStringElement(str+i, end-i, element, arena);
+    } else if(c == 't' || c == 'f') {
+        element->type = boolean;
+        element->boolean = c == 't';
+    } else if((libjson_isdigit(c) || c == '-') && raw) {
+        element->type = number;
+        element->flags = LIBJSON_RAW | LIBJSON_INLINE;
+
+        char* text = element->inlined;
+        if(end-i >= LIBJSON_INLINE_LENGTH) {
+            element->flags = arena ? LIBJSON_RAW | LIBJSON_ARENA : LIBJSON_RAW | LIBJSON_POOLED;
+            element->string = text = arena ? (char*)libjson_arenaAlloc(arena, end-i+1) : libjson_emptyString(end-i);
+        }
+        for(int j=i; j<end && text; j++) {
+            text[j-i] = str[j];
+        }
+        if(text) {
+            text[end-i] = '\0';
+        }
+    } else if(libjson_isdigit(c) || c == '-') {
+        char tmp[128] = {0};
+        for(int j=i; j<end && j-i<127; j++) {
+            tmp[j-i] = str[j];
+        }
+        *element = libjson_parseNumber(tmp);
+    }
+    return end;
+}
+
+/**
+ * Compare a key within a json string to another key, without copying it.
+ * 
+ * @param str   The string containing json.
+ * @param start The index of the first character of the key, after the quotation mark.
+ * @param end   The index of the closing quotation mark of the key.
+ * @param key   The key to compare with.
+ * @return If the keys are identical, true. Otherwise, false.
+ */
+static bool libjson_keyEquals(char* str, int start, int end, const char* key) {
+    int i = 0;
+
+    for(; start+i < end; i++) {
+        if(key[i] != str[start+i]) {
+            return false;
+        }
+    }
+    return key[i] == '\0';
+}
+
+/**
+ * Add a path to a tree of keys to keep while parsing.
+ * 
+ * @param root The root of the tree.
+ * @param path A key of the outermost object, or a JSON Pointer.
+ */
+static void libjson_addProjection(JSONProjection* root, char* path) {
+    char* token = libjson_emptyString(libjson_strlen(path));
+    JSONProjection* node = root;
+    char* rest = path;
+    bool pointer = path[0] == '/';
+
+    while(!node->whole && (pointer ? *rest != '\0' : rest == path)) {
+        JSONProjection* child = NULL;
+
+        if(pointer) {
+            rest = libjson_pointerToken(rest, token);
+        } else {
+            libjson_dealloc(token);
+            token = libjson_strcpy(path);
+            rest = path + libjson_strlen(path);
+        }
+
+        for(int i=0; i<node->numberOfChildren && !child; i++) {
+            if(libjson_strcmp(node->children[i].key, token)) {
+                child = &node->children[i];
+            }
+        }
+
+        if(!child) {
+            JSONProjection* tmp = (JSONProjection*)realloc(node->children, sizeof(JSONProjection)*(node->numberOfChildren+1));
+            if(!tmp) {
+                fprintf(stderr, "Ran out of memory in addProjection");
+                break;
+            }
+            node->children = tmp;
+            child = &node->children[node->numberOfChildren++];
+            child->key = libjson_strcpy(token);
+            child->children = NULL;
+            child->numberOfChildren = 0;
+            child->whole = false;
+        }
+        node = child;
+    }
+
+    if(node != root) {
+        node->whole = true;
+    }
+    libjson_dealloc(token);
+}
+
+/**
+ * Free all heap memory used by a tree of keys to keep while parsing.
+ * 
+ * @param projection The root of the tree.
+ */
+static void libjson_destroyProjection(JSONProjection* projection) {
+    for(int i=0; i<projection->numberOfChildren; i++) {
+        libjson_destroyProjection(&projection->children[i]);
+    }
+    libjson_dealloc(projection->children);
+    libjson_dealloc(projection->key);
+    projection->numberOfChildren = 0;
+}
+
+/**
+ * Parse the values of a json object which are kept by a projection, stepping over the rest,
+ * without recursion. Arrays along the way keep each object or array within them, with the
+ * same projection applied to it. Each kept container is added to its parent when it's opened,
+ * and its frame on the parser's stack points at it there until it's closed.
+ * @warning The character at @p i must be {.
+ * 
+ * @param parser     The parser whose stack and depth limit to use, and to report errors with.
+ * @param str        The string containing json.
+ * @param i          The index of the opening brace.
+ * @param length     How many characters @p str has.
+ * @param projection The keys to keep.
+ * @param root       The object to set kept values in.
+ * @return The index just after the closing brace, or -1 if the object isn't valid.
+ */
+static int libjson_project(JSONParser* parser, char* str, int i, int length, JSONProjection* projection, JSONElement* root) {
+    JSONStack* stack = &parser->stack;
+    stack->depth = 0;
+
+    JSONFrame* frame = libjson_push(stack, root);
+    if(!frame) {
+        parser->error.kind = errorOutOfMemory;
+        parser->error.offset = i;
+        return -1;
+    }
+    frame->projection = projection;
+    i++;
+
+    while(stack->depth > 0) {
+        JSONFrame* top = &stack->frames[stack->depth-1];
+        JSONProjection* child = top->projection;
+
+        i = libjson_skipWhitespace(str, i);
+        if(str[i] == ',') {
+            i = libjson_skipWhitespace(str, i+1);
+        }
+
+        char c = str[i];
+        if(c == '\0') {
+            parser->error.kind = errorUnexpectedEnd;
+            parser->error.offset = i;
+            break;
+        }
+
+        if(c == '}' || c == ']') {
+            if((c == '}') != (top->element->type == object)) {
+                parser->error.kind = errorUnexpectedCharacter;
+                parser->error.offset = i;
+                break;
+            }
+            stack->depth--;
+            i++;
+            continue;
+        }
+
+        char* key = NULL;
+        if(top->element->type == object) {
+            int start = i+1;
+            int end = c == '\"' ? libjson_skipString(str, i, length) : -1;
+            if(end < 0) {
+                parser->error.kind = c == '\"' ? errorUnexpectedEnd : errorUnexpectedCharacter;
+                parser->error.offset = c == '\"' ? length : i;
+                break;
+            }
+
+            child = NULL;
+            for(int j=0; j<top->projection->numberOfChildren && !child; j++) {
+                if(libjson_keyEquals(str, start, end-1, top->projection->children[j].key)) {
+                    child = &top->projection->children[j];
+                }
+            }
+
+            i = libjson_skipWhitespace(str, end);
+            if(str[i] != ':') {
+                parser->error.kind = str[i] == '\0' ? errorUnexpectedEnd : errorUnexpectedCharacter;
+                parser->error.offset = i;
+                break;
+            }
+            i = libjson_skipWhitespace(str, i+1);
+            c = str[i];
+
+            if(child) {
+                key = libjson_extractString(str+start-1, end-start+1);
+            }
+        } else {
+            child = libjson_projectIndex(top->projection, top->next++);
+        }
+
+        JSONElement value = libjson_emptyJSONElement();
+        bool container = child && !child->whole && (c == '{' || c == '[');
+        int start = i;
+
+        if(child && child->whole && (c == '{' || c == '[')) {
+            // Values kept whole count towards the same depth limit as the rest of the document
+            JSONParser whole = p_emptyJSONParser();
+            whole.maxDepth = parser->maxDepth - stack->depth;
+            int end = libjson_parse(&whole, str+i, length-i, &value);
+            parser->error.kind = whole.error.kind;
+            parser->error.offset = i+whole.error.offset;
+            p_destroyJSONParser(&whole);
+            i = end < 0 ? -1 : i+end;
+        } else if(child && child->whole) {
+            i = libjson_parseValue(str, i, length, &value, NULL);
+        } else if(container) {
+            if(stack->depth >= parser->maxDepth) {
+                parser->error.kind = errorTooDeep;
+                parser->error.offset = i;
+                libjson_releaseString(key);
+                break;
+            }
+            value.type = c == '{' ? object : array;
+            if(c == '{') {
+                value.object = o_emptyJSONObject();
+            } else {
+                value.array = a_emptyJSONArray();
+            }
+            i++;
+        } else {
+            i = libjson_skipValue(str, i, length);
+            child = NULL;
+        }
+
+        if(i < 0) {
+            if(parser->error.kind == errorNone) {
+                parser->error.kind = errorUnexpectedEnd;
+                parser->error.offset = length;
+            }
+            libjson_releaseString(key);
+            e_destroyJSONElement(&value);
+            break;
+        }
+
+        if(!child) {
+            libjson_releaseString(key);
+            continue;
+        }
+
+        JSONElement* slot;
+        if(top->element->type == object) {
+            JSONObject* parent = &top->element->object;
+            libjson_movePair(parent, key, value);
+            slot = &parent->elements[parent->numberOfElements-1].value;
+        } else {
+            JSONArray* parent = &top->element->array;
+            a_moveJSONElement(parent, parent->numberOfElements, value);
+            slot = &parent->elements[parent->numberOfElements-1];
+        }
+
+        if(container) {
+            frame = libjson_push(stack, slot);
+            if(!frame) {
+                parser->error.kind = errorOutOfMemory;
+                parser->error.offset = start;
+                break;
+            }
+            frame->projection = child;
+        }
+    }
+
+    if(parser->error.kind != errorNone) {
+        stack->depth = 0;
+        return -1;
+    }
+    return i;
+}
+
+/**
+ * Find the node of a projection which keeps the value at an index of an array.
+ * Nodes whose keys are indexes keep only the values at those indexes. Without any,
+ * the array's own node keeps every value.
+ * 
+ * @param projection The node of the array.
+ * @param index      The index of the value.
+ * @return The node keeping the value, or NULL if it's skipped.
+ */
+static JSONProjection* libjson_projectIndex(JSONProjection* projection, int index) {
+    bool indexed = false;
+
+    for(int i=0; i<projection->numberOfChildren; i++) {
+        char* key = projection->children[i].key;
+        if(libjson_isdigit(key[0])) {
+            indexed = true;
+            if(libjson_pointerIndex(key, index) == index) {
+                return &projection->children[i];
+            }
+        }
+    }
+    return indexed ? NULL : projection;
+}
+
+/**
+ * Open a container on a stack, growing the stack if needed.
+ * 
+ * @param stack   The stack to push onto.
+ * @param element The object or array to visit.
+ * @return The container's frame, or NULL if there wasn't enough memory.
+ */
+static JSONFrame* libjson_push(JSONStack* stack, JSONElement* element) {
+    if(stack->depth == stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity*2 : 16;
+        JSONFrame* tmp = (JSONFrame*)libjson_resize(stack->frames, sizeof(JSONFrame)*stack->capacity, sizeof(JSONFrame)*capacity);
+        if(!tmp) {
+            fprintf(stderr, "Ran out of memory in push");
+            return NULL;
+        }
+        stack->frames = tmp;
+        stack->capacity = capacity;
+    }
+
+    JSONFrame* frame = &stack->frames[stack->depth++];
+    frame->element = element;
+    frame->key = NULL;
+    frame->next = 0;
+    frame->start = 0;
+    frame->shape = NULL;
+    frame->projection = NULL;
+    return frame;
+}
+
+/**
+ * Hand out memory from an arena, adding a block if none of its blocks have room left.
+ * 
+ * @param arena The arena to allocate from.
+ * @param size  How many bytes are needed.
+ * @return The memory, aligned for any value, or NULL if there wasn't enough memory.
+ */
+static void* libjson_arenaAlloc(JSONArena* arena, int size) {
+    size = (size + 7) & ~7;
+
+    while(arena->block < arena->numberOfBlocks && arena->sizes[arena->block] - arena->used < size) {
+        arena->block++;
+        arena->used = 0;
+    }
+
+    if(arena->block == arena->numberOfBlocks) {
+        int n = arena->numberOfBlocks;
+
+        // The list of blocks doubles whenever their number reaches a power of two
+        if((n & (n-1)) == 0) {
+            char** blocks = (char**)realloc(arena->blocks, sizeof(char*)*(n ? n*2 : 1));
+            if(blocks) {
+                arena->blocks = blocks;
+            }
+            int* sizes = (int*)realloc(arena->sizes, sizeof(int)*(n ? n*2 : 1));
+            if(sizes) {
+                arena->sizes = sizes;
+            }
+            if(!blocks || !sizes) {
+                fprintf(stderr, "Ran out of memory in arenaAlloc");
+                return NULL;
+            }
+        }
+
+        int blockSize = size > LIBJSON_ARENA_BLOCK ? size : LIBJSON_ARENA_BLOCK;
+        char* block = (char*)malloc(blockSize);
+        if(!block) {
+            fprintf(stderr, "Ran out of memory in arenaAlloc");
+            return NULL;
+        }
+        arena->blocks[n] = block;
+        arena->sizes[n] = blockSize;
+        arena->numberOfBlocks++;
+        arena->used = 0;
+    }
+
+    char* memory = arena->blocks[arena->block] + arena->used;
+    arena->used += size;
+    arena->last = memory;
+    return memory;
+}
+
+/**
+ * Make memory from an arena bigger, in place if it was the last memory handed out and its block has room.
+ * 
+ * @param arena   The arena the memory is from.
+ * @param memory  The memory to grow, or NULL.
+ * @param size    How many bytes @p memory has.
+ * @param newSize How many bytes are needed.
+ * @return The grown memory, holding what @p memory did, or NULL if there wasn't enough memory.
+ */
+static void* libjson_arenaGrow(JSONArena* arena, void* memory, int size, int newSize) {
+    if(memory && memory == arena->last) {
+        int start = (int)((char*)memory - arena->blocks[arena->block]);
+        int end = start + ((newSize + 7) & ~7);
+        if(end <= arena->sizes[arena->block]) {
+            arena->used = end;
+            return memory;
+        }
+    }
+
+    char* grown = (char*)libjson_arenaAlloc(arena, newSize);
+    for(int i=0; grown && i<size; i++) {
+        grown[i] = ((char*)memory)[i];
+    }
+    return grown;
+}
+
+/**
+ * Extract the string enclosed by quotation marks from the beginning of @p str into an arena.
+ * @warning The first character of @p str must be ", and there must eventually be an unescaped ".
+ * 
+ * @param arena The arena to put the string in.
+ * @param str   The string to extract a json string from.
+ * @param end   The index just after the closing ".
+ * @return The json string with no enclosing quotation marks, or NULL if there wasn't enough memory.
+ */
+static char* libjson_arenaString(JSONArena* arena, char* str, int end) {
+    char* s = (char*)libjson_arenaAlloc(arena, end-1);
+    if(!s) {
+        return NULL;
+    }
+
+#ifdef LIBJSON_VALIDATE_UTF8
+    int length = libjson_decodeString(str, end, s);
+    if(libjson_scanUTF8(s, length) < length) {
+        char* repaired = libjson_repairUTF8(s, length);
+        int repairedLength = repaired ? libjson_strlen(repaired) : 0;
+
+        s = repaired ? (char*)libjson_arenaAlloc(arena, repairedLength+1) : NULL;
+        for(int i=0; s && i<=repairedLength; i++) {
+            s[i] = repaired[i];
+        }
+        libjson_dealloc(repaired);
+    }
+#else
+    libjson_decodeString(str, end, s);
+#endif
+    return s;
+}
+
+/**
+ * Add a slot for a value to the end of an object or array being built in an arena.
+ * Their storage doubles whenever their size reaches a power of two.
+ * 
+ * @param arena     The arena the container is built in.
+ * @param container The object or array to add to.
+ * @param key       The key of the value, if @p container is an object. Replaces any earlier pair with the same key.
+ * @return The slot, or NULL if there wasn't enough memory.
+ */
+static JSONElement* libjson_arenaAppend(JSONArena* arena, JSONElement* container, char* key) {
+    if(container->type == array) {
+        JSONArray* json = &container->array;
+        int n = json->numberOfElements;
+        if((n & (n-1)) == 0) {
+            JSONElement* tmp = (JSONElement*)libjson_arenaGrow(arena, json->elements, sizeof(JSONElement)*n, sizeof(JSONElement)*(n ? n*2 : 1));
+            if(!tmp) {
+                return NULL;
+            }
+            json->elements = tmp;
+        }
+        json->numberOfElements++;
+        return &json->elements[n];
+    }
+
+    JSONObject* json = &container->object;
+
+    // As with o_moveJSONElement, a repeated key moves to the end
+    int index = libjson_find(json, key);
+    if(index >= 0) {
+        for(int i=index; i<json->numberOfElements-1; i++) {
+            json->elements[i] = json->elements[i+1];
+        }
+        json->numberOfElements--;
+    }
+
+    int n = json->numberOfElements;
+    if((n & (n-1)) == 0) {
+        JSONPair* tmp = (JSONPair*)libjson_arenaGrow(arena, json->elements, sizeof(JSONPair)*n, sizeof(JSONPair)*(n ? n*2 : 1));
+        if(!tmp) {
+            return NULL;
+        }
+        json->elements = tmp;
+    }
+    json->elements[n].key = key;
+    json->numberOfElements++;
+    return &json->elements[n].value;
+}
+
+/**
+ * Parse one json value from the start of a string, without recursion.
+ * Each object or array is added to its parent when it's opened, and its frame
+ * on the parser's stack points at it there until it's closed.
+ * 
+ * @param parser The parser to parse with.
+ * @param str    The string beginning with json.
+ * @param length How many characters @p str has.
+ * @param root   Where to store the parsed value.
+ * @return The index just after the value, or -1 if it can't be parsed.
+ */
+static int libjson_parse(JSONParser* parser, char* str, int length, JSONElement* root) {
+    JSONStack* stack = &parser->stack;
+    int i = libjson_skipWhitespace(str, 0);
+
+    *root = libjson_emptyJSONElement();
+    stack->depth = 0;
+    parser->error.kind = errorNone;
+    parser->error.offset = 0;
+
+    // Documents built by the last parse are overwritten
+    JSONArena* arena = parser->reuse ? &parser->arena : NULL;
+    bool share = parser->share && !arena;
+    if(arena) {
+        arena->block = 0;
+        arena->used = 0;
+        arena->last = NULL;
+    }
+
+    while(str[i] != '\0') {
+        char c = str[i];
+        JSONFrame* top = stack->depth > 0 ? &stack->frames[stack->depth-1] : NULL;
+
+        if(libjson_isspace(c) || c == ',' || c == ':') {
+            i++;
+            continue;
+        }
+
+        if(c == '}' || c == ']') {
+            if(!top || (c == '}') != (top->element->type == object)) {
+                parser->error.kind = errorUnexpectedCharacter;
+                parser->error.offset = i;
+                break;
+            }
+
+            JSONShape* shape = NULL;
+            if(c == '}') {
+                if(top->shape || arena) {
+                    top->key = NULL;
+                }
+                libjson_releaseString(top->key);
+                top->key = NULL;
+                if(share) {
+                    shape = libjson_shapeObject(parser, top);
+                }
+            }
+            stack->depth--;
+            i++;
+
+            if(stack->depth == 0) {
+                break;
+            }
+
+            // The next object within the same array is expected to have the same shape
+            if(stack->frames[stack->depth-1].element->type == array) {
+                stack->frames[stack->depth-1].shape = shape;
+            }
+            continue;
+        }
+
+        if(top && top->element->type == object && !top->key) {
+            if(c != '\"') {
+                parser->error.kind = errorUnexpectedCharacter;
+                parser->error.offset = i;
+                break;
+            }
+
+            int end = libjson_skipString(str, i, length);
+            if(end < 0) {
+                parser->error.kind = errorUnexpectedEnd;
+                parser->error.offset = length;
+                break;
+            }
+
+            // Borrow the key from the expected shape if it matches, rather than copying it
+            JSONShape* shape = top->shape;
+            int n = top->element->object.numberOfElements;
+            if(shape && n < shape->numberOfKeys && libjson_keyEquals(str, i+1, end-1, shape->keys[n])) {
+                top->key = shape->keys[n];
+            } else if(arena) {
+                top->key = libjson_arenaString(arena, str+i, end-i);
+            } else {
+                libjson_ownKeys(top);
+                top->key = libjson_extractString(str+i, end-i);
+            }
+            i = end;
+            continue;
+        }
+
+        JSONElement value = libjson_emptyJSONElement();
+        bool container = c == '{' || c == '[';
+        int start = i;
+
+        if(container) {
+            if(stack->depth >= parser->maxDepth) {
+                parser->error.kind = errorTooDeep;
+                parser->error.offset = i;
+                break;
+            }
+
+            if(c == '{') {
+                value.type = object;
+                value.object = o_emptyJSONObject();
+                value.object.flags = arena ? LIBJSON_ARENA : 0;
+            } else {
+                value.type = array;
+                value.array = a_emptyJSONArray();
+
+                value.array.flags = arena ? LIBJSON_ARENA : 0;
+
+                int end = parser->pack && !arena ? libjson_parsePacked(str, i, &value.array, parser->raw) : -1;
+                if(end >= 0) {
+                    container = false;
+                    i = end-1;
+                }
+            }
+            i++;
+        } else {
+            i = libjson_parseValue(str, i, length, &value, parser);
+            if(i < 0) {
+                parser->error.kind = errorUnexpectedEnd;
+                parser->error.offset = length;
+                break;
+            }
+        }
+
+        JSONElement* slot = root;
+        if(!top) {
+            *root = value;
+        } else if(arena) {
+            slot = libjson_arenaAppend(arena, top->element, top->key);
+            top->key = NULL;
+            if(!slot) {
+                parser->error.kind = errorOutOfMemory;
+                parser->error.offset = start;
+                break;
+            }
+            *slot = value;
+        } else if(top->element->type == object) {
+            JSONObject* parent = &top->element->object;
+            libjson_movePair(parent, top->key, value);
+            top->key = NULL;
+            slot = &parent->elements[parent->numberOfElements-1].value;
+        } else {
+            JSONArray* parent = &top->element->array;
+            a_moveJSONElement(parent, parent->numberOfElements, value);
+            slot = &parent->elements[parent->numberOfElements-1];
+        }
+
+        if(container) {
+            JSONShape* expected = top && top->element->type == array && c == '{' ? top->shape : NULL;
+            JSONFrame* frame = libjson_push(stack, slot);
+            if(!frame) {
+                parser->error.kind = errorOutOfMemory;
+                parser->error.offset = start;
+                break;
+            }
+            frame->shape = expected && expected->plain ? expected : NULL;
+        } else if(!top) {
+            break;
+        }
+    }
+
+    if(parser->error.kind == errorNone && stack->depth > 0) {
+        parser->error.kind = errorUnexpectedEnd;
+        parser->error.offset = i;
+    }
+
+    if(parser->error.kind != errorNone) {
+        for(int j=0; j<stack->depth; j++) {
+            JSONFrame* frame = &stack->frames[j];
+
+            // Keys borrowed from a shape belong to it, and keys in an arena to the parser
+            if(arena) {
+                frame->key = NULL;
+            } else if(frame->element->type == object && frame->shape) {
+                for(int k=0; k<frame->element->object.numberOfElements; k++) {
+                    frame->element->object.elements[k].key = NULL;
+                }
+                frame->key = NULL;
+            }
+            libjson_releaseString(frame->key);
+            frame->key = NULL;
+        }
+        stack->depth = 0;
+        e_destroyJSONElement(root);
+        libjson_releaseShapes(parser);
+        return -1;
+    }
+    libjson_releaseShapes(parser);
+    return i;
+}
+
+/**
+ * Free all heap memory used by an object or array and everything within it, without recursion.
+ * 
+ * @param root The object or array to deallocate.
+ */
+static void libjson_destroyTree(JSONElement* root) {
+    JSONStack stack = {NULL, 0, 0};
+
+    // Documents built in a parser's arena are freed with the parser
+    if((root->type == object ? root->object.flags : root->array.flags) & LIBJSON_ARENA) {
+        return;
+    }
+
+    if(!libjson_push(&stack, root)) {
+        return;
+    }
+
+    while(stack.depth > 0) {
+        JSONFrame* top = &stack.frames[stack.depth-1];
+        JSONElement* element = top->element;
+        bool isObject = element->type == object;
+        int numberOfElements = isObject ? element->object.numberOfElements : element->array.numberOfElements;
+        int flags = isObject ? element->object.flags : element->array.flags;
+
+        if(top->next == numberOfElements) {
+            if(isObject && (element->object.flags & LIBJSON_SHAPED)) {
+                libjson_releaseShape(element->object.record->shape);
+            }
+            libjson_releaseStorage(flags, element->array.elements, libjson_storageSize(element));
+            element->array.numberOfElements = 0;
+            element->array.elements = NULL;
+            stack.depth--;
+            continue;
+        }
+
+        if(!isObject && (element->array.flags & LIBJSON_PACKED)) {
+            top->next = numberOfElements;
+            continue;
+        }
+
+        JSONElement* child;
+        if(isObject && (element->object.flags & LIBJSON_SHAPED)) {
+            child = &element->object.record->values[top->next];
+        } else if(isObject) {
+            // Compacted keys are part of the object's storage
+            JSONPair* pair = &element->object.elements[top->next];
+            if(!(flags & LIBJSON_COMPACT)) {
+                libjson_releaseString(pair->key);
+            }
+            pair->key = NULL;
+            child = &pair->value;
+        } else {
+            child = &element->array.elements[top->next];
+        }
+        top->next++;
+
+        if(child->type == object || child->type == array) {
+            libjson_push(&stack, child);
+        } else if(child->type == string && (child->flags & LIBJSON_INTERNED)) {
+            libjson_releaseInterned(child->string);
+            child->string = NULL;
+        } else if((child->type == string || (child->flags & LIBJSON_RAW)) && (child->flags & LIBJSON_COMPACT)) {
+            libjson_releaseStorage(child->flags, child->string, 0);
+            child->string = NULL;
+        } else if((child->type == string || (child->flags & LIBJSON_RAW)) && (child->flags & LIBJSON_POOLED)) {
+            libjson_releaseString(child->string);
+            child->string = NULL;
+        } else if((child->type == string || (child->flags & LIBJSON_RAW)) && !(child->flags & (LIBJSON_INLINE | LIBJSON_ARENA))) {
+            libjson_dealloc(child->string);
+        }
+    }
+    libjson_release(stack.frames, sizeof(JSONFrame)*stack.capacity);
+}
+
+/**
+ * Free all heap memory used by a json key/value pair.
+ * 
+ * @param pair The key/value pair to deallocate.
+ */
+static void libjson_destroyJSONPair(JSONPair* pair) {
+    libjson_releaseString(pair->key);
+    pair->key = NULL;
+    e_destroyJSONElement(&pair->value);
+}
+
+/**
+ * Get a value from a json object by it's key, without copying it.
+ * 
+ * @param json The object to get a value from.
+ * @param key  The key the value is paired with.
+ * @return The value, or a json null if the key isn't present.
+ */
+static const JSONElement* o_getJSONElement(JSONObject json, const char* key) {
+    const JSONElement* element = o_cref(&json, key);
+    return element ? element : &libjson_nullJSONElement;
+}
+
+/**
+ * Set a value for a key in a json object. If the key already exists, the old data will be overwritten.
+ * 
+ * @param json The object to set the value in.
+ * @param key  The key the value is paired with.
+ * @param set  The value to set.
+ */
+static void o_setJSONElement(JSONObject* json, const char* key, JSONElement set) {
+    libjson_movePair(json, libjson_strcpy(key), set);
+}
+
+/**
+ * Get a value from a json array at an index, without copying it.
+ * 
+ * @param json    The array to get a value from.
+ * @param index   The index the value is located at.
+ * @param scratch Where to put the value if the array is packed.
+ * @return The value, or a json null if the index is not in bounds.
+ */
+static const JSONElement* a_getJSONElement(JSONArray json, int index, JSONElement* scratch) {
+    if(index < 0 || index >= json.numberOfElements) {
+        return &libjson_nullJSONElement;
+    }
+    return libjson_elementAt(&json, index, scratch);
+}
+
+/**
+ * Add a value at an index to a json array. This will push other elements later into the array.
+ * If the @p index is less than or equal to 0, the item will be put at the start of the array.
+ * If the @p index is greater than or equal to the length of the array, the item will be put at
+ * the end of the array.
+ * 
+ * @param json  The array to add the value to.
+ * @param index The index to add the value at.
+ * @param set   The value to add.
+ */
+static void a_setJSONElement(JSONArray* json, int index, JSONElement set) {
+    // Documents built in a parser's arena are read only
+    if(json->flags & LIBJSON_ARENA) {
+        e_destroyJSONElement(&set);
+        return;
+    }
+    if(index < 0) {
+        index = 0;
+    } else if(index > json->numberOfElements) {
+        index = json->numberOfElements;
+    }
+    int n = json->numberOfElements;
+    JSONElement* tmp = libjson_unpack(json) && libjson_uncompactArray(json) ? (JSONElement*)libjson_resize(json->elements, sizeof(JSONElement)*n, sizeof(JSONElement)*(n + 1)) : NULL;
+
+    if(!tmp) {
+        fprintf(stderr, "Ran out of memory in addJSONElement");
+        e_destroyJSONElement(&set);
+    } else {
+        json->elements = tmp;
+        json->flags &= ~LIBJSON_CACHED;
+
+        for(int i=json->numberOfElements; i>index; i--) {
+            json->elements[i] = json->elements[i-1];
+        }
+
+        json->numberOfElements++;
+        json->elements[index] = set;
+    }
+}
+
+/**
+ * Get a value from a json array at an index, whether or not the array is packed.
+ * @warning @p index must be in bounds.
+ * 
+ * @param json    The array to get a value from.
+ * @param index   The index the value is located at.
+ * @param scratch Where to put the value if the array is packed.
+ * @return The value, in place if the array isn't packed. Otherwise, @p scratch.
+ */
+static const JSONElement* libjson_elementAt(const JSONArray* json, int index, JSONElement* scratch) {
+    if(!(json->flags & LIBJSON_PACKED)) {
+        return &json->elements[index];
+    }
+
+    *scratch = libjson_emptyJSONElement();
+    scratch->type = number;
+    if(json->flags & LIBJSON_INTEGER) {
+        scratch->flags = LIBJSON_INTEGER;
+        scratch->integer = json->integers[index];
+    } else {
+        scratch->number = json->doubles[index];
+    }
+    return scratch;
+}
+
+/**
+ * Convert a packed json array into a sequence of values, so they can be referenced or modified.
+ * Does nothing if the array isn't packed.
+ * 
+ * @param json The array to convert.
+ * @return If the array is no longer packed, true. Otherwise, false.
+ */
+static bool libjson_unpack(JSONArray* json) {
+    if(!(json->flags & LIBJSON_PACKED)) {
+        return true;
+    }
+
+    JSONElement* elements = (JSONElement*)libjson_allocate(sizeof(JSONElement)*json->numberOfElements);
+    if(!elements) {
+        fprintf(stderr, "Ran out of memory in unpack");
+        return false;
+    }
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        libjson_elementAt(json, i, &elements[i]);
+    }
+
+    libjson_releaseStorage(json->flags, json->doubles, sizeof(double)*json->numberOfElements);
+    json->elements = elements;
+    json->flags &= ~(LIBJSON_PACKED | LIBJSON_INTEGER | LIBJSON_CACHED | LIBJSON_COMPACT);
+    return true;
+}
+
+/**
+ * Parse a json array which holds only numbers into packed storage, skipping a JSONElement for each.
+ * Numbers are held as integers while they all are, and as doubles otherwise.
+ * 
+ * @param str  The string containing json.
+ * @param i    The index of the array's opening bracket.
+ * @param json Where to put the parsed array.
+ * @param raw  If numbers should keep their json text, in which case only arrays of integers are packed.
+ * @return The index after the closing bracket, or -1 if the array is empty or holds something other than numbers.
+ */
+static int libjson_parsePacked(char* str, int i, JSONArray* json, bool raw) {
+    const int64_t exact = (int64_t)1 << 53; // Integers beyond this can't be held as doubles exactly
+    int numberOfValues = 0;
+    bool integers = true;
+
+    // Count the values, and check they're all numbers
+    int j = libjson_skipWhitespace(str, i+1);
+    while(str[j] != ']') {
+        if(!libjson_isdigit(str[j]) && str[j] != '-') {
+            return -1;
+        }
+        for(; libjson_isdigit(str[j]) || str[j] == '-' || str[j] == '+' || str[j] == '.' || str[j] == 'e' || str[j] == 'E'; j++) {
+            integers = integers && str[j] != '.' && str[j] != 'e' && str[j] != 'E';
+        }
+        numberOfValues++;
+
+        j = libjson_skipWhitespace(str, j);
+        if(str[j] == ',') {
+            j = libjson_skipWhitespace(str, j+1);
+        } else if(str[j] != ']') {
+            return -1;
+        }
+    }
+
+    // Doubles would be written back differently from how they were written
+    if(numberOfValues == 0 || (raw && !integers)) {
+        return -1;
+    }
+
+    int64_t* packedIntegers = integers ? (int64_t*)libjson_allocate(sizeof(int64_t)*numberOfValues) : NULL;
+    double* packedDoubles = integers ? NULL : (double*)libjson_allocate(sizeof(double)*numberOfValues);
+    if(!packedIntegers && !packedDoubles) {
+        fprintf(stderr, "Ran out of memory in parsePacked");
+        return -1;
+    }
+
+    j = libjson_skipWhitespace(str, i+1);
+    for(int k=0; k<numberOfValues; k++) {
+        char tmp[128] = {0};
+        int length = 0;
+        for(; str[j] != ',' && str[j] != ']' && !libjson_isspace(str[j]); j++) {
+            if(length < 127) {
+                tmp[length++] = str[j];
+            }
+        }
+        JSONElement element = libjson_parseNumber(tmp);
+        bool isInteger = element.flags & LIBJSON_INTEGER;
+
+        if((integers && !isInteger) || (!integers && isInteger && (element.integer > exact || element.integer < -exact))) {
+            libjson_release(packedIntegers, sizeof(int64_t)*numberOfValues);
+            libjson_release(packedDoubles, sizeof(double)*numberOfValues);
+            return -1;
+        }
+
+        if(integers) {
+            packedIntegers[k] = element.integer;
+        } else {
+            packedDoubles[k] = isInteger ? (double)element.integer : element.number;
+        }
+
+        j = libjson_skipWhitespace(str, j);
+        if(str[j] == ',') {
+            j = libjson_skipWhitespace(str, j+1);
+        }
+    }
+
+    if(integers) {
+        json->integers = packedIntegers;
+    } else {
+        json->doubles = packedDoubles;
+    }
+    json->numberOfElements = numberOfValues;
+    json->flags = LIBJSON_PACKED | (integers ? LIBJSON_INTEGER : 0);
+    return j+1;
+}
+
+/**
+ * Get the key of the key/value pair at an index of a json object, whether or not it's shaped.
+ * 
+ * @param json  The object to get a key from.
+ * @param index The index of the pair. Must be in bounds.
+ * @return The key.
+ */
+static const char* libjson_keyAt(const JSONObject* json, int index) {
+    return json->flags & LIBJSON_SHAPED ? json->record->shape->keys[index] : json->elements[index].key;
+}
+
+/**
+ * Get the value of the key/value pair at an index of a json object, in place, whether or not it's shaped.
+ * 
+ * @param json  The object to get a value from.
+ * @param index The index of the pair. Must be in bounds.
+ * @return The value.
+ */
+static JSONElement* libjson_valueAt(const JSONObject* json, int index) {
+    return json->flags & LIBJSON_SHAPED ? &json->record->values[index] : &json->elements[index].value;
+}
+
+/**
+ * Find the index of the key/value pair with a key in a json object.
+ * Shaped objects are searched through their shape's table.
+ * 
+ * @param json The object to search.
+ * @param key  The key to find.
+ * @return The index of the pair, or -1 if the key isn't present.
+ */
+static int libjson_find(const JSONObject* json, const char* key) {
+    if(json->flags & LIBJSON_SHAPED) {
+        const JSONShape* shape = json->record->shape;
+        unsigned mask = (unsigned)(shape->capacity-1);
+        unsigned slot = (unsigned)libjson_hashKey(key) & mask;
+
+        for(; shape->table[slot]; slot = (slot+1) & mask) {
+            if(libjson_strcmp(key, shape->keys[shape->table[slot]-1])) {
+                return shape->table[slot]-1;
+            }
+        }
+        return -1;
+    }
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        if(libjson_strcmp(key, json->elements[i].key)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Hash a key with 64 bit FNV-1a.
+ * 
+ * @param key The key to hash.
+ * @return The key's hash.
+ */
+static uint64_t libjson_hashKey(const char* key) {
+    uint64_t hash = 14695981039346656037ull;
+    for(; *key != '\0'; key++) {
+        hash = (hash ^ (unsigned char)*key) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Create a shape from the keys of a json object, taking them from it.
+ * The object's keys are left NULL, and it should be converted to a record.
+ * 
+ * @param json The object to take the keys of.
+ * @param hash A hash of every key of the object, in order.
+ * @return The shape, with no references, or NULL if there wasn't enough memory.
+ */
+static JSONShape* libjson_createShape(JSONObject* json, uint64_t hash) {
+    int capacity = 8;
+    while(capacity < json->numberOfElements*2) {
+        capacity *= 2;
+    }
+
+    JSONShape* shape = (JSONShape*)libjson_allocate(sizeof(JSONShape));
+    char** keys = (char**)libjson_allocate(sizeof(char*)*json->numberOfElements);
+    int* table = (int*)libjson_allocate(sizeof(int)*capacity);
+
+    if(!shape || !keys || !table) {
+        fprintf(stderr, "Ran out of memory in createShape");
+        libjson_release(shape, sizeof(JSONShape));
+        libjson_release(keys, sizeof(char*)*json->numberOfElements);
+        libjson_release(table, sizeof(int)*capacity);
+        return NULL;
+    }
+
+    for(int i=0; i<capacity; i++) {
+        table[i] = 0;
+    }
+
+    shape->keys = keys;
+    shape->numberOfKeys = json->numberOfElements;
+    shape->table = table;
+    shape->capacity = capacity;
+    shape->references = 0;
+    shape->hash = hash;
+    shape->plain = true;
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        keys[i] = json->elements[i].key;
+        json->elements[i].key = NULL;
+
+        for(const char* c = keys[i]; *c != '\0'; c++) {
+            shape->plain = shape->plain && *c != '\\';
+        }
+
+        unsigned slot = (unsigned)libjson_hashKey(keys[i]) & (unsigned)(capacity-1);
+        while(table[slot]) {
+            slot = (slot+1) & (unsigned)(capacity-1);
+        }
+        table[slot] = i+1;
+    }
+    return shape;
+}
+
+/**
+ * Give up a reference to a shape, freeing it once nothing references it.
+ * 
+ * @param shape The shape to release.
+ */
+static void libjson_releaseShape(JSONShape* shape) {
+    if(--shape->references > 0) {
+        return;
+    }
+
+    for(int i=0; i<shape->numberOfKeys; i++) {
+        libjson_releaseString(shape->keys[i]);
+    }
+    libjson_release(shape->keys, sizeof(char*)*shape->numberOfKeys);
+    libjson_release(shape->table, sizeof(int)*shape->capacity);
+    libjson_release(shape, sizeof(JSONShape));
+}
+
+/**
+ * Give up the parser's references to the shapes found by a parse, leaving them to the objects using them.
+ * 
+ * @param parser The parser whose shapes to release.
+ */
+static void libjson_releaseShapes(JSONParser* parser) {
+    for(int i=0; parser->numberOfShapes > 0 && i<parser->shapeCapacity; i++) {
+        if(parser->shapes[i]) {
+            libjson_releaseShape(parser->shapes[i]);
+            parser->shapes[i] = NULL;
+            parser->numberOfShapes--;
+        }
+    }
+}
+
+/**
+ * Stop borrowing keys from the shape an object being parsed was expected to have,
+ * by copying the keys parsed so far.
+ * 
+ * @param frame The object being parsed.
+ */
+static void libjson_ownKeys(JSONFrame* frame) {
+    if(!frame->shape) {
+        return;
+    }
+
+    for(int i=0; i<frame->element->object.numberOfElements; i++) {
+        frame->element->object.elements[i].key = libjson_strcpy(frame->element->object.elements[i].key);
+    }
+    frame->shape = NULL;
+}
+
+/**
+ * Convert an object which has just been parsed into a record, sharing its keys with
+ * other objects which have the same keys in the same order.
+ * 
+ * @param parser The parser holding the shapes found so far.
+ * @param frame  The object which has just been parsed.
+ * @return The object's shape, or NULL if it's left as it is.
+ */
+static JSONShape* libjson_shapeObject(JSONParser* parser, JSONFrame* frame) {
+    JSONObject* json = &frame->element->object;
+    int n = json->numberOfElements;
+
+    if(frame->shape && frame->shape->numberOfKeys != n) {
+        libjson_ownKeys(frame);
+    }
+    if(n == 0) {
+        return NULL;
+    }
+
+    int recordSize = sizeof(JSONRecord) + sizeof(JSONElement)*n;
+    JSONRecord* record = (JSONRecord*)libjson_allocate(recordSize);
+    if(!record) {
+        fprintf(stderr, "Ran out of memory in shapeObject");
+        libjson_ownKeys(frame);
+        return NULL;
+    }
+
+    JSONShape* shape = frame->shape;
+    bool borrowed = shape != NULL;
+
+    if(!shape) {
+        uint64_t hash = 14695981039346656037ull;
+        for(int i=0; i<n; i++) {
+            hash = (hash ^ libjson_hashKey(json->elements[i].key)) * 1099511628211ull;
+        }
+
+        // Find an identical shape from earlier in the parse
+        unsigned mask = (unsigned)(parser->shapeCapacity-1);
+        unsigned slot = (unsigned)hash & mask;
+        for(; parser->shapeCapacity > 0 && parser->shapes[slot]; slot = (slot+1) & mask) {
+            JSONShape* candidate = parser->shapes[slot];
+            bool same = candidate->hash == hash && candidate->numberOfKeys == n;
+
+            for(int i=0; same && i<n; i++) {
+                same = libjson_strcmp(candidate->keys[i], json->elements[i].key);
+            }
+            if(same) {
+                shape = candidate;
+                break;
+            }
+        }
+
+        if(!shape) {
+            // Grow the table before it's half full, until it holds as many shapes as it may
+            if((parser->numberOfShapes+1)*2 > parser->shapeCapacity) {
+                if(parser->shapeCapacity >= 2*LIBJSON_SHAPE_LIMIT) {
+                    libjson_release(record, recordSize);
+                    return NULL;
+                }
+
+                int capacity = parser->shapeCapacity ? parser->shapeCapacity*2 : 64;
+                JSONShape** shapes = (JSONShape**)calloc((size_t)capacity, sizeof(JSONShape*));
+                if(!shapes) {
+                    fprintf(stderr, "Ran out of memory in shapeObject");
+                    libjson_release(record, recordSize);
+                    return NULL;
+                }
+
+                for(int i=0; i<parser->shapeCapacity; i++) {
+                    if(parser->shapes[i]) {
+                        unsigned s = (unsigned)parser->shapes[i]->hash & (unsigned)(capacity-1);
+                        while(shapes[s]) {
+                            s = (s+1) & (unsigned)(capacity-1);
+                        }
+                        shapes[s] = parser->shapes[i];
+                    }
+                }
+                libjson_dealloc(parser->shapes);
+                parser->shapes = shapes;
+                parser->shapeCapacity = capacity;
+                mask = (unsigned)(capacity-1);
+            }
+
+            shape = libjson_createShape(json, hash);
+            if(!shape) {
+                libjson_release(record, recordSize);
+                return NULL;
+            }
+
+            slot = (unsigned)hash & mask;
+            while(parser->shapes[slot]) {
+                slot = (slot+1) & mask;
+            }
+            parser->shapes[slot] = shape;
+            parser->numberOfShapes++;
+            shape->references++;
+        }
+    }
+
+    record->shape = shape;
+    record->values = (JSONElement*)(record+1);
+    for(int i=0; i<n; i++) {
+        if(!borrowed) {
+            libjson_releaseString(json->elements[i].key);
+        }
+        record->values[i] = json->elements[i].value;
+    }
+    shape->references++;
+
+    libjson_release(json->elements, sizeof(JSONPair)*n);
+    json->elements = NULL;
+    json->record = record;
+    json->flags |= LIBJSON_SHAPED;
+    frame->shape = NULL;
+    return shape;
+}
+
+/**
+ * Convert a shaped json object back into a sequence of key/value pairs with their own keys,
+ * so it can be modified. Does nothing if the object isn't shaped.
+ * 
+ * @param json The object to convert.
+ * @return If the object is no longer shaped, true. Otherwise, false.
+ */
+static bool libjson_unshape(JSONObject* json) {
+    if(!(json->flags & LIBJSON_SHAPED)) {
+        return true;
+    }
+
+    JSONPair* elements = (JSONPair*)libjson_allocate(sizeof(JSONPair)*json->numberOfElements);
+    if(!elements) {
+        fprintf(stderr, "Ran out of memory in unshape");
+        return false;
+    }
+
+    JSONRecord* record = json->record;
+    for(int i=0; i<json->numberOfElements; i++) {
+        elements[i].key = libjson_strcpy(record->shape->keys[i]);
+        elements[i].value = record->values[i];
+    }
+
+    libjson_releaseShape(record->shape);
+    libjson_releaseStorage(json->flags, record, sizeof(JSONRecord) + sizeof(JSONElement)*json->numberOfElements);
+    json->elements = elements;
+    json->flags &= ~(LIBJSON_SHAPED | LIBJSON_CACHED | LIBJSON_COMPACT);
+    return true;
+}
+
+/**
+ * Find how many bytes an object or array's storage takes.
+ * 
+ * @param element The object or array.
+ * @return How many bytes its elements, record, or packed values take.
+ */
+static int libjson_storageSize(const JSONElement* element) {
+    if(element->type == object) {
+        int n = element->object.numberOfElements;
+        return element->object.flags & LIBJSON_SHAPED ? (int)(sizeof(JSONRecord) + sizeof(JSONElement)*n) : (int)sizeof(JSONPair)*n;
+    }
+
+    // Packed values are the same size, whether they're integers or doubles
+    int n = element->array.numberOfElements;
+    return element->array.flags & LIBJSON_PACKED ? (int)sizeof(double)*n : (int)sizeof(JSONElement)*n;
+}
+
+/**
+ * Give back the storage of a container, or a string, whether it was compacted or not.
+ * 
+ * @param flags  The flags of the container or string.
+ * @param memory The storage, or NULL.
+ * @param size   How many bytes @p memory was allocated for, if it wasn't compacted.
+ */
+static void libjson_releaseStorage(int flags, void* memory, int size) {
+    if(!memory || !(flags & LIBJSON_COMPACT)) {
+        libjson_release(memory, size);
+        return;
+    }
+
+    JSONCompact* block = ((JSONCompact**)memory)[-1];
+    if(--block->references == 0) {
+        free(block);
+    }
+}
+
+/**
+ * Take storage for a container, or a string, from a block being compacted into.
+ * 
+ * @param block  The block.
+ * @param cursor Where the next storage in the block goes. Moved past the storage.
+ * @param size   How many bytes are needed.
+ * @return The storage, just after a pointer back to @p block.
+ */
+static char* libjson_compactAlloc(JSONCompact* block, char** cursor, int size) {
+    *(JSONCompact**)*cursor = block;
+    char* memory = *cursor + sizeof(JSONCompact*);
+    *cursor = memory + ((size+7) & ~7);
+    block->references++;
+    return memory;
+}
+
+/**
+ * Move the storage of an object or array, along with its keys, into a block being compacted into.
+ * 
+ * @param block   The block.
+ * @param cursor  Where the next storage in the block goes. Moved past the storage and keys.
+ * @param element The object or array, which must have at least one value.
+ */
+static void libjson_compactStorage(JSONCompact* block, char** cursor, JSONElement* element) {
+    bool isObject = element->type == object;
+    int* flags = isObject ? &element->object.flags : &element->array.flags;
+    int size = libjson_storageSize(element);
+
+    char* old = (char*)element->array.elements;
+    char* memory = libjson_compactAlloc(block, cursor, size);
+    for(int i=0; i<size; i++) {
+        memory[i] = old[i];
+    }
+
+    if(isObject && (*flags & LIBJSON_SHAPED)) {
+        JSONRecord* record = (JSONRecord*)memory;
+        record->values = (JSONElement*)(record+1);
+    } else if(isObject) {
+        // Keys follow the pairs, so looking one up stays close to the rest
+        JSONPair* pairs = (JSONPair*)memory;
+        for(int i=0; i<element->object.numberOfElements; i++) {
+            int length = libjson_strlen(pairs[i].key);
+            char* key = *cursor;
+            for(int j=0; j<=length; j++) {
+                key[j] = pairs[i].key[j];
+            }
+            *cursor += (length+8) & ~7;
+
+            if(!(*flags & LIBJSON_COMPACT)) {
+                libjson_releaseString(pairs[i].key);
+            }
+            pairs[i].key = key;
+        }
+    }
+
+    libjson_releaseStorage(*flags, old, size);
+    element->array.elements = (JSONElement*)memory;
+    *flags = (*flags | LIBJSON_COMPACT) & ~LIBJSON_CACHED;
+}
+
+/**
+ * Move all of a document's storage and strings into one block, without recursion.
+ * Each container is followed by its keys, then by its values, depth first.
+ * 
+ * @param root The object or array at the root of the document.
+ * @return If the document was compacted. Otherwise it's left as it was.
+ */
+static bool libjson_compact(JSONElement* root) {
+    // Documents built in a parser's arena are already together, and read only
+    if((root->type == object ? root->object.flags : root->array.flags) & LIBJSON_ARENA) {
+        return false;
+    }
+    if((root->type == object ? root->object.numberOfElements : root->array.numberOfElements) == 0) {
+        return true;
+    }
+
+    JSONStack stack = {NULL, 0, 0};
+    if(!libjson_push(&stack, root)) {
+        return false;
+    }
+
+    // Find how big the block needs to be, and grow the stack as deep as it needs to go
+    int header = (sizeof(JSONCompact)+7) & ~7;
+    int size = header + sizeof(JSONCompact*) + ((libjson_storageSize(root)+7) & ~7);
+    bool pushed = true;
+
+    while(stack.depth > 0 && pushed) {
+        JSONFrame* top = &stack.frames[stack.depth-1];
+        JSONElement* element = top->element;
+        bool isObject = element->type == object;
+        int numberOfElements = isObject ? element->object.numberOfElements : element->array.numberOfElements;
+
+        if(top->next == numberOfElements || (!isObject && (element->array.flags & LIBJSON_PACKED))) {
+            stack.depth--;
+            continue;
+        }
+
+        JSONElement* child;
+        if(isObject && (element->object.flags & LIBJSON_SHAPED)) {
+            child = &element->object.record->values[top->next];
+        } else if(isObject) {
+            size += (libjson_strlen(element->object.elements[top->next].key)+8) & ~7;
+            child = &element->object.elements[top->next].value;
+        } else {
+            child = &element->array.elements[top->next];
+        }
+        top->next++;
+
+        if((child->type == object || child->type == array) && child->array.numberOfElements > 0) {
+            size += sizeof(JSONCompact*) + ((libjson_storageSize(child)+7) & ~7);
+            pushed = libjson_push(&stack, child) != NULL;
+        } else if((child->type == string || (child->flags & LIBJSON_RAW)) && !(child->flags & (LIBJSON_INLINE | LIBJSON_INTERNED))) {
+            size += sizeof(JSONCompact*) + ((libjson_strlen(child->string)+8) & ~7);
+        }
+    }
+
+    JSONCompact* block = pushed ? (JSONCompact*)malloc(size) : NULL;
+    if(!block) {
+        fprintf(stderr, "Ran out of memory in compact");
+        libjson_release(stack.frames, sizeof(JSONFrame)*stack.capacity);
+        return false;
+    }
+    block->references = 0;
+    char* cursor = (char*)block + header;
+
+    // Lay the document out, with each container's storage placed as it's reached
+    stack.depth = 0;
+    libjson_compactStorage(block, &cursor, root);
+    libjson_push(&stack, root);
+
+    while(stack.depth > 0) {
+        JSONFrame* top = &stack.frames[stack.depth-1];
+        JSONElement* element = top->element;
+        bool isObject = element->type == object;
+        int numberOfElements = isObject ? element->object.numberOfElements : element->array.numberOfElements;
+
+        if(top->next == numberOfElements || (!isObject && (element->array.flags & LIBJSON_PACKED))) {
+            stack.depth--;
+            continue;
+        }
+
+        JSONElement* child;
+        if(isObject && (element->object.flags & LIBJSON_SHAPED)) {
+            child = &element->object.record->values[top->next];
+        } else if(isObject) {
+            child = &element->object.elements[top->next].value;
+        } else {
+            child = &element->array.elements[top->next];
+        }
+        top->next++;
+
+        if((child->type == object || child->type == array) && child->array.numberOfElements > 0) {
+            libjson_compactStorage(block, &cursor, child);
+            libjson_push(&stack, child);
+        } else if((child->type == string || (child->flags & LIBJSON_RAW)) && !(child->flags & (LIBJSON_INLINE | LIBJSON_INTERNED))) {
+            int length = libjson_strlen(child->string);
+            char* text = libjson_compactAlloc(block, &cursor, length+1);
+            for(int i=0; i<=length; i++) {
+                text[i] = child->string[i];
+            }
+
+            JSONElement old = *child;
+            e_destroyJSONElement(&old);
+            child->string = text;
+            child->flags = (child->flags & ~LIBJSON_POOLED) | LIBJSON_COMPACT;
+        }
+    }
+    libjson_release(stack.frames, sizeof(JSONFrame)*stack.capacity);
+    return true;
+}
+
+/**
+ * Move a compacted object's pairs and keys back into their own storage, so it can be modified.
+ * Does nothing if the object isn't compacted. Shaped objects should be unshaped first.
+ * 
+ * @param json The object to move.
+ * @return If the object is no longer compacted, true. Otherwise, false.
+ */
+static bool libjson_uncompactObject(JSONObject* json) {
+    if(!(json->flags & LIBJSON_COMPACT)) {
+        return true;
+    }
+
+    JSONPair* elements = (JSONPair*)libjson_allocate(sizeof(JSONPair)*json->numberOfElements);
+    if(!elements) {
+        fprintf(stderr, "Ran out of memory in uncompact");
+        return false;
+    }
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        elements[i].key = libjson_strcpy(json->elements[i].key);
+        elements[i].value = json->elements[i].value;
+    }
+
+    libjson_releaseStorage(json->flags, json->elements, 0);
+    json->elements = elements;
+    json->flags &= ~(LIBJSON_COMPACT | LIBJSON_CACHED);
+    return true;
+}
+
+/**
+ * Move a compacted array's values back into their own storage, so it can be modified.
+ * Does nothing if the array isn't compacted. Packed arrays should be unpacked first.
+ * 
+ * @param json The array to move.
+ * @return If the array is no longer compacted, true. Otherwise, false.
+ */
+static bool libjson_uncompactArray(JSONArray* json) {
+    if(!(json->flags & LIBJSON_COMPACT)) {
+        return true;
+    }
+
+    JSONElement* elements = (JSONElement*)libjson_allocate(sizeof(JSONElement)*json->numberOfElements);
+    if(!elements) {
+        fprintf(stderr, "Ran out of memory in uncompact");
+        return false;
+    }
+
+    for(int i=0; i<json->numberOfElements; i++) {
+        elements[i] = json->elements[i];
+    }
+
+    libjson_releaseStorage(json->flags, json->elements, 0);
+    json->elements = elements;
+    json->flags &= ~(LIBJSON_COMPACT | LIBJSON_CACHED);
+    return true;
+}
+
+/**
+ * Find a string in a list through an open-addressed table of the index+1 of each string.
+ * 
+ * @param table        The table. Grown as needed.
+ * @param capacity     How many entries the table has space for. A power of two, or 0.
+ * @param keys         The strings the table indexes.
+ * @param numberOfKeys How many strings there are.
+ * @param key          The string to find.
+ * @param add          If the string should be added to the table, as index @p numberOfKeys, when it isn't there.
+ * @return The index of the string, or @p numberOfKeys if it isn't in the list yet, or -1 if there wasn't enough memory.
+ */
+static int libjson_lookup(int** table, int* capacity, char** keys, int numberOfKeys, const char* key, bool add) {
+    if((numberOfKeys+1)*2 > *capacity) {
+        int grown = *capacity ? *capacity*2 : 16;
+        int* tmp = (int*)calloc(grown, sizeof(int));
+        if(!tmp) {
+            fprintf(stderr, "Ran out of memory in lookup");
+            return -1;
+        }
+        for(int i=0; i<numberOfKeys; i++) {
+            unsigned slot = (unsigned)libjson_hashKey(keys[i]) & (unsigned)(grown-1);
+            while(tmp[slot]) {
+                slot = (slot+1) & (unsigned)(grown-1);
+            }
+            tmp[slot] = i+1;
+        }
+        libjson_dealloc(*table);
+        *table = tmp;
+        *capacity = grown;
+    }
+
+    unsigned mask = (unsigned)(*capacity-1);
+    unsigned slot = (unsigned)libjson_hashKey(key) & mask;
+    for(; (*table)[slot]; slot = (slot+1) & mask) {
+        if(libjson_strcmp(key, keys[(*table)[slot]-1])) {
+            return (*table)[slot]-1;
+        }
+    }
+    if(add) {
+        (*table)[slot] = numberOfKeys+1;
+    }
+    return numberOfKeys;
+}
+
+/**
+ * Find the column of a key in a table being built, adding an empty column if there isn't one.
+ * 
+ * @param table    The table being built.
+ * @param keys     The key of each column, grown along with the table's columns.
+ * @param lookup   A table of the index+1 of each column by its key's hash. Grown as needed.
+ * @param capacity How many entries @p lookup has space for.
+ * @param key      The key of the column.
+ * @return The index of the column, or -1 if there wasn't enough memory.
+ */
+static int libjson_columnIndex(JSONTable* table, char*** keys, int** lookup, int* capacity, const char* key) {
+    int n = table->numberOfColumns;
+    int index = libjson_lookup(lookup, capacity, *keys, n, key, false);
+    if(index != n) {
+        return index;
+    }
+
+    // The columns' capacity doubles whenever their number reaches a power of two
+    if((n & (n-1)) == 0) {
+        JSONColumn* columns = (JSONColumn*)realloc(table->columns, sizeof(JSONColumn)*(n ? n*2 : 1));
+        if(columns) {
+            table->columns = columns;
+        }
+        char** grown = columns ? (char**)realloc(*keys, sizeof(char*)*(n ? n*2 : 1)) : NULL;
+        if(!grown) {
+            fprintf(stderr, "Ran out of memory in columnIndex");
+            return -1;
+        }
+        *keys = grown;
+    }
+
+    index = libjson_lookup(lookup, capacity, *keys, n, key, true);
+    if(index == n) {
+        JSONColumn* column = &table->columns[table->numberOfColumns++];
+        column->key = libjson_strcpy(key);
+        column->type = columnEmpty;
+        column->present = NULL;
+        column->nulls = NULL;
+        column->integers = NULL;
+        column->dictionary = NULL;
+        column->dictionarySize = 0;
+        (*keys)[index] = column->key;
+    }
+    return index;
+}
+
+/**
+ * Widen the type of a column being built to hold another value.
+ * 
+ * @param column The column the value belongs to.
+ * @param value  The value.
+ */
+static void libjson_classify(JSONColumn* column, const JSONElement* value) {
+    JSONColumnType type;
+
+    switch(value->type) {
+        case null:
+            return;
+        case boolean:
+            type = columnBoolean;
+            break;
+        case number:
+            type = libjson_decodeNumber(value).flags & LIBJSON_INTEGER ? columnInt : columnDouble;
+            break;
+        case string:
+            type = columnString;
+            break;
+        default:
+            type = columnMixed;
+            break;
+    }
+
+    if(column->type == columnEmpty || column->type == type) {
+        column->type = type;
+    } else if((column->type == columnInt && type == columnDouble) || (column->type == columnDouble && type == columnInt)) {
+        column->type = columnDouble;
+    } else {
+        column->type = columnMixed;
+    }
+}
+
+/**
+ * Copy a json value, except for the values within an object or array. The copy of an object
+ * or array has space for all of its values, but holds none of them yet.
+ * 
+ * @param element The value to copy.
+ * @return A copy of the value which shares no memory with @p element, except for LIBJSON_INTERNED strings.
+ */
+static JSONElement libjson_copyValue(const JSONElement* element) {
+    JSONElement copy = *element;
+
+    if(element->type == object) {
+        copy.object = o_emptyJSONObject();
+        if(element->object.numberOfElements > 0) {
+            copy.object.elements = (JSONPair*)libjson_allocate(sizeof(JSONPair)*element->object.numberOfElements);
+        }
+    } else if(element->type == array && (element->array.flags & LIBJSON_PACKED)) {
+        copy.array = a_emptyJSONArray();
+        int n = element->array.numberOfElements;
+
+        if(element->array.flags & LIBJSON_INTEGER) {
+            copy.array.integers = (int64_t*)libjson_allocate(sizeof(int64_t)*n);
+            for(int i=0; copy.array.integers && i<n; i++) {
+                copy.array.integers[i] = element->array.integers[i];
+            }
+        } else {
+            copy.array.doubles = (double*)libjson_allocate(sizeof(double)*n);
+            for(int i=0; copy.array.doubles && i<n; i++) {
+                copy.array.doubles[i] = element->array.doubles[i];
+            }
+        }
+
+        if(copy.array.elements) {
+            copy.array.numberOfElements = n;
+            copy.array.flags = element->array.flags & (LIBJSON_PACKED | LIBJSON_INTEGER);
+        }
+    } else if(element->type == array) {
+        copy.array = a_emptyJSONArray();
+        if(element->array.numberOfElements > 0) {
+            copy.array.elements = (JSONElement*)libjson_allocate(sizeof(JSONElement)*element->array.numberOfElements);
+        }
+    } else if(element->type == string && (element->flags & LIBJSON_INTERNED)) {
+        ((JSONInterned*)element->string - 1)->references++;
+    } else if((element->type == string || (element->flags & LIBJSON_RAW)) && !(element->flags & LIBJSON_INLINE)) {
+        copy.string = libjson_strcpy(element->string);
+        copy.flags = (copy.flags & ~(LIBJSON_COMPACT | LIBJSON_ARENA)) | LIBJSON_POOLED;
+    }
+    return copy;
+}
+
+/**
+ * Create a deep copy of a json value, without recursion.
+ * Each copied object or array is visited on one stack, and the value it was copied from
+ * on another, until all of its values are copied.
+ * @warning Return value should be destroyed when no longer needed.
+ * 
+ * @param element The value to copy.
+ * @return A copy of the value which shares no memory with @p element, except for LIBJSON_INTERNED strings.
+ */
+static JSONElement libjson_copyJSONElement(const JSONElement* element) {
+    JSONStack sources = {NULL, 0, 0};
+    JSONStack copies = {NULL, 0, 0};
+    JSONElement copy = libjson_copyValue(element);
+
+    const JSONElement* from = element;
+    JSONElement* to = &copy;
+
+    while(true) {
+        // Packed arrays are copied whole, and containers without space left empty
+        bool opened = (to->type == object || to->type == array) && to->array.elements && !(to->array.flags & LIBJSON_PACKED);
+        if(opened && libjson_push(&sources, (JSONElement*)from)) {
+            if(!libjson_push(&copies, to)) {
+                sources.depth--;
+            }
+        }
+
+        JSONFrame* source = NULL;
+        JSONFrame* target = NULL;
+        while(copies.depth > 0) {
+            source = &sources.frames[copies.depth-1];
+            target = &copies.frames[copies.depth-1];
+            if(target->next < source->element->array.numberOfElements) {
+                break;
+            }
+            sources.depth--;
+            copies.depth--;
+        }
+        if(copies.depth == 0) {
+            break;
+        }
+
+        int i = target->next++;
+        if(source->element->type == object) {
+            JSONPair* pair = &target->element->object.elements[i];
+            pair->key = libjson_strcpy(libjson_keyAt(&source->element->object, i));
+            from = libjson_valueAt(&source->element->object, i);
+            to = &pair->value;
+        } else {
+            from = &source->element->array.elements[i];
+            to = &target->element->array.elements[i];
+        }
+        *to = libjson_copyValue(from);
+        target->element->array.numberOfElements++;
+    }
+    libjson_release(sources.frames, sizeof(JSONFrame)*sources.capacity);
+    libjson_release(copies.frames, sizeof(JSONFrame)*copies.capacity);
+    return copy;
+}
+
+/**
+ * Compare that two json values are equal, except for the values within an object or array.
+ * Objects and arrays are equal here when they have as many values as each other.
+ * 
+ * @param e1 The first value to compare.
+ * @param e2 The second value to compare.
+ * @return If the values are equal, true. Otherwise, false.
+ */
+static bool libjson_equalValues(const JSONElement* e1, const JSONElement* e2) {
+    if(e1->type != e2->type) {
+        return false;
+    }
+
+    switch(e1->type) {
+        case object:
+            return e1->object.numberOfElements == e2->object.numberOfElements;
+        case array:
+            return e1->array.numberOfElements == e2->array.numberOfElements;
+        case boolean:
+            return e1->boolean == e2->boolean;
+        case number: {
+            JSONElement n1 = libjson_decodeNumber(e1);
+            JSONElement n2 = libjson_decodeNumber(e2);
+            if((n1.flags & LIBJSON_INTEGER) && (n2.flags & LIBJSON_INTEGER)) {
+                return n1.integer == n2.integer;
+            }
+            return e_getDouble(&n1) == e_getDouble(&n2);
+        }
+        case string:
+            // Values sharing an interned string are equal without comparing it
+            if((e1->flags & e2->flags & LIBJSON_INTERNED) && e1->string == e2->string) {
+                return true;
+            }
+            return libjson_strcmp(e_getString(e1), e_getString(e2));
+        case null:
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Compare that two json values are equal, without recursion.
+ * Objects are equal when they have the same keys with equal values, in any order,
+ * and numbers are compared by value.
+ * 
+ * @param e1 The first value to compare.
+ * @param e2 The second value to compare.
+ * @return If the values are equal, true. Otherwise, false.
+ */
+static bool libjson_equals(const JSONElement* e1, const JSONElement* e2) {
+    JSONStack left = {NULL, 0, 0};
+    JSONStack right = {NULL, 0, 0};
+    JSONElement scratch1, scratch2;
+    bool equal = libjson_equalValues(e1, e2);
+
+    while(equal) {
+        if((e1->type == object || e1->type == array) && libjson_push(&left, (JSONElement*)e1)) {
+            if(!libjson_push(&right, (JSONElement*)e2)) {
+                left.depth--;
+                equal = false;
+                break;
+            }
+        }
+
+        JSONFrame* l = NULL;
+        JSONFrame* r = NULL;
+        while(left.depth > 0) {
+            l = &left.frames[left.depth-1];
+            r = &right.frames[left.depth-1];
+            if(l->next < l->element->array.numberOfElements) {
+                break;
+            }
+            left.depth--;
+            right.depth--;
+        }
+        if(left.depth == 0) {
+            break;
+        }
+
+        int i = l->next++;
+        if(l->element->type == object) {
+            e1 = libjson_valueAt(&l->element->object, i);
+            e2 = o_cref(&r->element->object, libjson_keyAt(&l->element->object, i));
+        } else {
+            e1 = libjson_elementAt(&l->element->array, i, &scratch1);
+            e2 = libjson_elementAt(&r->element->array, i, &scratch2);
+        }
+        equal = e2 && libjson_equalValues(e1, e2);
+    }
+    libjson_release(left.frames, sizeof(JSONFrame)*left.capacity);
+    libjson_release(right.frames, sizeof(JSONFrame)*right.capacity);
+    return equal;
+}
+
+/**
+ * Copy the next reference token of a JSON Pointer (RFC 6901), decoding ~1 as / and ~0 as ~.
+ * @warning @p token must have space for at least as many characters as remain in @p pointer.
+ * 
+ * @param pointer The pointer, positioned at the / that starts a token.
+ * @param token   Where to write the decoded token.
+ * @return The rest of the pointer after the token.
+ */
+static char* libjson_pointerToken(char* pointer, char* token) {
+    int len = 0;
+
+    pointer++;
+    while(*pointer != '\0' && *pointer != '/') {
+        if(pointer[0] == '~' && pointer[1] == '1') {
+            token[len++] = '/';
+            pointer += 2;
+        } else if(pointer[0] == '~' && pointer[1] == '0') {
+            token[len++] = '~';
+            pointer += 2;
+        } else {
+            token[len++] = *pointer++;
+        }
+    }
+    token[len] = '\0';
+
+    return pointer;
+}
+
+/**
+ * Convert a JSON Pointer reference token into an array index.
+ * The token - refers to the position just past the end of the array.
+ * 
+ * @param token The token to convert.
+ * @param size  The number of values in the array.
+ * @return The index, or -1 if the token isn't a valid index within @p size.
+ */
+static int libjson_pointerIndex(char* token, int size) {
+    if(libjson_strcmp(token, "-")) {
+        return size;
+    }
+    if(token[0] == '\0' || (token[0] == '0' && token[1] != '\0')) {
+        return -1;
+    }
+
+    long index = 0;
+    for(int i=0; token[i] != '\0'; i++) {
+        if(!libjson_isdigit(token[i]) || index > size) {
+            return -1;
+        }
+        index = index*10 + (token[i] - '0');
+    }
+    return index <= size ? (int)index : -1;
+}
+
+/**
+ * Find the container holding the value a JSON Pointer (RFC 6901) refers to.
+ * 
+ * @param root    The value the pointer is relative to.
+ * @param pointer The pointer to resolve.
+ * @param token   Where to write the final reference token. Must have space for the whole pointer.
+ * @return The object or array that should hold the value, or NULL if the path doesn't exist.
+ */
+static JSONElement* libjson_resolvePointer(JSONElement* root, char* pointer, char* token) {
+    JSONElement* parent = NULL;
+    JSONElement* current = root;
+
+    token[0] = '\0';
+    if(pointer[0] != '/') {
+        return NULL;
+    }
+
+    while(*pointer != '\0') {
+        if(!current) {
+            return NULL;
+        }
+        parent = current;
+        pointer = libjson_pointerToken(pointer, token);
+
+        if(*pointer == '\0') {
+            break;
+        }
+
+        if(current->type == object) {
+            current = o_ref(&current->object, token);
+        } else if(current->type == array) {
+            current = a_ref(&current->array, libjson_pointerIndex(token, current->array.numberOfElements));
+        } else {
+            current = NULL;
+        }
+    }
+
+    if(parent->type != object && parent->type != array) {
+        return NULL;
+    }
+    return parent;
+}
+
+/**
+ * Add a value at the location a JSON Pointer refers to, as in the JSON Patch add operation.
+ * An existing member of an object is replaced, and values in an array are shifted along.
+ * The container takes ownership of @p set, which is destroyed if it can't be added.
+ * 
+ * @param root    The value the pointer is relative to.
+ * @param pointer The location to add the value at.
+ * @param set     The value to add.
+ * @return If the value was added, true. Otherwise, false.
+ */
+static bool libjson_addAt(JSONElement* root, char* pointer, JSONElement set) {
+    if(pointer[0] == '\0') {
+        if(set.type != object) {
+            e_destroyJSONElement(&set);
+            return false;
+        }
+        e_destroyJSONElement(root);
+        *root = set;
+        return true;
+    }
+
+    char* token = libjson_emptyString(libjson_strlen(pointer));
+    JSONElement* parent = libjson_resolvePointer(root, pointer, token);
+    bool added = false;
+
+    if(parent && parent->type == object) {
+        JSONElement* existing = o_ref(&parent->object, token);
+        if(existing) {
+            e_destroyJSONElement(existing);
+            *existing = set;
+            libjson_dealloc(token);
+        } else {
+            libjson_movePair(&parent->object, token, set);
+        }
+        added = true;
+    } else if(parent && parent->type == array) {
+        int index = libjson_pointerIndex(token, parent->array.numberOfElements);
+        if(index >= 0) {
+            a_moveJSONElement(&parent->array, index, set);
+            added = true;
+        }
+        libjson_dealloc(token);
+    } else {
+        libjson_dealloc(token);
+    }
+
+    if(!added) {
+        e_destroyJSONElement(&set);
+    }
+    return added;
+}
+
+/**
+ * Remove the value a JSON Pointer refers to from its container, without destroying it.
+ * 
+ * @param root     The value the pointer is relative to.
+ * @param pointer  The location of the value to remove.
+ * @param detached Where to store the removed value. The caller takes ownership of it.
+ * @return If the value existed and was removed, true. Otherwise, false.
+ */
+static bool libjson_detachAt(JSONElement* root, char* pointer, JSONElement* detached) {
+    char* token = libjson_emptyString(libjson_strlen(pointer));
+    JSONElement* parent = libjson_resolvePointer(root, pointer, token);
+    bool found = false;
+
+    if(parent && parent->type == object && o_cref(&parent->object, token)) {
+        *detached = o_take(&parent->object, token);
+        o_remove(&parent->object, token);
+        found = true;
+    } else if(parent && parent->type == array) {
+        int index = libjson_pointerIndex(token, parent->array.numberOfElements);
+        if(index >= 0 && index < parent->array.numberOfElements) {
+            *detached = a_take(&parent->array, index);
+            a_remove(&parent->array, index);
+            found = true;
+        }
+    }
+    libjson_dealloc(token);
+
+    return found;
+}
+
+/**
+ * Merge a JSON Merge Patch (RFC 7396) value into a target value, in place, without recursion.
+ * Each object of the target being patched is visited on one stack, and the object of the
+ * patch it's patched with on another.
+ * 
+ * @param target The value to patch.
+ * @param patch  The patch to apply.
+ */
+static void libjson_mergePatch(JSONElement* target, const JSONElement* patch) {
+    JSONStack targets = {NULL, 0, 0};
+    JSONStack patches = {NULL, 0, 0};
+
+    while(true) {
+        // Values removed by the patch, or which couldn't be added, have nothing left to patch
+        if(target && patch->type != object) {
+            e_destroyJSONElement(target);
+            *target = libjson_copyJSONElement(patch);
+        } else if(target) {
+            if(target->type != object) {
+                e_destroyJSONElement(target);
+                target->type = object;
+                target->object = o_emptyJSONObject();
+            }
+            target->object.flags &= ~LIBJSON_CACHED;
+
+            if(libjson_push(&patches, (JSONElement*)patch) && !libjson_push(&targets, target)) {
+                patches.depth--;
+            }
+        }
+
+        JSONFrame* from = NULL;
+        JSONFrame* to = NULL;
+        while(patches.depth > 0) {
+            from = &patches.frames[patches.depth-1];
+            to = &targets.frames[patches.depth-1];
+            if(from->next < from->element->object.numberOfElements) {
+                break;
+            }
+            patches.depth--;
+            targets.depth--;
+        }
+        if(patches.depth == 0) {
+            break;
+        }
+
+        int i = from->next++;
+        const char* key = libjson_keyAt(&from->element->object, i);
+        patch = libjson_valueAt(&from->element->object, i);
+
+        if(patch->type == null) {
+            o_remove(&to->element->object, key);
+            target = NULL;
+            continue;
+        }
+
+        target = o_ref(&to->element->object, key);
+        if(!target) {
+            o_setJSONElement(&to->element->object, key, libjson_emptyJSONElement());
+            target = o_ref(&to->element->object, key);
+        }
+    }
+    libjson_release(targets.frames, sizeof(JSONFrame)*targets.capacity);
+    libjson_release(patches.frames, sizeof(JSONFrame)*patches.capacity);
+}
+
+/**
+ * Write a floating point number the way the serializer does, with the fewest digits
+ * which read back as the same number. Infinity and NaN, which json can't hold, are written as null.
+ * 
+ * @param d   The number to write.
+ * @param tmp Where to write it. Must have space for 512 characters.
+ */
+static void libjson_formatDouble(double d, char* tmp) {
+    if(d != d || d - d != 0) {
+        sprintf(tmp, "null");
+        return;
+    }
+
+    // 17 significant digits always read back the same, and most numbers need far fewer
+    for(int precision=15; precision<=17; precision++) {
+        sprintf(tmp, "%.*g", precision, d);
+        if(strtod(tmp, NULL) == d) {
+            break;
+        }
+    }
+}
+
+/**
+ * Append characters to the output of a writer, passing pending output on to
+ * its file or function once enough has built up.
+ * 
+ * @param writer The writer to append to.
+ * @param str    The characters to append.
+ * @param length How many characters to append.
+ */
+static void libjson_writerAppend(JSONWriter* writer, const char* str, int length) {
+    libjson_bufferAppend(&writer->buffer, str, length);
+
+    if(writer->buffer.length >= LIBJSON_WRITER_FLUSH) {
+        w_flush(writer);
+    }
+}
+
+/**
+ * Prepare a writer for the next key or value, separating it from the previous one.
+ * 
+ * @param writer The writer to prepare.
+ */
+static void libjson_writerValue(JSONWriter* writer) {
+    if(writer->comma) {
+        libjson_writerAppend(writer, ",", 1);
+    }
+    writer->comma = true;
+}
+
+/**
+ * Start a new line in a formatter's output, indented to its depth.
+ * 
+ * @param formatter The formatter to write to.
+ */
+static void libjson_writeIndent(JSONFormatter* formatter) {
+    static const char spaces[] = "                                ";
+    int remaining = formatter->depth * formatter->indent;
+
+    if(formatter->indent == 0) {
+        return;
+    }
+
+    libjson_writerAppend(formatter->writer, "\n", 1);
+    while(remaining > 0) {
+        int length = remaining < (int)sizeof(spaces)-1 ? remaining : (int)sizeof(spaces)-1;
+        libjson_writerAppend(formatter->writer, spaces, length);
+        remaining -= length;
+    }
+}
+
+/**
+ * Count the whitespace json allows between values at the start of a string, a vector at a time.
+ * 
+ * @param str    The string to scan.
+ * @param length How many characters @p str has.
+ * @return How many characters are spaces, tabs, line feeds or carriage returns.
+ */
+static int libjson_whitespaceRun(const char* str, int length) {
+    int i = 0;
+
+#if defined(__AVX2__)
+    for(; i+32 <= length; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(str+i));
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        space = _mm256_or_si256(space, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        space = _mm256_or_si256(space, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(space);
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    for(; i+16 <= length; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str+i));
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        space = _mm_or_si128(space, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        space = _mm_or_si128(space, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(space) & 0xFFFF;
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    while(i < length && (str[i] == ' ' || str[i] == '\t' || str[i] == '\n' || str[i] == '\r')) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Count the characters at the start of a string which can be copied as is, a vector at a time.
+ * Within a string, that's up to the next " or \. Outside of one, it's up to the next
+ * whitespace or ".
+ * 
+ * @param str      The string to scan.
+ * @param length   How many characters @p str has.
+ * @param inString If @p str is within a json string.
+ * @return How many characters can be copied.
+ */
+static int libjson_tokenRun(const char* str, int length, bool inString) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    for(; i+16 <= length; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str+i));
+        __m128i stop = _mm_cmpeq_epi8(v, _mm_set1_epi8('\"'));
+
+        if(inString) {
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        } else {
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        }
+
+        unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+        if(mask) {
+            i += __builtin_ctz(mask);
+            break;
+        }
+    }
+#endif
+
+    for(; i < length; i++) {
+        char c = str[i];
+
+        if(c == '\"' || (inString && c == '\\') || (!inString && (c == ' ' || c == '\t' || c == '\n' || c == '\r'))) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * Append characters to the end of a buffer, growing it if needed.
+ * 
+ * @param buffer The buffer to append to.
+ * @param str    The characters to append.
+ * @param length How many characters to append.
+ */
+static void libjson_bufferAppend(JSONBuffer* buffer, const char* str, int length) {
+    if(buffer->length + length > buffer->capacity) {
+        int capacity = buffer->capacity ? buffer->capacity : 64;
+        while(capacity < buffer->length + length) {
+            capacity *= 2;
+        }
+
+        char* tmp = (char*)realloc(buffer->data, capacity);
+        if(!tmp) {
+            fprintf(stderr, "Ran out of memory in bufferAppend");
+            return;
+        }
+        buffer->data = tmp;
+        buffer->capacity = capacity;
+    }
+
+    for(int i=0; i<length; i++) {
+        buffer->data[buffer->length+i] = str[i];
+    }
+    buffer->length += length;
+}
+
+/**
+ * Append a string to the end of a buffer, escaped and enclosed in quotation marks.
+ * Runs of characters which don't need escaping are found a vector at a time, and copied whole.
+ * 
+ * @param buffer The buffer to append to.
+ * @param str    The string to append.
+ */
+static void libjson_bufferAppendString(JSONBuffer* buffer, const char* str) {
+    int length = libjson_strlen((char*)str);
+    char escape[16] = {0};
+    int i = 0;
+#ifdef LIBJSON_ESCAPE_UNICODE
+    bool unicode = true;
+#else
+    bool unicode = false;
+#endif
+
+    libjson_bufferAppend(buffer, "\"", 1);
+    while(i < length) {
+        int clean = libjson_escapeScan(str+i, length-i, unicode);
+        libjson_bufferAppend(buffer, str+i, clean);
+        i += clean;
+
+        if(i < length) {
+            int consumed = 1;
+            int escapeLength = libjson_escapeCharacter(str+i, escape, &consumed);
+            libjson_bufferAppend(buffer, escape, escapeLength);
+            i += consumed;
+        }
+    }
+    libjson_bufferAppend(buffer, "\"", 1);
+}
+
+/**
+ * Check if a character must be escaped within a json string.
+ * 
+ * @param c       The character to check.
+ * @param unicode If characters outside of ASCII must be escaped.
+ * @return If the character must be escaped, true. Otherwise, false.
+ */
+static bool libjson_needsEscape(char c, bool unicode) {
+    unsigned char u = (unsigned char)c;
+    return u == '\"' || u == '\\' || u < 0x20 || (unicode && u >= 0x80);
+}
+
+/**
+ * Count the characters at the start of a string which don't need escaping.
+ * 
+ * @param str     The string to scan.
+ * @param length  How many characters @p str has.
+ * @param unicode If characters outside of ASCII must be escaped.
+ * @return The index of the first character which must be escaped, or @p length if there is none.
+ */
+static int libjson_escapeScan(const char* str, int length, bool unicode) {
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('\"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1F);
+
+    for(; i+32 <= length; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(str+i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_max_epu8(v, control32), control32));
+        if(unicode) {
+            hit = _mm256_or_si256(hit, v);
+        }
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i quote16 = _mm_set1_epi8('\"');
+    const __m128i backslash16 = _mm_set1_epi8('\\');
+    const __m128i control16 = _mm_set1_epi8(0x1F);
+
+    for(; i+16 <= length; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str+i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote16), _mm_cmpeq_epi8(v, backslash16));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_max_epu8(v, control16), control16));
+        if(unicode) {
+            hit = _mm_or_si128(hit, v);
+        }
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    while(i < length && !libjson_needsEscape(str[i], unicode)) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Write the escape sequence for the character at the start of a string.
+ * Characters outside of ASCII are decoded from UTF-8, and invalid UTF-8 is written as U+FFFD.
+ * 
+ * @param str      The string beginning with the character to escape.
+ * @param out      Where to write the escape sequence. Must have space for 12 characters.
+ * @param consumed Where to store how many characters of @p str were escaped.
+ * @return How many characters were written to @p out.
+ */
+static int libjson_escapeCharacter(const char* str, char* out, int* consumed) {
+    unsigned char c = (unsigned char)str[0];
+    *consumed = 1;
+
+    switch(c) {
+        case '\"': out[0] = '\\'; out[1] = '\"'; return 2;
+        case '\\': out[0] = '\\'; out[1] = '\\'; return 2;
+        case '\b': out[0] = '\\'; out[1] = 'b'; return 2;
+        case '\f': out[0] = '\\'; out[1] = 'f'; return 2;
+        case '\n': out[0] = '\\'; out[1] = 'n'; return 2;
+        case '\r': out[0] = '\\'; out[1] = 'r'; return 2;
+        case '\t': out[0] = '\\'; out[1] = 't'; return 2;
+    }
+
+    if(c < 0x80) {
+        return sprintf(out, "\\u%04x", c);
+    }
+
+    int continuation = c >= 0xF8 ? 0 : c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    unsigned codePoint = c & (0x3F >> continuation);
+
+    for(int i=1; i<=continuation; i++) {
+        unsigned char next = (unsigned char)str[i];
+        if((next & 0xC0) != 0x80) {
+            continuation = 0;
+            break;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3F);
+    }
+
+    if(continuation == 0 || codePoint > 0x10FFFF) {
+        return sprintf(out, "\\ufffd");
+    }
+    *consumed = continuation+1;
+
+    if(codePoint >= 0x10000) {
+        codePoint -= 0x10000;
+        return sprintf(out, "\\u%04x\\u%04x", 0xD800 + (codePoint >> 10), 0xDC00 + (codePoint & 0x3FF));
+    }
+    return sprintf(out, "\\u%04x", codePoint);
+}
+
+/**
+ * Read the four hexadecimal digits of a \\u escape.
+ * 
+ * @param str The digits.
+ * @return The value of the digits, or -1 if they aren't four hexadecimal digits.
+ */
+static int libjson_hexValue(char* str) {
+    int value = 0;
+
+    for(int i=0; i<4; i++) {
+        char c = str[i];
+        value <<= 4;
+
+        if(c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if(c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if(c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+/**
+ * Write a unicode code point as UTF-8.
+ * 
+ * @param codePoint The code point to write.
+ * @param out       Where to write it. Must have space for 4 characters.
+ * @return How many characters were written.
+ */
+static int libjson_encodeUTF8(unsigned codePoint, char* out) {
+    if(codePoint < 0x80) {
+        out[0] = (char)codePoint;
+        return 1;
+    } else if(codePoint < 0x800) {
+        out[0] = (char)(0xC0 | (codePoint >> 6));
+        out[1] = (char)(0x80 | (codePoint & 0x3F));
+        return 2;
+    } else if(codePoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codePoint >> 12));
+        out[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codePoint >> 18));
+    out[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+/**
+ * Find the cached output of a container.
+ * 
+ * @param cache    The cache to search.
+ * @param elements The storage of the container.
+ * @return The cached output, or NULL if there is none.
+ */
+static JSONCacheEntry* libjson_cacheFind(JSONCache* cache, const void* elements) {
+    if(cache->capacity == 0) {
+        return NULL;
+    }
+
+    unsigned mask = (unsigned)cache->capacity - 1;
+    unsigned slot = (unsigned)(((uintptr_t)elements >> 4) * 2654435761u) & mask;
+
+    while(cache->entries[slot].elements) {
+        if(cache->entries[slot].elements == elements) {
+            return &cache->entries[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+/**
+ * Keep a copy of the output of a container, replacing any previous output.
+ * When the cache fills up, output that wasn't used by the current serialization is dropped.
+ * 
+ * @param cache    The cache to store the output in.
+ * @param elements The storage of the container.
+ * @param text     The container's output.
+ * @param length   How many characters @p text has.
+ */
+static void libjson_cacheStore(JSONCache* cache, const void* elements, const char* text, int length) {
+    JSONCacheEntry* entry = libjson_cacheFind(cache, elements);
+
+    if(!entry && (cache->numberOfEntries+1)*2 > cache->capacity) {
+        JSONCacheEntry* old = cache->entries;
+        int oldCapacity = cache->capacity;
+        int live = 0;
+
+        for(int i=0; i<oldCapacity; i++) {
+            live += old[i].elements && old[i].generation == cache->generation;
+        }
+
+        int capacity = 16;
+        while(capacity < (live+1)*4) {
+            capacity *= 2;
+        }
+
+        cache->entries = (JSONCacheEntry*)calloc(capacity, sizeof(JSONCacheEntry));
+        if(!cache->entries) {
+            fprintf(stderr, "Ran out of memory in cacheStore");
+            cache->entries = old;
+            return;
+        }
+        cache->capacity = capacity;
+        cache->numberOfEntries = 0;
+
+        for(int i=0; i<oldCapacity; i++) {
+            if(old[i].elements && old[i].generation == cache->generation) {
+                unsigned slot = (unsigned)(((uintptr_t)old[i].elements >> 4) * 2654435761u) & (unsigned)(capacity-1);
+                while(cache->entries[slot].elements) {
+                    slot = (slot + 1) & (unsigned)(capacity-1);
+                }
+                cache->entries[slot] = old[i];
+                cache->numberOfEntries++;
+            } else {
+                libjson_dealloc(old[i].text);
+            }
+        }
+        libjson_dealloc(old);
+    }
+
+    if(!entry) {
+        unsigned mask = (unsigned)cache->capacity - 1;
+        unsigned slot = (unsigned)(((uintptr_t)elements >> 4) * 2654435761u) & mask;
+        while(cache->entries[slot].elements) {
+            slot = (slot + 1) & mask;
+        }
+        entry = &cache->entries[slot];
+        entry->elements = elements;
+        entry->text = NULL;
+        cache->numberOfEntries++;
+    }
+
+    char* tmp = (char*)realloc(entry->text, length);
+    if(tmp) {
+        for(int i=0; i<length; i++) {
+            tmp[i] = text[i];
+        }
+        entry->text = tmp;
+        entry->length = length;
+    }
+    entry->generation = cache->generation;
+}
+
+/**
+ * Append a json value which isn't an object or array to a buffer.
+ * 
+ * @param out     The buffer to append to.
+ * @param element The value to append.
+ */
+static void libjson_appendScalar(JSONBuffer* out, const JSONElement* element) {
+    char tmp[512] = {0};
+
+    switch(element->type) {
+        case boolean:
+            if(element->boolean) {
+                libjson_bufferAppend(out, "true", 4);
+            } else {
+                libjson_bufferAppend(out, "false", 5);
+            }
+            break;
+        case number:
+            if(element->flags & LIBJSON_RAW) {
+                const char* text = element->flags & LIBJSON_INLINE ? element->inlined : element->string;
+                libjson_bufferAppend(out, text, libjson_strlen(text));
+                break;
+            } else if(element->flags & LIBJSON_INTEGER) {
+                sprintf(tmp, "%lld", (long long)element->integer);
+            } else {
+                libjson_formatDouble(element->number, tmp);
+            }
+            libjson_bufferAppend(out, tmp, libjson_strlen(tmp));
+            break;
+        case string:
+            libjson_bufferAppendString(out, e_getString(element));
+            break;
+        case null:
+            libjson_bufferAppend(out, "null", 4);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Append the string representation of a json value to a buffer, without recursion.
+ * With a cache, the cached output of containers which haven't been modified is
+ * copied, and the output of those which have is cached.
+ * 
+ * @param out   The buffer to append to.
+ * @param root  The value to convert to string.
+ * @param cache The output kept from previous conversions, or NULL.
+ */
+static void libjson_appendTree(JSONBuffer* out, JSONElement* root, JSONCache* cache) {
+    JSONStack stack = {NULL, 0, 0};
+
+    if(root->type != object && root->type != array) {
+        libjson_appendScalar(out, root);
+        return;
+    }
+
+    libjson_appendContainer(out, &stack, root, cache);
+
+    while(stack.depth > 0) {
+        JSONFrame* top = &stack.frames[stack.depth-1];
+        JSONElement* element = top->element;
+        bool isObject = element->type == object;
+        int numberOfElements = isObject ? element->object.numberOfElements : element->array.numberOfElements;
+
+        if(top->next == numberOfElements) {
+            libjson_bufferAppend(out, isObject ? "}" : "]", 1);
+
+            if(cache) {
+                const void* elements = isObject ? (const void*)element->object.elements : (const void*)element->array.elements;
+                libjson_cacheStore(cache, elements, out->data+top->start, out->length-top->start);
+                if(isObject) {
+                    element->object.flags |= LIBJSON_CACHED;
+                } else {
+                    element->array.flags |= LIBJSON_CACHED;
+                }
+            }
+            stack.depth--;
+            continue;
+        }
+
+        if(top->next > 0) {
+            libjson_bufferAppend(out, ",", 1);
+        }
+
+        JSONElement* child;
+        JSONElement scratch;
+        if(isObject) {
+            libjson_bufferAppendString(out, libjson_keyAt(&element->object, top->next));
+            libjson_bufferAppend(out, ":", 1);
+            child = libjson_valueAt(&element->object, top->next);
+        } else {
+            child = (JSONElement*)libjson_elementAt(&element->array, top->next, &scratch);
+        }
+        top->next++;
+
+        if(child->type == object || child->type == array) {
+            libjson_appendContainer(out, &stack, child, cache);
+        } else {
+            libjson_appendScalar(out, child);
+        }
+    }
+    libjson_release(stack.frames, sizeof(JSONFrame)*stack.capacity);
+}
+
+/**
+ * Begin appending an object or array to a buffer. Empty containers, and those
+ * with unmodified cached output, are appended whole. Others are opened on the stack.
+ * 
+ * @param out     The buffer to append to.
+ * @param stack   The containers being appended.
+ * @param element The object or array to append.
+ * @param cache   The output kept from previous conversions, or NULL.
+ * @return If the container was opened on the stack, true. Otherwise, false.
+ */
+static bool libjson_appendContainer(JSONBuffer* out, JSONStack* stack, JSONElement* element, JSONCache* cache) {
+    bool isObject = element->type == object;
+    const void* elements = isObject ? (const void*)element->object.elements : (const void*)element->array.elements;
+    int numberOfElements = isObject ? element->object.numberOfElements : element->array.numberOfElements;
+    int flags = isObject ? element->object.flags : element->array.flags;
+
+    if(numberOfElements == 0) {
+        libjson_bufferAppend(out, isObject ? "{}" : "[]", 2);
+        return false;
+    }
+
+    if(cache && (flags & LIBJSON_CACHED)) {
+        JSONCacheEntry* entry = libjson_cacheFind(cache, elements);
+        if(entry) {
+            entry->generation = cache->generation;
+            libjson_bufferAppend(out, entry->text, entry->length);
+            return false;
+        }
+    }
+
+    JSONFrame* frame = libjson_push(stack, element);
+    if(!frame) {
+        return false;
+    }
+    frame->start = out->length;
+    libjson_bufferAppend(out, isObject ? "{" : "[", 1);
+    return true;
+}
 
 /**
  * Free a pointer, and set it to NULL.
@@ -1616,6 +7330,128 @@ static void libjson_deallocate(void** p) {
     }
 }
 
+#ifdef LIBJSON_POOL
+/**
+ * Find the smallest size class of a JSONPool which has room for a number of bytes.
+ * 
+ * @param size The number of bytes.
+ * @return The class, or LIBJSON_POOL_CLASSES if the bytes don't fit in any class.
+ */
+static int libjson_sizeClass(int size) {
+    int k = 0;
+    while(k < LIBJSON_POOL_CLASSES && (16 << k) < size) {
+        k++;
+    }
+    return k;
+}
+#endif
+
+/**
+ * Allocate memory which may later go back to the pool, taking it from the pool if it can.
+ * With LIBJSON_POOL, the memory is rounded up to its size class.
+ * @warning Return value should be freed with libjson_release, or free, when no longer needed.
+ * 
+ * @param size How many bytes are needed.
+ * @return The memory, or NULL if there wasn't enough memory.
+ */
+static void* libjson_allocate(int size) {
+#ifdef LIBJSON_POOL
+    int k = libjson_sizeClass(size);
+    if(k < LIBJSON_POOL_CLASSES) {
+        void* block = libjson_pool.blocks[k];
+        if(!block) {
+            return malloc(16 << k);
+        }
+        libjson_pool.blocks[k] = *(void**)block;
+        libjson_pool.sizes[k] -= 16 << k;
+        return block;
+    }
+#endif
+    return malloc(size);
+}
+
+/**
+ * Resize memory from libjson_allocate, as realloc does. Within a size class, it's left where it is.
+ * 
+ * @param memory  The memory to resize, or NULL.
+ * @param size    How many bytes @p memory was allocated for.
+ * @param newSize How many bytes are needed.
+ * @return The resized memory, or NULL if there wasn't enough memory, or if @p newSize is 0.
+ */
+static void* libjson_resize(void* memory, int size, int newSize) {
+#ifdef LIBJSON_POOL
+    int k = libjson_sizeClass(size);
+    int newK = libjson_sizeClass(newSize);
+
+    if(newSize == 0) {
+        libjson_release(memory, size);
+        return NULL;
+    } else if(memory && k == newK && k < LIBJSON_POOL_CLASSES) {
+        return memory;
+    } else if(k < LIBJSON_POOL_CLASSES || newK < LIBJSON_POOL_CLASSES) {
+        char* resized = (char*)libjson_allocate(newSize);
+        for(int i=0; resized && memory && i<size && i<newSize; i++) {
+            resized[i] = ((char*)memory)[i];
+        }
+        if(resized) {
+            libjson_release(memory, size);
+        }
+        return resized;
+    }
+#else
+    (void)size;
+#endif
+    return realloc(memory, newSize);
+}
+
+/**
+ * Give back memory from libjson_allocate, keeping it in the pool if it has room.
+ * 
+ * @param memory The memory to give back, or NULL.
+ * @param size   How many bytes @p memory was allocated for. Fewer may be given, but not more.
+ */
+static void libjson_release(void* memory, int size) {
+    if(!memory) {
+        return;
+    }
+#ifdef LIBJSON_POOL
+    int k = libjson_sizeClass(size);
+    if(k < LIBJSON_POOL_CLASSES && libjson_pool.sizes[k] + (16 << k) <= LIBJSON_POOL_LIMIT) {
+        *(void**)memory = libjson_pool.blocks[k];
+        libjson_pool.blocks[k] = memory;
+        libjson_pool.sizes[k] += 16 << k;
+        return;
+    }
+#else
+    (void)size;
+#endif
+    free(memory);
+}
+
+/**
+ * Give back a string allocated by libjson, keeping it in the pool if it has room.
+ * 
+ * @param str The string to give back, or NULL.
+ */
+static void libjson_releaseString(char* str) {
+    libjson_release(str, str ? libjson_strlen(str)+1 : 0);
+}
+
+/**
+ * Take ownership of a string allocated by the caller, resizing it to a size class so it can go back to the pool.
+ * 
+ * @param str The string, allocated with malloc.
+ * @return The string, which may have moved, or NULL if there wasn't enough memory, leaving @p str as it was.
+ */
+static char* libjson_adoptString(char* str) {
+#ifdef LIBJSON_POOL
+    int k = str ? libjson_sizeClass(libjson_strlen(str)+1) : LIBJSON_POOL_CLASSES;
+    return k < LIBJSON_POOL_CLASSES ? (char*)realloc(str, 16 << k) : str;
+#else
+    return str;
+#endif
+}
+
 /**
  * Round a double down, truncating any decimal points off.
  * 
@@ -1657,7 +7493,7 @@ static bool libjson_isspace(char c) {
  * @param str The string to copy.
  * @return The copied string.
  */
-static char* libjson_strcpy(char* str) {
+static char* libjson_strcpy(const char* str) {
     if(!str) {
         return NULL;
     }
@@ -1680,7 +7516,7 @@ static char* libjson_strcpy(char* str) {
  * @param s2 The second string to compare.
  * @return If the strings are identical and not null, true. Otherwise, false.
  */
-static bool libjson_strcmp(char* s1, char* s2) {
+static bool libjson_strcmp(const char* s1, const char* s2) {
     int i = 0;
 
     if(!s1 || !s2) {
@@ -1702,7 +7538,7 @@ static bool libjson_strcmp(char* s1, char* s2) {
  * @param str The string to get the number of characters of.
  * @return The number of characters in the string.
  */
-static int libjson_strlen(char* str) {
+static int libjson_strlen(const char* str) {
     int len = 0;
 
     if(str) {
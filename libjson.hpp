@@ -0,0 +1,550 @@
+#ifndef __LIB_JSON_HPP__
+#define __LIB_JSON_HPP__
+
+/**
+ * @file libjson.hpp
+ *
+ * C++17 wrappers around libjson.h, which own and free json values
+ * automatically, and read them through non-owning views.
+ * Keys are taken as std::string_view, and never need to be null terminated
+ * or measured with strlen to be looked up.
+ */
+
+#include "libjson.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace libjson {
+
+/*~ Keys ~*/
+
+/**
+ * Hash a key with 64 bit FNV-1a. Usable at compile time.
+ *
+ * @param key The key to hash.
+ * @return The key's hash.
+ */
+constexpr std::uint64_t hash(std::string_view key) {
+    std::uint64_t h = 14695981039346656037ull;
+    for(char c : key) {
+        h = (h ^ (unsigned char)c) * 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * A key, with its length and hash worked out once, at compile time for literals.
+ * The hash lets members be dispatched on with a switch, see Member::hash.
+ */
+struct Key {
+    std::string_view name; /**< The key. */
+    std::uint64_t hash;    /**< The key's hash. */
+
+    constexpr Key(std::string_view name) : name(name), hash(libjson::hash(name)) {}
+    constexpr Key(const char* name) : Key(std::string_view(name)) {}
+};
+
+namespace literals {
+
+/**
+ * A key literal, hashed at compile time. e.g. "id"_key
+ */
+constexpr Key operator""_key(const char* name, std::size_t length) {
+    return Key(std::string_view(name, length));
+}
+
+} // namespace literals
+
+/**
+ * Check if a key stored in json matches another key, without measuring either.
+ *
+ * @param stored The null terminated key stored in json.
+ * @param key    The key to compare with.
+ * @return If the keys are identical, true. Otherwise, false.
+ */
+inline bool keyEquals(const char* stored, std::string_view key) {
+    for(std::size_t i=0; i<key.size(); i++) {
+        if(stored[i] != key[i]) {
+            return false;
+        }
+    }
+    return stored[key.size()] == '\0';
+}
+
+/**
+ * Frees strings returned by libjson.
+ */
+struct Free {
+    void operator()(char* str) const { std::free(str); }
+};
+
+/**
+ * A string returned by libjson, freed when it goes out of scope.
+ */
+using String = std::unique_ptr<char, Free>;
+
+class View;
+
+/**
+ * A key/value pair within an object, visited by iterating a View's members.
+ */
+struct Member {
+    const char* key; /**< The pair's key, null terminated. */
+    const JSONElement* value; /**< The pair's value. */
+
+    std::string_view name() const { return key; }
+    std::uint64_t hash() const;
+    View view() const;
+};
+
+/*~ Views ~*/
+
+/**
+ * A non-owning, read only view of a json value. Views of missing values are empty,
+ * and read as null. A view is invalidated by anything which invalidates o_cref.
+ */
+class View {
+public:
+    /**
+     * Iterates the values of an array.
+     */
+    class Iterator {
+    public:
+        Iterator(const JSONArray* json, int index) : json(json), index(index) {}
+        View operator*() const { return View(json, index); }
+        Iterator& operator++() { index++; return *this; }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+
+    private:
+        const JSONArray* json;
+        int index;
+    };
+
+    /**
+     * Iterates the key/value pairs of an object.
+     */
+    class MemberIterator {
+    public:
+        MemberIterator() = default;
+        explicit MemberIterator(const JSONObject* json) : iterator(o_iterate(json)), valid(o_next(&iterator)) {}
+        Member operator*() const { return Member{iterator.key, iterator.value}; }
+        MemberIterator& operator++() { valid = o_next(&iterator); return *this; }
+        bool operator!=(const MemberIterator& other) const { return valid != other.valid; }
+
+    private:
+        JSONObjectIterator iterator = {};
+        bool valid = false;
+    };
+
+    /**
+     * The key/value pairs of an object, for range-for.
+     */
+    struct Members {
+        const JSONObject* json;
+        MemberIterator begin() const { return json ? MemberIterator(json) : MemberIterator(); }
+        MemberIterator end() const { return MemberIterator(); }
+    };
+
+    View() = default;
+    explicit View(const JSONElement* element) : element(element) {}
+
+    /**
+     * A view of the value at an index of an array. A value of a packed array
+     * is decoded into the view, leaving the array as it is.
+     */
+    View(const JSONArray* json, int index) : element(a_cref(json, index, &scratch)) {}
+
+    View(const View& other) { *this = other; }
+
+    View& operator=(const View& other) {
+        scratch = other.scratch;
+        element = other.element == &other.scratch ? &scratch : other.element;
+        return *this;
+    }
+
+    // -- Check --
+    explicit operator bool() const { return element != nullptr; }
+    JSONType type() const { return element ? element->type : null; }
+    bool isObject() const { return type() == ::object; }
+    bool isArray() const { return type() == ::array; }
+    bool isBoolean() const { return type() == ::boolean; }
+    bool isNumber() const { return type() == ::number; }
+    bool isInt() const { return element && e_isInt(element); }
+    bool isString() const { return type() == ::string; }
+    bool isNull() const { return type() == ::null; }
+
+    // -- Accessors --
+    bool asBoolean(bool dflt = false) const { return isBoolean() ? element->boolean : dflt; }
+
+    std::int64_t asInt(std::int64_t dflt = 0) const { return isNumber() ? (std::int64_t)e_getInt(element) : dflt; }
+    double asDouble(double dflt = 0) const { return isNumber() ? (double)e_getDouble(element) : dflt; }
+
+    /**
+     * The value of a string, null terminated, without measuring it.
+     */
+    const char* asCString(const char* dflt = nullptr) const { return isString() ? e_getString(element) : dflt; }
+
+    /**
+     * The value of a string. Only strings which aren't interned have to be measured.
+     */
+    std::string_view asString(std::string_view dflt = {}) const {
+        if(!isString()) {
+            return dflt;
+        }
+        if(element->flags & LIBJSON_INTERNED) {
+            return std::string_view(element->string, (std::size_t)((const JSONInterned*)element->string - 1)->length);
+        }
+        return std::string_view(e_getString(element));
+    }
+
+    /**
+     * The value paired with a key in an object, or an empty view.
+     */
+    View operator[](Key key) const {
+        // Shaped objects are looked up by the key's hash, worked out once
+        if(isObject() && (element->object.flags & LIBJSON_SHAPED)) {
+            const JSONShape* shape = element->object.record->shape;
+            unsigned mask = (unsigned)(shape->capacity-1);
+
+            for(unsigned slot = (unsigned)key.hash & mask; shape->table[slot]; slot = (slot+1) & mask) {
+                int index = shape->table[slot]-1;
+                if(keyEquals(shape->keys[index], key.name)) {
+                    return View(&element->object.record->values[index]);
+                }
+            }
+            return View();
+        }
+
+        if(isObject()) {
+            JSONObjectIterator iterator = o_iterate(&element->object);
+            while(o_next(&iterator)) {
+                if(keyEquals(iterator.key, key.name)) {
+                    return View(iterator.value);
+                }
+            }
+        }
+        return View();
+    }
+
+    /**
+     * The value at an index of an array, or an empty view.
+     */
+    View operator[](std::size_t index) const {
+        if(isArray() && index < (std::size_t)element->array.numberOfElements) {
+            return View(&element->array, (int)index);
+        }
+        return View();
+    }
+
+    /**
+     * How many values an object or array has.
+     */
+    std::size_t size() const {
+        if(isObject()) {
+            return (std::size_t)element->object.numberOfElements;
+        }
+        return isArray() ? (std::size_t)element->array.numberOfElements : 0;
+    }
+
+    // -- Iteration --
+    Iterator begin() const { return Iterator(isArray() ? &element->array : nullptr, 0); }
+    Iterator end() const { return Iterator(isArray() ? &element->array : nullptr, (int)(isArray() ? element->array.numberOfElements : 0)); }
+
+    Members members() const {
+        return Members{isObject() ? &element->object : nullptr};
+    }
+
+    const JSONElement* get() const { return element; }
+
+private:
+    JSONElement scratch = {}; /**< A value decoded from a packed array, which @c element points to. */
+    const JSONElement* element = nullptr;
+};
+
+/**
+ * Hash a member's key, comparable with Key::hash, without measuring it first.
+ */
+inline std::uint64_t Member::hash() const {
+    std::uint64_t h = 14695981039346656037ull;
+    for(const char* c = key; *c != '\0'; c++) {
+        h = (h ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    return h;
+}
+
+inline View Member::view() const {
+    return View(value);
+}
+
+/*~ Values ~*/
+
+/**
+ * An owned json value, freed when it goes out of scope. Values can be moved but not copied.
+ * Moving a value into an object or array hands over its storage without copying it.
+ */
+class Value {
+public:
+    Value() : element(empty()) {}
+    Value(std::nullptr_t) : Value() {}
+
+    Value(bool value) : Value() {
+        element.type = ::boolean;
+        element.boolean = value;
+    }
+
+    Value(int value) : Value((long long)value) {}
+    Value(long value) : Value((long long)value) {}
+
+    Value(long long value) : Value() {
+        element.type = ::number;
+        element.flags = LIBJSON_INTEGER;
+        element.integer = (std::int64_t)value;
+    }
+
+    Value(double value) : Value() {
+        element.type = ::number;
+        element.number = value;
+    }
+
+    Value(std::string_view value) : Value() {
+        element.type = ::string;
+        if(value.size() < LIBJSON_INLINE_LENGTH) {
+            std::memcpy(element.inlined, value.data(), value.size());
+            element.inlined[value.size()] = '\0';
+            element.flags = LIBJSON_INLINE;
+        } else {
+            element.string = copy(value);
+        }
+    }
+
+    Value(const char* value) : Value(std::string_view(value)) {}
+
+    /**
+     * Take ownership of a json value from the C interface.
+     */
+    static Value adopt(JSONElement element) {
+        Value value;
+        value.element = element;
+        return value;
+    }
+
+    static Value object() {
+        JSONElement element = empty();
+        element.type = ::object;
+        element.object = o_emptyJSONObject();
+        return adopt(element);
+    }
+
+    static Value array() {
+        JSONElement element = empty();
+        element.type = ::array;
+        element.array = a_emptyJSONArray();
+        return adopt(element);
+    }
+
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
+    Value(Value&& other) noexcept : element(other.release()) {}
+
+    Value& operator=(Value&& other) noexcept {
+        if(this != &other) {
+            e_destroyJSONElement(&element);
+            element = other.release();
+        }
+        return *this;
+    }
+
+    ~Value() { e_destroyJSONElement(&element); }
+
+    // -- Mutators --
+    /**
+     * Set a value for a key in an object, replacing any old value. The key is copied once.
+     * Does nothing if this isn't an object.
+     */
+    Value& set(Key key, Value&& value) {
+        if(element.type == ::object) {
+            o_moveJSONElement(&element.object, copy(key.name), value.release());
+        }
+        return *this;
+    }
+
+    /**
+     * Add a value to the end of an array. Does nothing if this isn't an array.
+     */
+    Value& push(Value&& value) {
+        if(element.type == ::array) {
+            a_moveJSONElement(&element.array, element.array.numberOfElements, value.release());
+        }
+        return *this;
+    }
+
+    /**
+     * Rebuild an object or array into one block of memory, depth first, as it's read.
+     * Views of the value, or of anything within it at any depth, are no longer valid afterwards.
+     *
+     * @return If the value was compacted.
+     */
+    bool compact() {
+        if(element.type == ::object) {
+            return o_compact(&element.object);
+        }
+        return element.type == ::array && a_compact(&element.array);
+    }
+
+    /**
+     * Give up ownership of the value, to the C interface.
+     */
+    JSONElement release() {
+        JSONElement released = element;
+        element = empty();
+        return released;
+    }
+
+    // -- Accessors --
+    View view() const { return View(&element); }
+    operator View() const { return view(); }
+    View operator[](Key key) const { return view()[key]; }
+    View operator[](std::size_t index) const { return view()[index]; }
+
+    JSONElement* get() { return &element; }
+    const JSONElement* get() const { return &element; }
+
+    // -- To String --
+    /**
+     * Convert an object or array to a string.
+     *
+     * @return The string, or null if this isn't an object or array.
+     */
+    String toString() const {
+        if(element.type == ::object) {
+            return String(o_JSONObjectToString(element.object));
+        } else if(element.type == ::array) {
+            return String(a_JSONArrayToString(element.array));
+        }
+        return String();
+    }
+
+private:
+    /**
+     * A json null, which owns nothing.
+     */
+    static JSONElement empty() {
+        JSONElement element = {};
+        element.type = ::null;
+        return element;
+    }
+
+    static char* copy(std::string_view str) {
+        char* cpy = (char*)std::malloc(str.size()+1);
+        if(cpy) {
+            std::memcpy(cpy, str.data(), str.size());
+            cpy[str.size()] = '\0';
+        }
+        return cpy;
+    }
+
+    JSONElement element;
+};
+
+/*~ Parsing ~*/
+
+/**
+ * A parsed json document, owning its root object or array.
+ */
+class Document {
+public:
+    Document() = default;
+    Document(Value&& root, JSONError error) : root(std::move(root)), parseError(error) {}
+
+    /**
+     * If the document was parsed without error.
+     */
+    explicit operator bool() const { return parseError.kind == errorNone; }
+
+    const JSONError& error() const { return parseError; }
+    View view() const { return root.view(); }
+    View operator[](Key key) const { return root[key]; }
+    View operator[](std::size_t index) const { return root[index]; }
+    Value& value() { return root; }
+    String toString() const { return root.toString(); }
+
+    static Document parse(const char* json);
+    static Document parse(const std::string& json) { return parse(json.c_str()); }
+
+private:
+    Value root;
+    JSONError parseError = {errorNone, 0};
+};
+
+/**
+ * Parses documents without recursion, reusing its memory between them.
+ * With @c pack, arrays of only numbers are parsed into LIBJSON_PACKED storage,
+ * with @c share, objects with the same keys are parsed into LIBJSON_SHAPED storage,
+ * with @c raw, numbers keep their json text (LIBJSON_RAW),
+ * with @c intern, equal string values share one copy (LIBJSON_INTERNED),
+ * and with @c reuse, documents are built in the parser's own memory (LIBJSON_ARENA).
+ * @warning With @c reuse, a document is read only, and only lasts until the parser's next parse.
+ */
+class Parser {
+public:
+    explicit Parser(int maxDepth = LIBJSON_MAX_DEPTH, bool pack = false, bool share = false, bool raw = false, bool intern = false, bool reuse = false) : parser(p_emptyJSONParser()) {
+        parser.maxDepth = maxDepth;
+        parser.pack = pack;
+        parser.share = share;
+        parser.raw = raw;
+        parser.intern = intern;
+        parser.reuse = reuse;
+    }
+
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
+    ~Parser() { p_destroyJSONParser(&parser); }
+
+    /**
+     * Parse a document whose root is an object or an array.
+     * Any other root is an error, at its first character, and leaves the document null.
+     *
+     * @param json The json to parse, null terminated.
+     * @return The document. Check it, or its error(), to find out if parsing failed.
+     */
+    Document parse(const char* json) {
+        char* str = const_cast<char*>(json);
+        std::size_t start = std::strspn(json, " \t\n\r");
+        JSONElement root = {};
+
+        if(json[start] == '[') {
+            root.type = ::array;
+            root.array = p_parseJSONArray(&parser, str);
+        } else if(json[start] == '{') {
+            root.type = ::object;
+            root.object = p_parseJSONObject(&parser, str);
+        } else {
+            parser.error.kind = json[start] == '\0' ? errorUnexpectedEnd : errorUnexpectedCharacter;
+            parser.error.offset = (int)start;
+            return Document(Value(), parser.error);
+        }
+        return Document(Value::adopt(root), parser.error);
+    }
+
+    Document parse(const std::string& json) { return parse(json.c_str()); }
+
+private:
+    JSONParser parser;
+};
+
+inline Document Document::parse(const char* json) {
+    Parser parser;
+    return parser.parse(json);
+}
+
+} // namespace libjson
+
+#endif // __LIB_JSON_HPP__
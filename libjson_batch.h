@@ -0,0 +1,506 @@
+#ifndef __LIB_JSON_BATCH_H__
+#define __LIB_JSON_BATCH_H__
+
+/**
+ * @file libjson_batch.h
+ * 
+ * Loads and parses many json files at once. Reads are issued through io_uring
+ * where the kernel allows it, and handed to a pool of parser threads as they
+ * complete. Elsewhere, each parser thread reads its own files with pread.
+ * Define LIBJSON_BATCH_PREAD before including libjson_batch.h to always read with pread.
+ * @note Requires POSIX threads. Link with -pthread.
+ * @note Include this before any system header, or compile with -D_GNU_SOURCE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "libjson.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*~ Data Structures ~*/
+
+/**
+ * How many reads are kept in flight at once through io_uring.
+ */
+#define LIBJSON_BATCH_READS 64
+
+/**
+ * A function receiving each file loaded by b_loadJSONObjects.
+ * It's called from the parser threads, possibly at the same time for different files.
+ * 
+ * @param index   The index of the file's path.
+ * @param path    The file's path.
+ * @param json    The parsed file. The function takes ownership of it.
+ * @param error   Why the file couldn't be read or parsed, or errorNone.
+ * @param context The context given to b_loadJSONObjects.
+ */
+typedef void (*JSONBatchFunction)(int index, const char* path, JSONObject json, JSONError error, void* context);
+
+/**
+ * A file which has been read, waiting to be parsed.
+ */
+typedef struct JSONBatchItem {
+    int index;   /**< The index of the file's path. */
+    char* data;  /**< The file's contents, null terminated, or NULL if it couldn't be read. */
+} JSONBatchItem;
+
+/**
+ * The state shared between the reading thread and the parser threads.
+ */
+typedef struct JSONBatch {
+    char** paths;               /**< The paths of the files to load. */
+    int numberOfPaths;          /**< How many paths there are. */
+    JSONBatchFunction callback; /**< Receives each parsed file. */
+    void* context;              /**< Passed along to @c callback. */
+
+    JSONBatchItem* queue;       /**< Files read but not yet parsed, in a ring. */
+    int capacity;               /**< How many files @c queue has space for. */
+    int head;                   /**< The index in @c queue of the next file to parse. */
+    int numberOfItems;          /**< How many files are in @c queue. */
+    bool reading;               /**< If files are still being added to @c queue. */
+    int next;                   /**< The index of the next path to read, when parser threads read for themselves. */
+    bool selfReading;           /**< If parser threads read their own files with pread. */
+
+    pthread_mutex_t lock;       /**< Guards the queue and @c next. */
+    pthread_cond_t notEmpty;    /**< Signalled when a file is added to @c queue, or reading ends. */
+    pthread_cond_t notFull;     /**< Signalled when a file is taken from @c queue. */
+} JSONBatch;
+
+/*~ Interface ~*/
+
+/*=============================================================================
+    JSONBatch
+=============================================================================*/
+
+// -- Loading --
+bool b_loadJSONObjects(char** paths, int numberOfPaths, int numberOfThreads, JSONBatchFunction callback, void* context);
+
+/*~ Implementation ~*/
+
+// -- Helper functions --
+static char* libjson_batchRead(const char* path);
+static void* libjson_batchWorker(void* batch);
+static bool  libjson_batchReadAll(JSONBatch* batch);
+#if defined(__linux__) && defined(__NR_io_uring_setup) && !defined(LIBJSON_BATCH_PREAD)
+static void  libjson_batchPush(JSONBatch* batch, int index, char* data);
+#endif
+
+/*=============================================================================
+    JSONBatch
+=============================================================================*/
+
+// -- Loading --
+/**
+ * Load and parse many json files, overlapping the reading of some with the parsing of others.
+ * Each file is passed to @p callback as soon as it's parsed, so files may arrive in any order.
+ * Returns once every file has been passed to @p callback.
+ * 
+ * @param paths           The paths of the files to load.
+ * @param numberOfPaths   How many paths there are.
+ * @param numberOfThreads How many threads to parse with.
+ * @param callback        Receives each parsed file, from the parser threads.
+ * @param context         Passed along to @p callback.
+ * @return If every file was passed to @p callback, true. If threads couldn't be started, false.
+ */
+bool b_loadJSONObjects(char** paths, int numberOfPaths, int numberOfThreads, JSONBatchFunction callback, void* context) {
+    JSONBatch batch;
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t)*(numberOfThreads > 0 ? numberOfThreads : 1));
+    int started = 0;
+
+    if(!threads) {
+        fprintf(stderr, "Ran out of memory in loadJSONObjects");
+        return false;
+    }
+
+    batch.paths = paths;
+    batch.numberOfPaths = numberOfPaths;
+    batch.callback = callback;
+    batch.context = context;
+    batch.capacity = 2*LIBJSON_BATCH_READS;
+    batch.queue = (JSONBatchItem*)malloc(sizeof(JSONBatchItem)*batch.capacity);
+    batch.head = 0;
+    batch.numberOfItems = 0;
+    batch.reading = true;
+    batch.next = 0;
+    batch.selfReading = false;
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.notEmpty, NULL);
+    pthread_cond_init(&batch.notFull, NULL);
+
+    if(!batch.queue) {
+        fprintf(stderr, "Ran out of memory in loadJSONObjects");
+        libjson_dealloc(threads);
+        return false;
+    }
+
+    for(; started < numberOfThreads; started++) {
+        if(pthread_create(&threads[started], NULL, libjson_batchWorker, &batch) != 0) {
+            break;
+        }
+    }
+
+    if(started == 0) {
+        batch.reading = false;
+    } else if(!libjson_batchReadAll(&batch)) {
+        pthread_mutex_lock(&batch.lock);
+        batch.selfReading = true;
+        pthread_cond_broadcast(&batch.notEmpty);
+        pthread_mutex_unlock(&batch.lock);
+    }
+
+    pthread_mutex_lock(&batch.lock);
+    batch.reading = false;
+    pthread_cond_broadcast(&batch.notEmpty);
+    pthread_mutex_unlock(&batch.lock);
+
+    for(int i=0; i<started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.notEmpty);
+    pthread_cond_destroy(&batch.notFull);
+    libjson_dealloc(batch.queue);
+    libjson_dealloc(threads);
+
+    return started > 0;
+}
+
+// -- Helper functions --
+
+/**
+ * Read a whole file with pread.
+ * @warning Return value should be freed when no longer needed.
+ * 
+ * @param path The file's path.
+ * @return The file's contents, null terminated, or NULL if it couldn't be read.
+ */
+static char* libjson_batchRead(const char* path) {
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+    char* data = NULL;
+
+    if(fd < 0) {
+        return NULL;
+    }
+
+    if(fstat(fd, &info) == 0 && (data = (char*)malloc(info.st_size+1))) {
+        off_t done = 0;
+
+        while(done < info.st_size) {
+            ssize_t n = pread(fd, data+done, info.st_size-done, done);
+            if(n <= 0) {
+                break;
+            }
+            done += n;
+        }
+
+        if(done < info.st_size) {
+            libjson_dealloc(data);
+        } else {
+            data[done] = '\0';
+        }
+    }
+    close(fd);
+    return data;
+}
+
+/**
+ * Parse files as they're read, or read them with pread if io_uring isn't available.
+ * Each thread keeps one JSONParser for all the files it parses.
+ * 
+ * @param batch The batch to parse files from.
+ * @return NULL.
+ */
+static void* libjson_batchWorker(void* batch) {
+    JSONBatch* b = (JSONBatch*)batch;
+    JSONParser parser = p_emptyJSONParser();
+
+    while(true) {
+        int index = -1;
+        char* data = NULL;
+
+        pthread_mutex_lock(&b->lock);
+        while(b->numberOfItems == 0 && b->reading && !b->selfReading) {
+            pthread_cond_wait(&b->notEmpty, &b->lock);
+        }
+
+        if(b->numberOfItems > 0) {
+            index = b->queue[b->head].index;
+            data = b->queue[b->head].data;
+            b->head = (b->head + 1) % b->capacity;
+            b->numberOfItems--;
+            pthread_cond_signal(&b->notFull);
+        } else if(b->selfReading && b->next < b->numberOfPaths) {
+            index = b->next++;
+        }
+        bool selfReading = b->selfReading && data == NULL;
+        pthread_mutex_unlock(&b->lock);
+
+        if(index < 0) {
+            break;
+        }
+
+        if(selfReading) {
+            data = libjson_batchRead(b->paths[index]);
+        }
+
+        JSONObject json = o_emptyJSONObject();
+        JSONError error = {errorRead, 0};
+
+        if(data) {
+            json = p_parseJSONObject(&parser, data);
+            error = parser.error;
+            libjson_dealloc(data);
+        }
+        b->callback(index, b->paths[index], json, error, b->context);
+    }
+
+    p_destroyJSONParser(&parser);
+    m_drainJSONPool();
+    return NULL;
+}
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && !defined(LIBJSON_BATCH_PREAD)
+
+/**
+ * Hand a file which has been read to the parser threads, waiting while they're busy.
+ * 
+ * @param batch The batch the file belongs to.
+ * @param index The index of the file's path.
+ * @param data  The file's contents, or NULL if it couldn't be read.
+ */
+static void libjson_batchPush(JSONBatch* batch, int index, char* data) {
+    pthread_mutex_lock(&batch->lock);
+    while(batch->numberOfItems == batch->capacity) {
+        pthread_cond_wait(&batch->notFull, &batch->lock);
+    }
+
+    JSONBatchItem* item = &batch->queue[(batch->head + batch->numberOfItems) % batch->capacity];
+    item->index = index;
+    item->data = data;
+    batch->numberOfItems++;
+
+    pthread_cond_signal(&batch->notEmpty);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * Read every file through io_uring, handing each to the parser threads once it's complete.
+ * Up to LIBJSON_BATCH_READS reads are kept in flight. Files opened before io_uring
+ * fails are still read, with pread.
+ * 
+ * @param batch The batch to read the files of.
+ * @return If io_uring could be used, true. Otherwise, false, and no files were read.
+ */
+static bool libjson_batchReadAll(JSONBatch* batch) {
+    struct io_uring_params params = {0};
+    int ring = (int)syscall(__NR_io_uring_setup, LIBJSON_BATCH_READS, &params);
+
+    if(ring < 0) {
+        return false;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqSize = cqSize = sqSize > cqSize ? sqSize : cqSize;
+    }
+
+    char* sq = (char*)mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    char* cq = sq;
+    struct io_uring_sqe* sqes = (struct io_uring_sqe*)MAP_FAILED;
+
+    if(sq != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = (char*)mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    }
+    if(sq != MAP_FAILED && cq != MAP_FAILED) {
+        sqes = (struct io_uring_sqe*)mmap(NULL, params.sq_entries*sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    }
+
+    if(sqes == MAP_FAILED) {
+        if(cq != MAP_FAILED && cq != sq) {
+            munmap(cq, cqSize);
+        }
+        if(sq != MAP_FAILED) {
+            munmap(sq, sqSize);
+        }
+        close(ring);
+        return false;
+    }
+
+    unsigned* sqTail = (unsigned*)(sq + params.sq_off.tail);
+    unsigned sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    unsigned* sqArray = (unsigned*)(sq + params.sq_off.array);
+    unsigned* cqHead = (unsigned*)(cq + params.cq_off.head);
+    unsigned* cqTail = (unsigned*)(cq + params.cq_off.tail);
+    unsigned cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    struct io_uring_cqe* cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    struct {
+        int index;
+        int fd;
+        char* data;
+        off_t size;
+        off_t done;
+    } reads[LIBJSON_BATCH_READS];
+    int idle[LIBJSON_BATCH_READS];
+    bool active[LIBJSON_BATCH_READS] = {false};
+    int numberOfIdle = LIBJSON_BATCH_READS;
+    int inFlight = 0;
+    int next = 0;
+
+    for(int i=0; i<LIBJSON_BATCH_READS; i++) {
+        idle[i] = LIBJSON_BATCH_READS-1-i;
+    }
+
+    while(next < batch->numberOfPaths || inFlight > 0) {
+        unsigned tail = *sqTail;
+        unsigned submitted = 0;
+
+        while(next < batch->numberOfPaths && numberOfIdle > 0) {
+            struct stat info;
+            int index = next++;
+            int fd = open(batch->paths[index], O_RDONLY);
+            char* data = NULL;
+
+            if(fd >= 0 && fstat(fd, &info) == 0 && (data = (char*)malloc(info.st_size+1))) {
+                data[info.st_size] = '\0';
+            }
+
+            if(!data || info.st_size == 0) {
+                if(fd >= 0) {
+                    close(fd);
+                }
+                libjson_batchPush(batch, index, data);
+                continue;
+            }
+
+            int slot = idle[--numberOfIdle];
+            active[slot] = true;
+            reads[slot].index = index;
+            reads[slot].fd = fd;
+            reads[slot].data = data;
+            reads[slot].size = info.st_size;
+            reads[slot].done = 0;
+
+            struct io_uring_sqe* sqe = &sqes[tail & sqMask];
+            for(size_t i=0; i<sizeof(*sqe); i++) {
+                ((char*)sqe)[i] = 0;
+            }
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (uintptr_t)data;
+            sqe->len = (unsigned)info.st_size;
+            sqe->off = 0;
+            sqe->user_data = (uint64_t)slot;
+            sqArray[tail & sqMask] = tail & sqMask;
+            tail++;
+            submitted++;
+        }
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        inFlight += submitted;
+
+        if(inFlight == 0) {
+            break;
+        }
+
+        long entered;
+        do {
+            entered = syscall(__NR_io_uring_enter, ring, submitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        } while(entered < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+
+        if(entered < 0) {
+            break;
+        }
+
+        unsigned head = *cqHead;
+        while(head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &cqes[head & cqMask];
+            int slot = (int)cqe->user_data;
+            int result = cqe->res;
+            head++;
+            inFlight--;
+
+            if(result > 0) {
+                reads[slot].done += result;
+            }
+
+            // Short and failed reads are finished with pread.
+            ssize_t n = 1;
+            while(reads[slot].done < reads[slot].size && n > 0) {
+                n = pread(reads[slot].fd, reads[slot].data+reads[slot].done, reads[slot].size-reads[slot].done, reads[slot].done);
+                reads[slot].done += n > 0 ? n : 0;
+            }
+
+            close(reads[slot].fd);
+            if(reads[slot].done < reads[slot].size) {
+                libjson_dealloc(reads[slot].data);
+            }
+            libjson_batchPush(batch, reads[slot].index, reads[slot].data);
+            active[slot] = false;
+            idle[numberOfIdle++] = slot;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // If the ring broke, reads still in flight are read again with pread. Their
+    // buffers are abandoned rather than freed, as the kernel may still write to them.
+    for(int slot=0; slot<LIBJSON_BATCH_READS; slot++) {
+        if(active[slot]) {
+            close(reads[slot].fd);
+            libjson_batchPush(batch, reads[slot].index, libjson_batchRead(batch->paths[reads[slot].index]));
+        }
+    }
+
+    for(; next < batch->numberOfPaths; next++) {
+        libjson_batchPush(batch, next, libjson_batchRead(batch->paths[next]));
+    }
+
+    munmap(sqes, params.sq_entries*sizeof(struct io_uring_sqe));
+    if(cq != sq) {
+        munmap(cq, cqSize);
+    }
+    munmap(sq, sqSize);
+    close(ring);
+
+    return true;
+}
+
+#else
+
+/**
+ * Without io_uring, leave the parser threads to read their own files.
+ * 
+ * @param batch The batch to read the files of.
+ * @return False.
+ */
+static bool libjson_batchReadAll(JSONBatch* batch) {
+    (void)batch;
+    return false;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LIB_JSON_BATCH_H__
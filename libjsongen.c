@@ -0,0 +1,640 @@
+/**
+ * @file libjsongen.c
+ * @date 2026-10-18
+ *
+ * Generate a decoder and encoder for plain C structs from a schema.
+ * The generated code parses json straight into struct fields, matching keys with
+ * a switch on their length, and never builds a JSONObject.
+ *
+ * Usage: ./libjsongen schema.json > generated.h
+ *
+ * A schema is a json object naming the header, and the types to generate in order.
+ * Each type maps keys to a field type: string, int, double, bool, or the name of a
+ * type declared before it. Any field type may end in [] to make it an array.
+ *
+ *     {
+ *       "name": "inventory",
+ *       "types": {
+ *         "ObjectId":  { "$oid": "string" },
+ *         "Item":      { "_id": "ObjectId", "product_name": "string", "quantity": "int" },
+ *         "Inventory": { "inventory": "Item[]" }
+ *       }
+ *     }
+ *
+ * For each type T, the generated header defines the struct T along with:
+ *     bool  parseT(char* str, T* out);
+ *     char* TToString(const T* in);
+ *     void  destroyT(T* in);
+ * Keys which aren't C identifiers have their other characters replaced with _.
+ * An array field f is stored as a pointer f and a count fCount.
+ * Int fields only accept numbers written without a fraction or exponent which fit in a long, and doubles
+ * which json can't hold, infinity and NaN, are written as null.
+ */
+
+#include "libjson.h"
+#include <string.h>
+
+/**
+ * The kind of value a field holds.
+ */
+typedef enum FieldKind {
+    stringField, /**< char* */
+    intField,    /**< long */
+    doubleField, /**< double */
+    boolField,   /**< bool */
+    structField  /**< A generated struct. */
+} FieldKind;
+
+/**
+ * A field of a generated struct.
+ */
+typedef struct Field {
+    char* key;       /**< The json key of the field. */
+    char name[256];  /**< The C identifier of the field. */
+    char type[256];  /**< The C type of the field, or of its values if it's an array. */
+    FieldKind kind;  /**< The kind of value the field holds. */
+    bool isArray;    /**< If the field is an array of values. */
+} Field;
+
+static char* readFile(char* filename);
+static void  toIdentifier(char* str, char* out, int size);
+static void  printLiteral(FILE* out, char* str);
+static bool  readField(JSONObject types, int declared, JSONPair pair, Field* field);
+static void  printStruct(FILE* out, char* name, Field* fields, int numberOfFields);
+static void  printDecoder(FILE* out, char* name, Field* fields, int numberOfFields);
+static void  printEncoder(FILE* out, char* name, Field* fields, int numberOfFields);
+static void  printDestructor(FILE* out, char* name, Field* fields, int numberOfFields);
+static void  printPublic(FILE* out, char* name);
+static void  printRuntime(FILE* out);
+
+int main(int argc, char** argv) {
+    if(argc != 2) {
+        printf("Usage: ./libjsongen schema.json\n");
+        return 1;
+    }
+
+    char* raw = readFile(argv[1]);
+    if(!raw) {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    JSONObject schema = o_parseJSONObject(raw);
+    free(raw);
+
+    JSONObject types = o_getJSONObject(schema, "types");
+    char guard[256] = {0};
+    toIdentifier(o_optString(schema, "name", "libjsongen"), guard, sizeof(guard));
+    for(int i=0; guard[i] != '\0'; i++) {
+        if(guard[i] >= 'a' && guard[i] <= 'z') {
+            guard[i] = guard[i] - 'a' + 'A';
+        }
+    }
+
+    FILE* out = stdout;
+    fprintf(out, "#ifndef __%s_H__\n#define __%s_H__\n\n", guard, guard);
+    fprintf(out, "/* Generated by libjsongen from %s. Do not edit. */\n\n", argv[1]);
+    fprintf(out, "#include \"libjson.h\"\n#include <errno.h>\n#include <string.h>\n\n");
+    printRuntime(out);
+
+    int status = 0;
+
+    for(int i=0; i<types.numberOfElements && status == 0; i++) {
+        char name[256] = {0};
+        JSONObject fields = e_getJSONObject(&types.elements[i].value);
+        Field* parsed = calloc(fields.numberOfElements+1, sizeof(Field));
+
+        toIdentifier(types.elements[i].key, name, sizeof(name));
+
+        for(int j=0; j<fields.numberOfElements; j++) {
+            if(!readField(types, i, fields.elements[j], &parsed[j])) {
+                fprintf(stderr, "Unknown type for %s.%s\n", types.elements[i].key, fields.elements[j].key);
+                status = 1;
+            }
+        }
+
+        if(status == 0) {
+            printStruct(out, name, parsed, fields.numberOfElements);
+            printDecoder(out, name, parsed, fields.numberOfElements);
+            printEncoder(out, name, parsed, fields.numberOfElements);
+            printDestructor(out, name, parsed, fields.numberOfElements);
+            printPublic(out, name);
+        }
+        free(parsed);
+    }
+
+    fprintf(out, "#endif//__%s_H__\n", guard);
+    o_destroyJSONObject(&schema);
+
+    return status;
+}
+
+/**
+ * Read the contents of a file into a string.
+ * @warning Return value should be freed when no longer needed.
+ *
+ * @param filename The file to read.
+ * @return The contents of the file, or NULL if it can't be opened.
+ */
+static char* readFile(char* filename) {
+    char* raw = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    FILE* fp = fopen(filename, "r");
+
+    if(!fp) {
+        return NULL;
+    }
+
+    while(true) {
+        if(length+1 >= capacity) {
+            capacity = capacity ? capacity*2 : 4096;
+            char* tmp = (char*)realloc(raw, capacity);
+            if(!tmp) {
+                free(raw);
+                fclose(fp);
+                return NULL;
+            }
+            raw = tmp;
+        }
+
+        size_t read = fread(raw+length, 1, capacity-length-1, fp);
+        if(read == 0) {
+            break;
+        }
+        length += read;
+    }
+    fclose(fp);
+
+    raw[length] = '\0';
+    return raw;
+}
+
+/**
+ * Convert a string into a C identifier, replacing any other character with _.
+ *
+ * @param str  The string to convert.
+ * @param out  Where to write the identifier.
+ * @param size How many characters @p out has space for.
+ */
+static void toIdentifier(char* str, char* out, int size) {
+    int len = 0;
+
+    if(libjson_isdigit(str[0])) {
+        out[len++] = '_';
+    }
+
+    for(int i=0; str[i] != '\0' && len < size-1; i++) {
+        char c = str[i];
+        bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || libjson_isdigit(c) || c == '_';
+        out[len++] = valid ? c : '_';
+    }
+    out[len] = '\0';
+}
+
+/**
+ * Print the contents of a string as the inside of a C string literal.
+ *
+ * @param out The file to print to.
+ * @param str The string to print.
+ */
+static void printLiteral(FILE* out, char* str) {
+    for(int i=0; str[i] != '\0'; i++) {
+        if(str[i] == '\"' || str[i] == '\\') {
+            fputc('\\', out);
+        }
+        fputc(str[i], out);
+    }
+}
+
+/**
+ * Read the type of a field from the schema.
+ *
+ * @param types    The types in the schema.
+ * @param declared How many types are declared before the one the field belongs to.
+ * @param pair     The key and type of the field in the schema.
+ * @param field    Where to store the field.
+ * @return If the field's type is known, true. Otherwise, false.
+ */
+static bool readField(JSONObject types, int declared, JSONPair pair, Field* field) {
+    char* type = e_getString(&pair.value);
+    if(!type) {
+        return false;
+    }
+
+    int len = libjson_strlen(type);
+    char base[256] = {0};
+
+    field->key = pair.key;
+    field->isArray = len > 2 && type[len-2] == '[' && type[len-1] == ']';
+    toIdentifier(pair.key, field->name, sizeof(field->name));
+
+    for(int i=0; i<len - 2*(int)field->isArray && i<255; i++) {
+        base[i] = type[i];
+    }
+
+    if(libjson_strcmp(base, "string")) {
+        field->kind = stringField;
+        strcpy(field->type, "char*");
+    } else if(libjson_strcmp(base, "int")) {
+        field->kind = intField;
+        strcpy(field->type, "long");
+    } else if(libjson_strcmp(base, "double")) {
+        field->kind = doubleField;
+        strcpy(field->type, "double");
+    } else if(libjson_strcmp(base, "bool")) {
+        field->kind = boolField;
+        strcpy(field->type, "bool");
+    } else {
+        bool known = false;
+        for(int i=0; i<declared; i++) {
+            known = known || libjson_strcmp(types.elements[i].key, base);
+        }
+        if(!known) {
+            return false;
+        }
+        field->kind = structField;
+        toIdentifier(base, field->type, sizeof(field->type));
+    }
+    return true;
+}
+
+/**
+ * Print the definition of a generated struct.
+ *
+ * @param out            The file to print to.
+ * @param name           The name of the struct.
+ * @param fields         The fields of the struct.
+ * @param numberOfFields How many fields the struct has.
+ */
+static void printStruct(FILE* out, char* name, Field* fields, int numberOfFields) {
+    fprintf(out, "typedef struct %s {\n", name);
+    for(int i=0; i<numberOfFields; i++) {
+        if(fields[i].isArray) {
+            fprintf(out, "    %s* %s;\n", fields[i].type, fields[i].name);
+            fprintf(out, "    int %sCount;\n", fields[i].name);
+        } else {
+            fprintf(out, "    %s %s;\n", fields[i].type, fields[i].name);
+        }
+    }
+    if(numberOfFields == 0) {
+        fprintf(out, "    char unused;\n");
+    }
+    fprintf(out, "} %s;\n\n", name);
+}
+
+/**
+ * Print the function which parses one value of a field.
+ *
+ * @param out   The file to print to.
+ * @param field The field to parse a value of.
+ * @param dest  The C expression the value is stored in.
+ */
+static void printFieldDecoder(FILE* out, Field* field, char* dest) {
+    switch(field->kind) {
+        case stringField:
+            fprintf(out, "libjsongen_decodeString(str, i, length, &%s);\n", dest);
+            break;
+        case intField:
+            fprintf(out, "libjsongen_decodeInt(str, i, length, &%s);\n", dest);
+            break;
+        case doubleField:
+            fprintf(out, "libjsongen_decodeDouble(str, i, length, &%s);\n", dest);
+            break;
+        case boolField:
+            fprintf(out, "libjsongen_decodeBool(str, i, length, &%s);\n", dest);
+            break;
+        case structField:
+            fprintf(out, "libjsongen_decode%s(str, i, length, &%s);\n", field->type, dest);
+            break;
+    }
+}
+
+/**
+ * Print the decoder of a generated struct.
+ * Keys are matched by a switch on their length, then compared whole.
+ *
+ * @param out            The file to print to.
+ * @param name           The name of the struct.
+ * @param fields         The fields of the struct.
+ * @param numberOfFields How many fields the struct has.
+ */
+static void printDecoder(FILE* out, char* name, Field* fields, int numberOfFields) {
+    fprintf(out, "static int libjsongen_decode%s(char* str, int i, int length, %s* out) {\n", name, name);
+    fprintf(out, "    if(str[i] == 'n') {\n        return libjson_skipValue(str, i, length);\n    }\n");
+    fprintf(out, "    if(str[i] != '{') {\n        return -1;\n    }\n");
+    fprintf(out, "    i = libjson_skipWhitespace(str, i+1);\n");
+    fprintf(out, "    if(str[i] == '}') {\n        return i+1;\n    }\n\n");
+    fprintf(out, "    while(str[i] == '\\\"') {\n");
+    fprintf(out, "        int key = i+1;\n");
+    fprintf(out, "        int field = -1;\n");
+    fprintf(out, "        i = libjson_skipString(str, i, length);\n");
+    fprintf(out, "        if(i < 0) {\n            return -1;\n        }\n\n");
+    fprintf(out, "        switch(i-key-1) {\n");
+
+    int* handled = calloc(numberOfFields+1, sizeof(int));
+    for(int i=0; i<numberOfFields; i++) {
+        if(handled[i]) {
+            continue;
+        }
+        int len = libjson_strlen(fields[i].key);
+        fprintf(out, "            case %d:\n", len);
+        for(int j=i; j<numberOfFields; j++) {
+            if(libjson_strlen(fields[j].key) == len) {
+                handled[j] = 1;
+                fprintf(out, "                %sif(!memcmp(str+key, \"", j == i ? "" : "else ");
+                printLiteral(out, fields[j].key);
+                fprintf(out, "\", %d)) {\n                    field = %d;\n                }\n", len, j);
+            }
+        }
+        fprintf(out, "                break;\n");
+    }
+    free(handled);
+
+    fprintf(out, "        }\n\n");
+    fprintf(out, "        i = libjson_skipWhitespace(str, i);\n");
+    fprintf(out, "        if(str[i] != ':') {\n            return -1;\n        }\n");
+    fprintf(out, "        i = libjson_skipWhitespace(str, i+1);\n\n");
+    fprintf(out, "        switch(field) {\n");
+
+    for(int i=0; i<numberOfFields; i++) {
+        Field* f = &fields[i];
+        fprintf(out, "            case %d:\n", i);
+
+        if(f->isArray) {
+            // Room for the field's name twice
+            char dest[2*sizeof(f->name)+32] = {0};
+            snprintf(dest, sizeof(dest), "out->%s[out->%sCount]", f->name, f->name);
+
+            fprintf(out, "                if(str[i] == 'n') {\n");
+            fprintf(out, "                    i = libjson_skipValue(str, i, length);\n");
+            fprintf(out, "                    break;\n");
+            fprintf(out, "                }\n");
+            fprintf(out, "                if(str[i] != '[') {\n                    return -1;\n                }\n");
+            fprintf(out, "                i = libjson_skipWhitespace(str, i+1);\n");
+            fprintf(out, "                while(str[i] != ']') {\n");
+            fprintf(out, "                    if((out->%sCount & (out->%sCount-1)) == 0) {\n", f->name, f->name);
+            fprintf(out, "                        %s* tmp = realloc(out->%s, sizeof(%s)*(out->%sCount ? out->%sCount*2 : 1));\n",
+                f->type, f->name, f->type, f->name, f->name);
+            fprintf(out, "                        if(!tmp) {\n                            return -1;\n                        }\n");
+            fprintf(out, "                        out->%s = tmp;\n", f->name);
+            fprintf(out, "                    }\n");
+            fprintf(out, "                    memset(&%s, 0, sizeof(%s));\n", dest, f->type);
+            fprintf(out, "                    i = ");
+            printFieldDecoder(out, f, dest);
+            fprintf(out, "                    if(i < 0) {\n                        return -1;\n                    }\n");
+            fprintf(out, "                    out->%sCount++;\n", f->name);
+            fprintf(out, "                    i = libjson_skipWhitespace(str, i);\n");
+            fprintf(out, "                    if(str[i] == ',') {\n");
+            fprintf(out, "                        i = libjson_skipWhitespace(str, i+1);\n");
+            fprintf(out, "                    } else if(str[i] != ']') {\n");
+            fprintf(out, "                        return -1;\n");
+            fprintf(out, "                    }\n");
+            fprintf(out, "                }\n");
+            fprintf(out, "                i++;\n");
+        } else {
+            char dest[300] = {0};
+            snprintf(dest, sizeof(dest), "out->%s", f->name);
+            fprintf(out, "                i = ");
+            printFieldDecoder(out, f, dest);
+        }
+        fprintf(out, "                break;\n");
+    }
+
+    fprintf(out, "            default:\n");
+    fprintf(out, "                i = libjson_skipValue(str, i, length);\n");
+    fprintf(out, "                break;\n");
+    fprintf(out, "        }\n\n");
+    fprintf(out, "        if(i < 0) {\n            return -1;\n        }\n");
+    fprintf(out, "        i = libjson_skipWhitespace(str, i);\n");
+    fprintf(out, "        if(str[i] == '}') {\n            return i+1;\n        }\n");
+    fprintf(out, "        if(str[i] != ',') {\n            return -1;\n        }\n");
+    fprintf(out, "        i = libjson_skipWhitespace(str, i+1);\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return -1;\n");
+    fprintf(out, "}\n\n");
+}
+
+/**
+ * Print the code which writes one value of a field.
+ *
+ * @param out    The file to print to.
+ * @param field  The field to write a value of.
+ * @param source The C expression holding the value.
+ * @param indent The indentation to print before the code.
+ */
+static void printFieldEncoder(FILE* out, Field* field, char* source, char* indent) {
+    switch(field->kind) {
+        case stringField:
+            fprintf(out, "%slibjsongen_encodeString(%s, out);\n", indent, source);
+            break;
+        case intField:
+            fprintf(out, "%slibjsongen_encodeInt(%s, out);\n", indent, source);
+            break;
+        case doubleField:
+            fprintf(out, "%slibjsongen_encodeDouble(%s, out);\n", indent, source);
+            break;
+        case boolField:
+            fprintf(out, "%slibjson_bufferAppend(out, %s ? \"true\" : \"false\", %s ? 4 : 5);\n", indent, source, source);
+            break;
+        case structField:
+            fprintf(out, "%slibjsongen_encode%s(&%s, out);\n", indent, field->type, source);
+            break;
+    }
+}
+
+/**
+ * Print the encoder of a generated struct.
+ *
+ * @param out            The file to print to.
+ * @param name           The name of the struct.
+ * @param fields         The fields of the struct.
+ * @param numberOfFields How many fields the struct has.
+ */
+static void printEncoder(FILE* out, char* name, Field* fields, int numberOfFields) {
+    fprintf(out, "static void libjsongen_encode%s(const %s* in, JSONBuffer* out) {\n", name, name);
+
+    for(int i=0; i<numberOfFields; i++) {
+        Field* f = &fields[i];
+        char source[300] = {0};
+
+        fprintf(out, "    libjson_bufferAppend(out, \"%s\\\"", i == 0 ? "{" : ",");
+        printLiteral(out, f->key);
+        fprintf(out, "\\\":\", %d);\n", libjson_strlen(f->key) + 4);
+
+        if(f->isArray) {
+            snprintf(source, sizeof(source), "in->%s[j]", f->name);
+            fprintf(out, "    libjson_bufferAppend(out, \"[\", 1);\n");
+            fprintf(out, "    for(int j=0; j<in->%sCount; j++) {\n", f->name);
+            fprintf(out, "        if(j > 0) {\n            libjson_bufferAppend(out, \",\", 1);\n        }\n");
+            printFieldEncoder(out, f, source, "        ");
+            fprintf(out, "    }\n");
+            fprintf(out, "    libjson_bufferAppend(out, \"]\", 1);\n");
+        } else {
+            snprintf(source, sizeof(source), "in->%s", f->name);
+            printFieldEncoder(out, f, source, "    ");
+        }
+    }
+
+    fprintf(out, "    libjson_bufferAppend(out, \"%s}\", %d);\n", numberOfFields == 0 ? "{" : "", numberOfFields == 0 ? 2 : 1);
+    fprintf(out, "}\n\n");
+}
+
+/**
+ * Print the destructor of a generated struct.
+ *
+ * @param out            The file to print to.
+ * @param name           The name of the struct.
+ * @param fields         The fields of the struct.
+ * @param numberOfFields How many fields the struct has.
+ */
+static void printDestructor(FILE* out, char* name, Field* fields, int numberOfFields) {
+    fprintf(out, "/**\n * Free all heap memory used by a %s.\n *\n * @param in The %s to deallocate.\n */\n", name, name);
+    fprintf(out, "void destroy%s(%s* in) {\n", name, name);
+
+    for(int i=0; i<numberOfFields; i++) {
+        Field* f = &fields[i];
+
+        if(f->isArray) {
+            if(f->kind == stringField || f->kind == structField) {
+                fprintf(out, "    for(int j=0; j<in->%sCount; j++) {\n", f->name);
+                if(f->kind == stringField) {
+                    fprintf(out, "        free(in->%s[j]);\n", f->name);
+                } else {
+                    fprintf(out, "        destroy%s(&in->%s[j]);\n", f->type, f->name);
+                }
+                fprintf(out, "    }\n");
+            }
+            fprintf(out, "    free(in->%s);\n", f->name);
+        } else if(f->kind == stringField) {
+            fprintf(out, "    free(in->%s);\n", f->name);
+        } else if(f->kind == structField) {
+            fprintf(out, "    destroy%s(&in->%s);\n", f->type, f->name);
+        }
+    }
+
+    fprintf(out, "    memset(in, 0, sizeof(%s));\n", name);
+    fprintf(out, "}\n\n");
+}
+
+/**
+ * Print the parser and to string functions of a generated struct.
+ *
+ * @param out  The file to print to.
+ * @param name The name of the struct.
+ */
+static void printPublic(FILE* out, char* name) {
+    fprintf(out, "/**\n * Parse a string straight into a %s, without building a JSONObject.\n", name);
+    fprintf(out, " * Keys which aren't part of %s are skipped.\n", name);
+    fprintf(out, " * @warning @p out should be freed with destroy%s when no longer needed, even if parsing fails.\n *\n", name);
+    fprintf(out, " * @param str The json to parse.\n * @param out Where to store the parsed values.\n");
+    fprintf(out, " * @return If @p str is a %s, true. Otherwise, false.\n */\n", name);
+    fprintf(out, "bool parse%s(char* str, %s* out) {\n", name, name);
+    fprintf(out, "    memset(out, 0, sizeof(%s));\n", name);
+    fprintf(out, "    int length = libjson_strlen(str);\n");
+    fprintf(out, "    int i = libjson_skipWhitespace(str, 0);\n");
+    fprintf(out, "    if(str[i] != '{') {\n        return false;\n    }\n");
+    fprintf(out, "    i = libjsongen_decode%s(str, i, length, out);\n", name);
+    fprintf(out, "    return i >= 0 && str[libjson_skipWhitespace(str, i)] == '\\0';\n");
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "/**\n * Convert a %s to a string.\n", name);
+    fprintf(out, " * @warning Return value should be freed when no longer needed.\n *\n");
+    fprintf(out, " * @param in The %s to convert to string.\n * @return A json representation of the %s.\n */\n", name, name);
+    fprintf(out, "char* %sToString(const %s* in) {\n", name, name);
+    fprintf(out, "    JSONBuffer out = {NULL, 0, 0};\n");
+    fprintf(out, "    libjsongen_encode%s(in, &out);\n", name);
+    fprintf(out, "    libjson_bufferAppend(&out, \"\", 1);\n");
+    fprintf(out, "    return out.data;\n");
+    fprintf(out, "}\n\n");
+}
+
+/**
+ * Print the functions shared by all generated code, which decode and encode
+ * the values of fields. They're inline, so those a schema doesn't use aren't warned about.
+ *
+ * @param out The file to print to.
+ */
+static void printRuntime(FILE* out) {
+    fprintf(out,
+        "#ifndef __LIBJSONGEN_RUNTIME__\n"
+        "#define __LIBJSONGEN_RUNTIME__\n"
+        "\n"
+        "static inline int libjsongen_decodeString(char* str, int i, int length, char** out) {\n"
+        "    if(str[i] == 'n') {\n"
+        "        return libjson_skipValue(str, i, length);\n"
+        "    }\n"
+        "    if(str[i] != '\\\"') {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    int end = libjson_skipString(str, i, length);\n"
+        "    if(end >= 0) {\n"
+        "        free(*out);\n"
+        "        *out = libjson_extractString(str+i, end-i);\n"
+        "    }\n"
+        "    return end;\n"
+        "}\n"
+        "\n"
+        "static inline int libjsongen_decodeInt(char* str, int i, int length, long* out) {\n"
+        "    if(str[i] == 'n') {\n"
+        "        return libjson_skipValue(str, i, length);\n"
+        "    }\n"
+        "    if(str[i] != '-' && !libjson_isdigit(str[i])) {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    char* digits = NULL;\n"
+        "    errno = 0;\n"
+        "    long value = strtol(str+i, &digits, 10);\n"
+        "    int end = libjson_skipValue(str, i, length);\n"
+        "    if(digits != str+end || errno == ERANGE) {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    *out = value;\n"
+        "    return end;\n"
+        "}\n"
+        "\n"
+        "static inline int libjsongen_decodeDouble(char* str, int i, int length, double* out) {\n"
+        "    if(str[i] != 'n' && str[i] != '-' && !libjson_isdigit(str[i])) {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    *out = strtod(str+i, NULL);\n"
+        "    return libjson_skipValue(str, i, length);\n"
+        "}\n"
+        "\n"
+        "static inline int libjsongen_decodeBool(char* str, int i, int length, bool* out) {\n"
+        "    if(str[i] != 'n' && str[i] != 't' && str[i] != 'f') {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    *out = str[i] == 't';\n"
+        "    return libjson_skipValue(str, i, length);\n"
+        "}\n"
+        "\n"
+        "static inline void libjsongen_encodeString(const char* in, JSONBuffer* out) {\n"
+        "    if(in) {\n"
+        "        libjson_bufferAppendString(out, in);\n"
+        "    } else {\n"
+        "        libjson_bufferAppend(out, \"null\", 4);\n"
+        "    }\n"
+        "}\n"
+        "\n"
+        "static inline void libjsongen_encodeInt(long in, JSONBuffer* out) {\n"
+        "    char tmp[32] = {0};\n"
+        "    libjson_bufferAppend(out, tmp, snprintf(tmp, sizeof(tmp), \"%%ld\", in));\n"
+        "}\n"
+        "\n"
+        "static inline void libjsongen_encodeDouble(double in, JSONBuffer* out) {\n"
+        "    if(in != in || in - in != 0) {\n"
+        "        libjson_bufferAppend(out, \"null\", 4);\n"
+        "        return;\n"
+        "    }\n"
+        "    char tmp[32] = {0};\n"
+        "    int len = snprintf(tmp, sizeof(tmp), \"%%.15g\", in);\n"
+        "    if(strtod(tmp, NULL) != in) {\n"
+        "        len = snprintf(tmp, sizeof(tmp), \"%%.17g\", in);\n"
+        "    }\n"
+        "    libjson_bufferAppend(out, tmp, len);\n"
+        "}\n"
+        "\n"
+        "#endif//__LIBJSONGEN_RUNTIME__\n"
+        "\n");
+}
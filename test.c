@@ -1,15 +1,914 @@
 #include "libjson.h"
 #include <string.h>
 
+#define DEEP_LEVELS 1000000
+
+/**
+ * Read the rest of a file into a string.
+ * @warning Return value should be freed when no longer needed.
+ *
+ * @param fp The file to read.
+ * @return The contents of the file, or NULL if there isn't enough memory.
+ */
+static char* readFile(FILE* fp) {
+    char* raw = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+
+    while(true) {
+        if(length+1 >= capacity) {
+            capacity = capacity ? capacity*2 : 4096;
+            char* tmp = (char*)realloc(raw, capacity);
+            if(!tmp) {
+                free(raw);
+                return NULL;
+            }
+            raw = tmp;
+        }
+
+        size_t read = fread(raw+length, 1, capacity-length-1, fp);
+        if(read == 0) {
+            break;
+        }
+        length += read;
+    }
+    raw[length] = '\0';
+
+    return raw;
+}
+
+/**
+ * Write json nested some number of levels deep into a string.
+ *
+ * @param str    Where to write the json. Must have space for 8 characters per level, plus the value.
+ * @param open   What to write before the value at each level.
+ * @param value  What to write at the innermost level.
+ * @param close  What to write after the value at each level.
+ * @param levels How deep to nest it.
+ * @return How many characters were written.
+ */
+static int nest(char* str, const char* open, const char* value, const char* close, int levels) {
+    int length = 0;
+
+    for(int i=0; i<levels; i++) {
+        strcpy(str+length, open);
+        length += strlen(open);
+    }
+    strcpy(str+length, value);
+    length += strlen(value);
+    for(int i=0; i<levels; i++) {
+        strcpy(str+length, close);
+        length += strlen(close);
+    }
+    return length;
+}
+
+/**
+ * Parse, serialize, copy, compare, patch and free json nested DEEP_LEVELS deep,
+ * then check that the parser stops at maxDepth, and that empty json ends too soon.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int testDeep(void) {
+    char* doc = (char*)malloc(8*DEEP_LEVELS+64);
+    char* patch = (char*)malloc(8*DEEP_LEVELS+128);
+    JSONParser parser = p_emptyJSONParser();
+    int status = 0;
+
+    int length = sprintf(doc, "{\"a\":");
+    length += nest(doc+length, "[", "", "]", DEEP_LEVELS);
+    strcpy(doc+length, "}");
+
+    // Serializing a parsed document gives it back unchanged
+    parser.maxDepth = DEEP_LEVELS+1;
+    JSONObject json = p_parseJSONObject(&parser, doc);
+    char* string = o_JSONObjectToString(json);
+    bool ok = parser.error.kind == errorNone && strcmp(string, doc) == 0;
+    printf("parse and serialize: %s\n", ok ? "ok" : "failed");
+    status |= !ok;
+    free(string);
+
+    // Copying a value and testing it compares the whole copy
+    length = sprintf(patch, "[{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/b\"},{\"op\":\"test\",\"path\":\"/b\",\"value\":");
+    length += nest(patch+length, "[", "", "]", DEEP_LEVELS);
+    strcpy(patch+length, "}]");
+
+    parser.maxDepth = DEEP_LEVELS+2;
+    JSONArray operations = p_parseJSONArray(&parser, patch);
+    ok = parser.error.kind == errorNone && o_applyPatch(&json, operations);
+    printf("copy and test: %s\n", ok ? "ok" : "failed");
+    status |= !ok;
+    a_destroyJSONArray(&operations);
+
+    // Merging descends through every level of the patch
+    nest(patch, "{\"c\":", "1", "}", DEEP_LEVELS);
+
+    JSONObject merge = p_parseJSONObject(&parser, patch);
+    o_mergePatch(&json, merge);
+    ok = parser.error.kind == errorNone && o_has(json, "c");
+    printf("merge patch: %s\n", ok ? "ok" : "failed");
+    status |= !ok;
+    o_destroyJSONObject(&merge);
+    o_destroyJSONObject(&json);
+
+    // Nesting deeper than maxDepth stops at the first container too many
+    parser.maxDepth = DEEP_LEVELS;
+    json = p_parseJSONObject(&parser, doc);
+    ok = parser.error.kind == errorTooDeep && parser.error.offset == 5+DEEP_LEVELS-1 && json.numberOfElements == 0;
+    printf("max depth: %s\n", v_errorMessage(parser.error.kind));
+    status |= !ok;
+
+    json = p_parseJSONObject(&parser, " \n");
+    ok = parser.error.kind == errorUnexpectedEnd;
+    printf("empty: %s\n", v_errorMessage(parser.error.kind));
+    status |= !ok;
+
+    p_destroyJSONParser(&parser);
+    free(patch);
+    free(doc);
+
+    return status;
+}
+
+/**
+ * Write the JSON Pointer (RFC 6901) to a key of the outermost object.
+ *
+ * @param key     The key to point to.
+ * @param pointer Where to write the pointer. Must have space for twice the key's length, plus 2.
+ */
+static void pointerTo(const char* key, char* pointer) {
+    int length = 0;
+
+    pointer[length++] = '/';
+    for(int i=0; key[i] != '\0'; i++) {
+        if(key[i] == '~' || key[i] == '/') {
+            pointer[length++] = '~';
+            pointer[length++] = key[i] == '~' ? '0' : '1';
+        } else {
+            pointer[length++] = key[i];
+        }
+    }
+    pointer[length] = '\0';
+}
+
+/**
+ * Patch a document without changing it. Each of its values is tested against the same value
+ * parsed again, copied to a new key and removed from there, then an empty merge patch is applied.
+ *
+ * @param json The document to patch.
+ * @param raw  The json the document was parsed from.
+ * @return If every operation succeeded, true. Otherwise, false.
+ */
+static bool patchUnchanged(JSONObject* json, char* raw) {
+    JSONObject twin = o_parseJSONObject(raw);
+    JSONArray operations = a_emptyJSONArray();
+    JSONObjectIterator iterator = o_iterate(json);
+
+    while(o_next(&iterator)) {
+        char* pointer = (char*)malloc(2*strlen(iterator.key)+2);
+        pointerTo(iterator.key, pointer);
+
+        JSONObject test = o_emptyJSONObject();
+        o_setString(&test, "op", "test");
+        o_setString(&test, "path", pointer);
+        o_splice(&test, "value", &twin, iterator.key);
+        a_setJSONObject(&operations, operations.numberOfElements, test);
+
+        JSONObject copy = o_emptyJSONObject();
+        o_setString(&copy, "op", "copy");
+        o_setString(&copy, "from", pointer);
+        o_setString(&copy, "path", "/libjson~1copy");
+        a_setJSONObject(&operations, operations.numberOfElements, copy);
+
+        JSONObject remove = o_emptyJSONObject();
+        o_setString(&remove, "op", "remove");
+        o_setString(&remove, "path", "/libjson~1copy");
+        a_setJSONObject(&operations, operations.numberOfElements, remove);
+
+        free(pointer);
+    }
+
+    bool ok = o_applyPatch(json, operations);
+    o_mergePatch(json, o_emptyJSONObject());
+
+    a_destroyJSONArray(&operations);
+    o_destroyJSONObject(&twin);
+
+    return ok;
+}
+
+/**
+ * Follow o_ref and a_ref through the first value of each value of a document, down to the
+ * innermost object or array, then add a value to it, or remove the value added before.
+ *
+ * @param json   The document to change.
+ * @param revert If the value added before is removed.
+ */
+static void changeNested(JSONObject* json, bool revert) {
+    JSONObjectIterator iterator = o_iterate(json);
+
+    while(o_next(&iterator)) {
+        JSONElement* value = o_ref(json, iterator.key);
+
+        while(true) {
+            JSONObjectIterator inner = o_iterate(&value->object);
+            JSONElement* first = NULL;
+            if(value->type == object && o_next(&inner)) {
+                first = o_ref(&value->object, inner.key);
+            } else if(value->type == array && value->array.numberOfElements > 0) {
+                first = a_ref(&value->array, 0);
+            }
+
+            if(!first || (first->type != object && first->type != array)) {
+                break;
+            }
+            value = first;
+        }
+
+        if(value->type == object && revert) {
+            o_remove(&value->object, "libjson");
+        } else if(value->type == object) {
+            o_setString(&value->object, "libjson", "changed");
+        } else if(value->type == array && revert) {
+            a_remove(&value->array, value->array.numberOfElements-1);
+        } else if(value->type == array) {
+            a_setString(&value->array, value->array.numberOfElements, "changed");
+        }
+    }
+}
+
+/**
+ * Convert a document to string with the same cache before and after changing a value
+ * nested within each of its values, and again after changing them back.
+ * @warning Return value should be freed when no longer needed.
+ *
+ * @param json The document to convert.
+ * @return The last conversion, or NULL if a conversion differs from o_JSONObjectToString.
+ */
+static char* cachedTwice(JSONObject* json) {
+    JSONCache cache = c_emptyJSONCache();
+    char* first = o_JSONObjectToCachedString(json, &cache);
+
+    changeNested(json, false);
+    char* changed = o_JSONObjectToCachedString(json, &cache);
+    char* expected = o_JSONObjectToString(*json);
+    bool ok = strcmp(changed, expected) == 0;
+
+    changeNested(json, true);
+    char* second = o_JSONObjectToCachedString(json, &cache);
+    if(!ok || strcmp(first, second) != 0) {
+        free(second);
+        second = NULL;
+    }
+    free(expected);
+    free(changed);
+    free(first);
+    c_destroyJSONCache(&cache);
+
+    return second;
+}
+
+/**
+ * Replace each array of records within a value with the same records converted
+ * to a table and back.
+ *
+ * @param element The value to search for arrays of records.
+ */
+static void roundTripTables(JSONElement* element) {
+    if(element->type == object) {
+        JSONObjectIterator iterator = o_iterate(&element->object);
+        while(o_next(&iterator)) {
+            roundTripTables(o_ref(&element->object, iterator.key));
+        }
+        return;
+    }
+
+    if(element->type != array) {
+        return;
+    }
+
+    JSONArrayIterator iterator = a_iterate(&element->array);
+    bool records = element->array.numberOfElements > 0;
+    while(a_next(&iterator)) {
+        records = records && iterator.value->type == object;
+    }
+
+    if(!records) {
+        for(int i=0; i<element->array.numberOfElements; i++) {
+            roundTripTables(a_ref(&element->array, i));
+        }
+        return;
+    }
+
+    JSONTable table = t_fromJSONArray(element->array);
+    char* string = t_JSONTableToString(&table);
+
+    a_destroyJSONArray(&element->array);
+    element->array = a_parseJSONArray(string);
+
+    free(string);
+    t_destroyJSONTable(&table);
+}
+
+/**
+ * Move the last value of a json object out and back in again. Setting a value puts
+ * its key last, so the object is left as it was.
+ *
+ * @param json The object to move a value within.
+ */
+static void spliceLast(JSONObject* json) {
+    JSONObjectIterator iterator = o_iterate(json);
+    const char* last = NULL;
+
+    while(o_next(&iterator)) {
+        last = iterator.key;
+    }
+    if(!last) {
+        return;
+    }
+
+    // The key is freed when its value is moved out
+    char* key = (char*)malloc(strlen(last)+1);
+    strcpy(key, last);
+    o_splice(json, key, json, key);
+    free(key);
+}
+
+/**
+ * Compact a document, move a value within it and within each of its objects and arrays
+ * out and back in place, so they're moved back out of the compacted block, then compact it again.
+ *
+ * @param json The document to compact.
+ * @return If both compactions succeeded, true. Otherwise, false.
+ */
+static bool compactTwice(JSONObject* json) {
+    bool ok = o_compact(json);
+    JSONObjectIterator iterator = o_iterate(json);
+
+    while(ok && o_next(&iterator)) {
+        JSONElement* value = o_ref(json, iterator.key);
+
+        if(value->type == object) {
+            spliceLast(&value->object);
+        } else if(value->type == array && value->array.numberOfElements > 0) {
+            a_splice(&value->array, 0, &value->array, 0);
+            a_remove(&value->array, 1);
+        }
+    }
+    spliceLast(json);
+
+    return ok && o_compact(json);
+}
+
+/**
+ * Try to set, remove and take values in a document built in a parser's arena, and in its
+ * first value, which are read only, so they must be left as they were.
+ *
+ * @param json The document to modify.
+ * @return If the document still serializes as it did, true. Otherwise, false.
+ */
+static bool modifyReused(JSONObject* json) {
+    char* before = o_JSONObjectToString(*json);
+    JSONObjectIterator iterator = o_iterate(json);
+
+    if(o_next(&iterator)) {
+        JSONElement value = *iterator.value;
+        if(value.type == object) {
+            o_setInt(&value.object, "libjson", 1);
+        } else if(value.type == array) {
+            a_setInt(&value.array, 0, 1);
+            a_remove(&value.array, 0);
+        }
+
+        JSONElement taken = o_take(json, iterator.key);
+        e_destroyJSONElement(&taken);
+        o_remove(json, iterator.key);
+    }
+    o_setString(json, "libjson", "a string too long to be held within the value");
+
+    char* after = o_JSONObjectToString(*json);
+    bool ok = strcmp(before, after) == 0;
+    free(before);
+    free(after);
+
+    return ok;
+}
+
+/**
+ * Output of a writer, gathered from however many chunks it's passed on in.
+ */
+typedef struct Chunks {
+    char* data;  /**< The output so far, null terminated. */
+    int length;  /**< How many characters there are. */
+    int count;   /**< How many chunks there were. */
+} Chunks;
+
+/**
+ * Append a chunk of a writer's output to some Chunks.
+ *
+ * @param data    The characters written.
+ * @param length  How many characters there are.
+ * @param context The Chunks to append to.
+ */
+static void appendChunk(const char* data, int length, void* context) {
+    Chunks* chunks = (Chunks*)context;
+
+    chunks->data = (char*)realloc(chunks->data, chunks->length+length+1);
+    memcpy(chunks->data+chunks->length, data, length);
+    chunks->length += length;
+    chunks->data[chunks->length] = '\0';
+    chunks->count++;
+}
+
+/**
+ * Write a value with a writer, one call per key and value, flushing after each value.
+ *
+ * @param writer  The writer to write with.
+ * @param element The value to write.
+ */
+static void writeElement(JSONWriter* writer, const JSONElement* element) {
+    if(element->type == object) {
+        JSONObjectIterator iterator = o_iterate(&element->object);
+        w_beginJSONObject(writer);
+        while(o_next(&iterator)) {
+            w_key(writer, iterator.key);
+            writeElement(writer, iterator.value);
+        }
+        w_endJSONObject(writer);
+    } else if(element->type == array) {
+        JSONArrayIterator iterator = a_iterate(&element->array);
+        w_beginJSONArray(writer);
+        while(a_next(&iterator)) {
+            writeElement(writer, iterator.value);
+        }
+        w_endJSONArray(writer);
+    } else if(element->type == number && e_isInt(element)) {
+        w_int(writer, e_getInt(element));
+    } else if(element->type == number) {
+        w_double(writer, e_getDouble(element));
+    } else if(element->type == string) {
+        w_string(writer, e_getString(element));
+    } else if(element->type == boolean) {
+        w_boolean(writer, element->boolean);
+    } else {
+        w_null(writer);
+    }
+    w_flush(writer);
+}
+
+/**
+ * Write a document with a writer into memory, and again into a function in small chunks.
+ * @warning Return value should be freed when no longer needed.
+ *
+ * @param json The document to write.
+ * @return What was written, or NULL if either output differs from o_JSONObjectToString.
+ */
+static char* writtenTwice(JSONObject* json) {
+    JSONElement root = {.type = object, .flags = 0, .object = *json};
+    char* expected = o_JSONObjectToString(*json);
+
+    JSONWriter buffer = w_bufferJSONWriter();
+    writeElement(&buffer, &root);
+    char* written = w_JSONWriterToString(&buffer);
+    w_destroyJSONWriter(&buffer);
+
+    Chunks chunks = {NULL, 0, 0};
+    JSONWriter function = w_functionJSONWriter(appendChunk, &chunks);
+    writeElement(&function, &root);
+    w_destroyJSONWriter(&function);
+
+    // Every value is passed on as soon as it's written
+    if(strcmp(written, expected) != 0 || !chunks.data || strcmp(chunks.data, expected) != 0 || chunks.count < 2) {
+        free(written);
+        written = NULL;
+    }
+    free(chunks.data);
+    free(expected);
+
+    return written;
+}
+
+/**
+ * Format json with a formatter, whole and then a character at a time, and compare both with what's expected.
+ *
+ * @param json     The json to format.
+ * @param indent   How many spaces to indent each level by, or 0 to minify.
+ * @param expected What formatting should produce.
+ * @return 0 if both matched, 1 otherwise.
+ */
+static int checkFormat(const char* json, int indent, const char* expected) {
+    int status = 0;
+
+    for(int chunk = (int)strlen(json); chunk > 0; chunk = chunk == 1 ? 0 : 1) {
+        JSONWriter writer = w_bufferJSONWriter();
+        JSONFormatter formatter = f_emptyJSONFormatter(&writer, indent);
+
+        for(int i=0; json[i] != '\0'; i += chunk) {
+            f_format(&formatter, json+i, chunk);
+        }
+
+        char* formatted = w_JSONWriterToString(&writer);
+        if(strcmp(formatted, expected) != 0) {
+            printf("Formatted %s in chunks of %d as\n%s\n", json, chunk, formatted);
+            status = 1;
+        }
+        free(formatted);
+        w_destroyJSONWriter(&writer);
+    }
+    return status;
+}
+
+/**
+ * Pretty print and minify json with empty objects and arrays, nested arrays,
+ * and strings holding whitespace and structural characters.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int testFormat(void) {
+    const char* json = " {\"a\" : [1, [2, [ ]], {}],\n\t\"b\":{ \"c\":\"x, {y}: [z] \\\" \"} , \"d\":[[],[[true]]]}\r\n";
+    int status = 0;
+
+    status |= checkFormat(json, 0, "{\"a\":[1,[2,[]],{}],\"b\":{\"c\":\"x, {y}: [z] \\\" \"},\"d\":[[],[[true]]]}");
+    status |= checkFormat(json, 2,
+        "{\n"
+        "  \"a\": [\n"
+        "    1,\n"
+        "    [\n"
+        "      2,\n"
+        "      []\n"
+        "    ],\n"
+        "    {}\n"
+        "  ],\n"
+        "  \"b\": {\n"
+        "    \"c\": \"x, {y}: [z] \\\" \"\n"
+        "  },\n"
+        "  \"d\": [\n"
+        "    [],\n"
+        "    [\n"
+        "      [\n"
+        "        true\n"
+        "      ]\n"
+        "    ]\n"
+        "  ]\n"
+        "}");
+    status |= checkFormat("[]", 4, "[]");
+    status |= checkFormat("{ }", 4, "{}");
+    status |= checkFormat("[[{}]]", 4, "[\n    [\n        {}\n    ]\n]");
+
+    return status;
+}
+
+/**
+ * Parse only some values of json, and compare what was kept, or the error, with what's expected.
+ *
+ * @param json     The json to parse.
+ * @param maxDepth How deep objects and arrays may be nested.
+ * @param path     The key or JSON Pointer of the value to keep.
+ * @param expected What should be kept.
+ * @param kind     The error parsing should stop with, or errorNone.
+ * @return 0 if both matched, 1 otherwise.
+ */
+static int checkProject(char* json, int maxDepth, char* path, const char* expected, JSONErrorKind kind) {
+    JSONParser parser = p_emptyJSONParser();
+    parser.maxDepth = maxDepth;
+
+    JSONObject projected = p_parseJSONObjectFields(&parser, json, &path, 1);
+    char* string = o_JSONObjectToString(projected);
+    int status = strcmp(string, expected) != 0 || parser.error.kind != kind;
+    if(status) {
+        printf("Projected %s to %s, %s\n", path, string, v_errorMessage(parser.error.kind));
+    }
+
+    free(string);
+    o_destroyJSONObject(&projected);
+    p_destroyJSONParser(&parser);
+
+    return status;
+}
+
+/**
+ * Parse only the values at nested paths, missing paths, paths through arrays and their indexes,
+ * and paths deeper than the parser allows.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int testProject(void) {
+    char* json = "{\"a\":{\"b\":{\"c\":1,\"d\":[2]},\"e\":3},\"list\":[{\"x\":1,\"y\":2},{\"x\":3},4],"
+                 "\"grid\":[[1,2],[3,4]],\"k/~\":5}";
+    int status = 0;
+
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/a/b/c", "{\"a\":{\"b\":{\"c\":1}}}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/a/b", "{\"a\":{\"b\":{\"c\":1,\"d\":[2]}}}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/k~1~0", "{\"k/~\":5}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/a/missing", "{\"a\":{}}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "missing", "{}", errorNone);
+
+    // The rest of a path applies to each value of an array, or to the value at an index
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/list/x", "{\"list\":[{\"x\":1},{\"x\":3}]}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/list/1/x", "{\"list\":[{\"x\":3}]}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/list/2", "{\"list\":[4]}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/grid/1/0", "{\"grid\":[[3]]}", errorNone);
+    status |= checkProject(json, LIBJSON_MAX_DEPTH, "/list/9", "{\"list\":[]}", errorNone);
+
+    // Containers along a path and values kept whole both count towards the depth limit
+    status |= checkProject(json, 3, "/a/b/c", "{\"a\":{\"b\":{\"c\":1}}}", errorNone);
+    status |= checkProject(json, 2, "/a/b/c", "{}", errorTooDeep);
+    status |= checkProject(json, 3, "/a", "{}", errorTooDeep);
+    status |= checkProject(json, 4, "/a", "{\"a\":{\"b\":{\"c\":1,\"d\":[2]},\"e\":3}}", errorNone);
+
+    return status;
+}
+
+/**
+ * Parse a string value with escapes, check what it decodes to, then write it out,
+ * check how it's escaped, and parse it back again.
+ *
+ * @param value   The string as written in json, without quotes.
+ * @param decoded What the string should decode to.
+ * @param plain   How the string should be written, without quotes.
+ * @param unicode How it should be written with LIBJSON_ESCAPE_UNICODE.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int checkEscape(const char* value, const char* decoded, const char* plain, const char* unicode) {
+#ifdef LIBJSON_ESCAPE_UNICODE
+    const char* escaped = unicode;
+#else
+    const char* escaped = plain;
+#endif
+    char* json = (char*)malloc(strlen(value)+9);
+    char* expected = (char*)malloc(strlen(escaped)+9);
+    sprintf(json, "{\"s\":\"%s\"}", value);
+    sprintf(expected, "{\"s\":\"%s\"}", escaped);
+
+    JSONObject parsed = o_parseJSONObject(json);
+    char* string = o_JSONObjectToString(parsed);
+    JSONObject reparsed = o_parseJSONObject(string);
+
+    int status = !o_isString(parsed, "s") || strcmp(o_getString(parsed, "s"), decoded) != 0
+              || strcmp(string, expected) != 0
+              || !o_isString(reparsed, "s") || strcmp(o_getString(reparsed, "s"), decoded) != 0;
+    if(status) {
+        printf("Escaped %s as %s\n", json, string);
+    }
+
+    o_destroyJSONObject(&reparsed);
+    free(string);
+    o_destroyJSONObject(&parsed);
+    free(expected);
+    free(json);
+
+    return status;
+}
+
+/**
+ * Round trip strings with escaped quotes, backslashes and control characters, \u escapes,
+ * surrogate pairs and UTF-8, both shorter and longer than a vector.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int testEscape(void) {
+    int status = 0;
+
+    status |= checkEscape("q\\\"b\\\\s\\/", "q\"b\\s/", "q\\\"b\\\\s/", "q\\\"b\\\\s/");
+    status |= checkEscape("\\b\\f\\n\\r\\t\\u0001\\u001F", "\b\f\n\r\t\x01\x1f", "\\b\\f\\n\\r\\t\\u0001\\u001f", "\\b\\f\\n\\r\\t\\u0001\\u001f");
+    status |= checkEscape("\\u00e9\\u20AC", "\xc3\xa9\xe2\x82\xac", "\xc3\xa9\xe2\x82\xac", "\\u00e9\\u20ac");
+    status |= checkEscape("\\ud83d\\ude00", "\xf0\x9f\x98\x80", "\xf0\x9f\x98\x80", "\\ud83d\\ude00");
+    status |= checkEscape("\xc3\xa9", "\xc3\xa9", "\xc3\xa9", "\\u00e9");
+    status |= checkEscape("a long string to scan a vector at a time, \\\"quoted\\\"\\t\\u00e9 and \\ud83d\\ude00 then more after it",
+                          "a long string to scan a vector at a time, \"quoted\"\t\xc3\xa9 and \xf0\x9f\x98\x80 then more after it",
+                          "a long string to scan a vector at a time, \\\"quoted\\\"\\t\xc3\xa9 and \xf0\x9f\x98\x80 then more after it",
+                          "a long string to scan a vector at a time, \\\"quoted\\\"\\t\\u00e9 and \\ud83d\\ude00 then more after it");
+
+    return status;
+}
+
+/**
+ * A container's values as o_forEach or a_forEach visit them.
+ */
+typedef struct Visits {
+    const void* json; /**< The object or array visited. */
+    int count;        /**< How many values have been visited. */
+    int stop;         /**< How many values to visit before stopping, or -1 to visit them all. */
+    bool typed;       /**< If only numbers are visited, so values are skipped. */
+    bool ok;          /**< If every value was visited in order, matching its getter. */
+} Visits;
+
+/**
+ * Check that a pair of an object is the one expected at a position. Keys are k0, k1, k2, ...
+ *
+ * @param json     The object the pair belongs to.
+ * @param position How many pairs came before it.
+ * @param key      The pair's key.
+ * @param value    The pair's value.
+ * @return If the key is in order and o_cref finds the same value, true. Otherwise, false.
+ */
+static bool pairInOrder(const JSONObject* json, int position, const char* key, const JSONElement* value) {
+    char expected[16];
+    sprintf(expected, "k%d", position);
+    return strcmp(key, expected) == 0 && o_cref(json, key) == value;
+}
+
+/**
+ * Check that a value of an array is the one a_cref finds at its index.
+ * Values of a packed array are decoded, so only their contents can be compared.
+ *
+ * @param json  The array the value belongs to.
+ * @param index The value's index.
+ * @param value The value.
+ * @return If the values match, true. Otherwise, false.
+ */
+static bool valueAtIndex(const JSONArray* json, int index, const JSONElement* value) {
+    JSONElement scratch;
+    const JSONElement* expected = a_cref(json, index, &scratch);
+
+    if(!expected || expected->type != value->type) {
+        return false;
+    }
+    if(json->flags & LIBJSON_PACKED) {
+        return e_isInt(expected) == e_isInt(value) && e_getDouble(expected) == e_getDouble(value);
+    }
+    return expected == value;
+}
+
+/**
+ * Check a pair visited by o_forEach or o_forEachOfType against the object's getters.
+ *
+ * @param key     The pair's key.
+ * @param value   The pair's value.
+ * @param context The Visits so far.
+ * @return False once @c stop pairs have been visited, to stop. Otherwise, true.
+ */
+static bool visitPair(const char* key, const JSONElement* value, void* context) {
+    Visits* visits = (Visits*)context;
+    const JSONObject* json = (const JSONObject*)visits->json;
+
+    visits->ok = visits->ok && (visits->typed ? o_cref(json, key) == value && value->type == number : pairInOrder(json, visits->count, key, value));
+    visits->count++;
+    return visits->count != visits->stop;
+}
+
+/**
+ * Check a value visited by a_forEach or a_forEachOfType against the array's getters.
+ *
+ * @param index   The value's index.
+ * @param value   The value.
+ * @param context The Visits so far.
+ * @return False once @c stop values have been visited, to stop. Otherwise, true.
+ */
+static bool visitValue(int index, const JSONElement* value, void* context) {
+    Visits* visits = (Visits*)context;
+    const JSONArray* json = (const JSONArray*)visits->json;
+
+    visits->ok = visits->ok && valueAtIndex(json, index, value) && (visits->typed ? value->type == number : index == visits->count);
+    visits->count++;
+    return visits->count != visits->stop;
+}
+
+/**
+ * Visit an object with o_next, o_forEach, o_forEachOfType and a stopped o_forEach,
+ * and check the order and number of pairs against o_cref.
+ *
+ * @param json  The object to visit. Its keys must be k0, k1, k2, ...
+ * @param name  What to call the object if a check fails.
+ * @param flags Flags the object must have.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int checkObjectIteration(const JSONObject* json, const char* name, unsigned flags) {
+    JSONObjectIterator iterator = o_iterate(json);
+    int count = 0;
+    int numbers = 0;
+    bool ok = (json->flags & flags) == flags && json->numberOfElements > 1;
+
+    while(o_next(&iterator)) {
+        ok = ok && pairInOrder(json, count, iterator.key, iterator.value);
+        numbers += iterator.value->type == number;
+        count++;
+    }
+
+    Visits all = {json, 0, -1, false, true};
+    Visits typed = {json, 0, -1, true, true};
+    Visits stopped = {json, 0, 2, false, true};
+    ok = ok && count == json->numberOfElements && !o_next(&iterator);
+    ok = ok && o_forEach(json, visitPair, &all) && all.ok && all.count == count;
+    ok = ok && o_forEachOfType(json, number, visitPair, &typed) && typed.ok && typed.count == numbers;
+    ok = ok && !o_forEach(json, visitPair, &stopped) && stopped.ok && stopped.count == 2;
+
+    if(!ok) {
+        printf("Iterated the %s wrongly\n", name);
+    }
+    return !ok;
+}
+
+/**
+ * Visit an array with a_next, a_forEach, a_forEachOfType and a stopped a_forEach,
+ * and check the order and number of values against a_cref.
+ *
+ * @param json  The array to visit.
+ * @param name  What to call the array if a check fails.
+ * @param flags Flags the array must have.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int checkArrayIteration(const JSONArray* json, const char* name, unsigned flags) {
+    JSONArrayIterator iterator = a_iterate(json);
+    int count = 0;
+    int numbers = 0;
+    bool ok = (json->flags & flags) == flags && json->numberOfElements > 1;
+
+    while(a_next(&iterator)) {
+        ok = ok && iterator.index == count && valueAtIndex(json, count, iterator.value);
+        numbers += iterator.value->type == number;
+        count++;
+    }
+
+    Visits all = {json, 0, -1, false, true};
+    Visits typed = {json, 0, -1, true, true};
+    Visits stopped = {json, 0, 2, false, true};
+    ok = ok && count == json->numberOfElements && !a_next(&iterator);
+    ok = ok && a_forEach(json, visitValue, &all) && all.ok && all.count == count;
+    ok = ok && a_forEachOfType(json, number, visitValue, &typed) && typed.ok && typed.count == numbers;
+    ok = ok && !a_forEach(json, visitValue, &stopped) && stopped.ok && stopped.count == 2;
+
+    if(!ok) {
+        printf("Iterated the %s wrongly\n", name);
+    }
+    return !ok;
+}
+
+/**
+ * Iterate a plain object and array, a packed array, shaped objects and a compacted object.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int testIterate(void) {
+    char* plain = "{\"k0\":0,\"k1\":\"one\",\"k2\":[2,\"three\",{},4.5],\"k3\":{\"v\":4},\"k4\":null,\"k5\":5.5}";
+    char* packed = "{\"k0\":[0,1.5,-2,3e2,4]}";
+    char* shaped = "{\"k0\":[{\"k0\":0,\"k1\":\"a\",\"k2\":true},{\"k0\":1,\"k1\":\"b\",\"k2\":false}]}";
+    JSONParser parser = p_emptyJSONParser();
+    int status = 0;
+
+    JSONObject json = o_parseJSONObject(plain);
+    status |= checkObjectIteration(&json, "object", 0);
+    status |= checkArrayIteration(&o_cref(&json, "k2")->array, "array", 0);
+    o_compact(&json);
+    status |= checkObjectIteration(&json, "compacted object", LIBJSON_COMPACT);
+    status |= checkArrayIteration(&o_cref(&json, "k2")->array, "compacted array", LIBJSON_COMPACT);
+    o_destroyJSONObject(&json);
+
+    parser.pack = true;
+    json = p_parseJSONObject(&parser, packed);
+    status |= checkArrayIteration(&o_cref(&json, "k0")->array, "packed array", LIBJSON_PACKED);
+    o_destroyJSONObject(&json);
+
+    parser.pack = false;
+    parser.share = true;
+    json = p_parseJSONObject(&parser, shaped);
+    JSONElement scratch;
+    for(int i=0; i<2; i++) {
+        status |= checkObjectIteration(&a_cref(&o_cref(&json, "k0")->array, i, &scratch)->object, "shaped object", LIBJSON_SHAPED);
+    }
+    o_destroyJSONObject(&json);
+    p_destroyJSONParser(&parser);
+
+    return status;
+}
+
 int main(int argc, char** argv) {
     char* raw = NULL;
-    char buf[1024] = {0};
+    char* mode = "";
 
     FILE* fp = stdin;
 
+    if(argc == 2 && strcmp(argv[1], "-deep") == 0) {
+        return testDeep();
+    }
+    if(argc == 2 && strcmp(argv[1], "-format") == 0) {
+        return testFormat();
+    }
+    if(argc == 2 && strcmp(argv[1], "-project") == 0) {
+        return testProject();
+    }
+    if(argc == 2 && strcmp(argv[1], "-escape") == 0) {
+        return testEscape();
+    }
+    if(argc == 2 && strcmp(argv[1], "-iterate") == 0) {
+        return testIterate();
+    }
+
+    if(argc > 1 && argv[1][0] == '-') {
+        mode = argv[1];
+        argc--;
+        argv++;
+    }
+
     if(argc > 1) {
         if(argc > 2) {
-            printf("Usage: ./libjsontest filename.json\n");
+            printf("Usage: ./libjsontest [mode] filename.json\n");
+            printf("       ./libjsontest -deep\n");
+            printf("       ./libjsontest -format\n");
+            printf("       ./libjsontest -project\n");
+            printf("       ./libjsontest -escape\n");
+            printf("       ./libjsontest -iterate\n");
+            printf("Modes: -patch -cache -validate -pack -share -table -raw -reuse -intern -compact -write\n");
             return 1;
         }
         if(!(fp = fopen(argv[1], "r"))) {
@@ -17,23 +916,101 @@ int main(int argc, char** argv) {
             return 1;
         }
     }
-    
-    while(fgets(buf, 1023, fp)) {
-        raw = libjson_extendString(raw, strlen(buf));
-        strcat(raw, buf);
-    }
+
+    raw = readFile(fp);
     if(argc == 2) {
         fclose(fp);
     }
-    
-    JSONObject json = o_parseJSONObject(raw);
+    if(!raw) {
+        printf("Ran out of memory reading json\n");
+        return 1;
+    }
+
+    JSONParser parser = p_emptyJSONParser();
+    parser.pack = strcmp(mode, "-pack") == 0;
+    parser.share = strcmp(mode, "-share") == 0;
+    parser.raw = strcmp(mode, "-raw") == 0;
+    parser.reuse = strcmp(mode, "-reuse") == 0;
+    parser.intern = strcmp(mode, "-intern") == 0;
+
+#ifdef LIBJSON_POOL
+    // The blocks this document frees are handed out again to the next one
+    JSONObject first = p_parseJSONObject(&parser, raw);
+    o_destroyJSONObject(&first);
+#endif
+
+    // A reused parser builds each document over the memory of the one before it
+    JSONObject json = p_parseJSONObject(&parser, raw);
+    if(parser.reuse && parser.error.kind == errorNone) {
+        json = p_parseJSONObject(&parser, raw);
+    }
+    if(parser.error.kind != errorNone) {
+        printf("Failed to parse %s: %s at %d\n", argv[1], v_errorMessage(parser.error.kind), parser.error.offset);
+    }
+
+    // Each mode must leave the document serializing exactly as it was parsed
+    if(strcmp(mode, "-patch") == 0 && !patchUnchanged(&json, raw)) {
+        printf("Failed to patch %s\n", argv[1]);
+    }
+
+    if(strcmp(mode, "-table") == 0) {
+        JSONElement root = {.type = object, .flags = 0, .object = json};
+        roundTripTables(&root);
+        json = root.object;
+    }
+
+    if(parser.reuse && !modifyReused(&json)) {
+        printf("Modified a reused document\n");
+    }
+
+    if(strcmp(mode, "-compact") == 0 && !compactTwice(&json)) {
+        printf("Failed to compact %s\n", argv[1]);
+    }
+
+    // The whole document is valid, and its first half ends too soon
+    if(strcmp(mode, "-validate") == 0) {
+        int length = strlen(raw);
+        JSONError error = v_validate(raw, length);
+        JSONError half = v_validate(raw, length/2);
+
+        if(error.kind != errorNone || half.kind != errorUnexpectedEnd) {
+            printf("Validated as %s, and half as %s\n", v_errorMessage(error.kind), v_errorMessage(half.kind));
+        }
+    }
     free(raw);
 
-    char* string = o_JSONObjectToString(json);
+    // Interned strings outlive the parser which made them
+    if(parser.intern) {
+        p_destroyJSONParser(&parser);
+        parser = p_emptyJSONParser();
+    }
+
+    char* string = NULL;
+    if(strcmp(mode, "-cache") == 0) {
+        string = cachedTwice(&json);
+    } else if(strcmp(mode, "-write") == 0) {
+        string = writtenTwice(&json);
+    } else {
+        string = o_JSONObjectToString(json);
+    }
 
     o_destroyJSONObject(&json);
 
-    printf("%s", string);
+    // Long strings and numbers at the root of a reused parser's json are freed with the parser
+    if(parser.reuse) {
+        parser.raw = true;
+        JSONObject scalar = p_parseJSONObject(&parser, "\"a string too long to be held within the value\"");
+        JSONArray number = p_parseJSONArray(&parser, "-12345678901234567890.123456789e-10");
+        if(parser.error.kind != errorUnexpectedCharacter || scalar.numberOfElements != 0 || number.numberOfElements != 0) {
+            printf("Parsed a string or number as a container\n");
+        }
+    }
+    p_destroyJSONParser(&parser);
+#ifdef LIBJSON_POOL
+    m_drainJSONPool();
+#endif
+
+    printf("%s", string ? string : "Cached or written output differs\n");
     free(string);
 
     return 0;
@@ -0,0 +1,89 @@
+#include "libjson.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace libjson::literals;
+
+/**
+ * Build, read and parse values through the C++ interface, including roots which aren't containers.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static int testValues() {
+    int status = 0;
+
+    libjson::Value built = libjson::Value::object();
+    libjson::Value list = libjson::Value::array();
+    list.push(1).push(2.5).push(std::string_view("a string too long to be held within the value")).push(nullptr);
+    built.set("list"_key, std::move(list)).set("flag", true).set("big", 9007199254740993LL);
+
+    libjson::String string = built.toString();
+    const char* expected = "{\"list\":[1,2.5,\"a string too long to be held within the value\",null],\"flag\":true,\"big\":9007199254740993}";
+    if(std::strcmp(string.get(), expected) != 0) {
+        std::printf("Built %s\n", string.get());
+        status = 1;
+    }
+    if(built["big"].asInt() != 9007199254740993LL || built["list"][1].asDouble() != 2.5 || built["list"][1].asInt() != 2
+            || built["list"][2].asString().size() != 45 || !built["list"][3].isNull() || built["missing"] || built["list"].size() != 4) {
+        std::printf("Read the built value wrongly\n");
+        status = 1;
+    }
+
+    // Packed and raw numbers are decoded through the same accessors
+    libjson::Parser packed(LIBJSON_MAX_DEPTH, true);
+    libjson::Document numbers = packed.parse("[1,-2,3.75]");
+    libjson::Parser raw(LIBJSON_MAX_DEPTH, false, false, true);
+    libjson::Document texts = raw.parse(" {\"n\":-123456789012,\"d\":0.5e1}");
+    if(!numbers || !texts || numbers[1].asInt() != -2 || numbers[2].asDouble() != 3.75
+            || texts["n"].asInt() != -123456789012LL || texts["d"].asDouble() != 5) {
+        std::printf("Read packed or raw numbers wrongly\n");
+        status = 1;
+    }
+
+    // Only objects and arrays can be the root
+    const char* scalars[] = {"\"string\"", "  42", "true", "null"};
+    for(const char* scalar : scalars) {
+        libjson::Document document = libjson::Document::parse(scalar);
+        if(document || document.error().kind != errorUnexpectedCharacter || !document.view().isNull()) {
+            std::printf("Parsed %s as a container\n", scalar);
+            status = 1;
+        }
+    }
+    libjson::Document blank = libjson::Document::parse(" \n");
+    if(blank || blank.error().kind != errorUnexpectedEnd || blank.error().offset != 2) {
+        std::printf("Parsed whitespace as a container\n");
+        status = 1;
+    }
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if(argc == 2 && std::strcmp(argv[1], "-values") == 0) {
+        return testValues();
+    }
+    if(argc != 2) {
+        std::printf("Usage: ./libjsontest_cpp filename.json\n");
+        std::printf("       ./libjsontest_cpp -values\n");
+        return 1;
+    }
+
+    std::ifstream file(argv[1]);
+    if(!file) {
+        std::printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    std::stringstream raw;
+    raw << file.rdbuf();
+
+    libjson::Document document = libjson::Document::parse(raw.str());
+    if(!document) {
+        std::printf("Failed to parse %s: %s at %d\n", argv[1], v_errorMessage(document.error().kind), document.error().offset);
+        return 1;
+    }
+
+    libjson::String string = document.toString();
+    std::printf("%s", string.get());
+    return 0;
+}
@@ -1,11 +1,83 @@
 #!/bin/sh
 
+# Every mode must serialize each document exactly as it was parsed, with and without the pool
+for test in ./libjsontest ./libjsontest_pool; do
+    for mode in "" -patch -cache -validate -pack -share -table -raw -reuse -intern -compact -write; do
+        for file in tests/*.json; do
+            $test $mode $file > testout/got/$file
+
+            if cmp --silent testout/got/$file testout/exp/$file; then
+                echo "\033[0;32m$test $file $mode\033[0m"
+            else
+                echo "\033[0;31m$test $file $mode\033[0m"
+            fi
+        done
+    done
+done
+
+if ./libjsontest -deep > testout/got/deep.txt; then
+    echo "\033[0;32m-deep\033[0m"
+else
+    echo "\033[0;31m-deep\033[0m"
+fi
+
+if ./libjsontest -format; then
+    echo "\033[0;32m-format\033[0m"
+else
+    echo "\033[0;31m-format\033[0m"
+fi
+
+if ./libjsontest -project; then
+    echo "\033[0;32m-project\033[0m"
+else
+    echo "\033[0;31m-project\033[0m"
+fi
+
+if ./libjsontest -iterate; then
+    echo "\033[0;32m-iterate\033[0m"
+else
+    echo "\033[0;31m-iterate\033[0m"
+fi
+
+# Escapes round trip whether characters outside of ASCII are written as UTF-8 or as \u escapes
+for test in ./libjsontest ./libjsontest_unicode; do
+    if $test -escape; then
+        echo "\033[0;32m$test -escape\033[0m"
+    else
+        echo "\033[0;31m$test -escape\033[0m"
+    fi
+done
+
+# Batches load every file as parsing it alone does, through io_uring and through pread, and report the missing one
+expected=$(for file in tests/*.json; do echo "$file: No error"; done; echo "tests/missing.json: Couldn't read json"; echo "1 of $(($(ls tests/*.json | wc -l)+1)) couldn't be loaded")
+for test in ./libjsonbatchtest ./libjsonbatchtest_pread; do
+    if [ "$($test tests/*.json tests/missing.json)" = "$expected" ]; then
+        echo "\033[0;32m$test tests/*.json tests/missing.json\033[0m"
+    else
+        echo "\033[0;31m$test tests/*.json tests/missing.json\033[0m"
+    fi
+done
+
+# The C++ wrappers serialize each document as libjson does, and build, read and reject values
 for file in tests/*.json; do
-    ./libjsontest $file > testout/got/$file
+    ./libjsontest_cpp $file > testout/got/$file
 
     if cmp --silent testout/got/$file testout/exp/$file; then
-        echo "\033[0;32m$file\033[0m"
+        echo "\033[0;32m./libjsontest_cpp $file\033[0m"
     else
-        echo "\033[0;31m$file\033[0m"
+        echo "\033[0;31m./libjsontest_cpp $file\033[0m"
     fi
-done
\ No newline at end of file
+done
+
+if ./libjsontest_cpp -values; then
+    echo "\033[0;32m./libjsontest_cpp -values\033[0m"
+else
+    echo "\033[0;31m./libjsontest_cpp -values\033[0m"
+fi
+
+# Code generated from a schema reads the inventory and writes it back out as libjson does
+if ./libjsongentest tests/inventory.json > testout/got/inventory.json && cmp --silent testout/got/inventory.json testout/exp/tests/inventory.json; then
+    echo "\033[0;32m./libjsongentest tests/inventory.json\033[0m"
+else
+    echo "\033[0;31m./libjsongentest tests/inventory.json\033[0m"
+fi
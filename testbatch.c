@@ -0,0 +1,111 @@
+#include "libjson_batch.h"
+#include <string.h>
+
+#define BATCH_THREADS 4
+
+/**
+ * What loading one file produced.
+ */
+typedef struct BatchResult {
+    char* string;     /**< The file as parsed, converted back to a string, or NULL if it wasn't passed on. */
+    JSONError error;  /**< Why the file couldn't be read or parsed, or errorNone. */
+    int calls;        /**< How many times the file was passed on. */
+} BatchResult;
+
+/**
+ * Read the rest of a file into a string.
+ * @warning Return value should be freed when no longer needed.
+ *
+ * @param fp The file to read.
+ * @return The contents of the file, or NULL if there isn't enough memory.
+ */
+static char* readFile(FILE* fp) {
+    char* raw = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+
+    while(true) {
+        if(length+1 >= capacity) {
+            capacity = capacity ? capacity*2 : 4096;
+            char* tmp = (char*)realloc(raw, capacity);
+            if(!tmp) {
+                free(raw);
+                return NULL;
+            }
+            raw = tmp;
+        }
+
+        size_t read = fread(raw+length, 1, capacity-length-1, fp);
+        if(read == 0) {
+            break;
+        }
+        length += read;
+    }
+    raw[length] = '\0';
+
+    return raw;
+}
+
+/**
+ * Keep what loading a file produced, converted to a string.
+ *
+ * @param index   The index of the file's path.
+ * @param path    The file's path.
+ * @param json    The parsed file.
+ * @param error   Why the file couldn't be read or parsed, or errorNone.
+ * @param context The BatchResults, one per path.
+ */
+static void keepResult(int index, const char* path, JSONObject json, JSONError error, void* context) {
+    BatchResult* result = &((BatchResult*)context)[index];
+    (void)path;
+
+    result->string = o_JSONObjectToString(json);
+    result->error = error;
+    __atomic_fetch_add(&result->calls, 1, __ATOMIC_RELAXED);
+    o_destroyJSONObject(&json);
+}
+
+/**
+ * Load files in a batch, then check that each was passed on once, as reading and parsing it alone would.
+ * Prints each path with its error, then how many files couldn't be loaded.
+ */
+int main(int argc, char** argv) {
+    int numberOfPaths = argc-1;
+    BatchResult* results = (BatchResult*)calloc(numberOfPaths > 0 ? numberOfPaths : 1, sizeof(BatchResult));
+    int errors = 0;
+
+    if(!results || !b_loadJSONObjects(argv+1, numberOfPaths, BATCH_THREADS, keepResult, results)) {
+        printf("Failed to load a batch\n");
+        return 1;
+    }
+
+    for(int i=0; i<numberOfPaths; i++) {
+        FILE* fp = fopen(argv[i+1], "r");
+        char* raw = fp ? readFile(fp) : NULL;
+        char* expected = NULL;
+
+        if(raw) {
+            JSONObject json = o_parseJSONObject(raw);
+            expected = o_JSONObjectToString(json);
+            o_destroyJSONObject(&json);
+        }
+
+        if(results[i].calls != 1 || (raw && strcmp(results[i].string, expected) != 0)) {
+            printf("%s: Loaded differently\n", argv[i+1]);
+        } else {
+            printf("%s: %s\n", argv[i+1], v_errorMessage(results[i].error.kind));
+        }
+        errors += results[i].error.kind != errorNone;
+
+        free(expected);
+        free(raw);
+        free(results[i].string);
+        if(fp) {
+            fclose(fp);
+        }
+    }
+    printf("%d of %d couldn't be loaded\n", errors, numberOfPaths);
+
+    free(results);
+    return 0;
+}
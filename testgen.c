@@ -0,0 +1,94 @@
+#include "inventory.h"
+
+/**
+ * Read the rest of a file into a string.
+ * @warning Return value should be freed when no longer needed.
+ *
+ * @param fp The file to read.
+ * @return The contents of the file, or NULL if there isn't enough memory.
+ */
+static char* readFile(FILE* fp) {
+    char* raw = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+
+    while(true) {
+        if(length+1 >= capacity) {
+            capacity = capacity ? capacity*2 : 4096;
+            char* tmp = (char*)realloc(raw, capacity);
+            if(!tmp) {
+                free(raw);
+                return NULL;
+            }
+            raw = tmp;
+        }
+
+        size_t read = fread(raw+length, 1, capacity-length-1, fp);
+        if(read == 0) {
+            break;
+        }
+        length += read;
+    }
+    raw[length] = '\0';
+
+    return raw;
+}
+
+/**
+ * Check that a generated decoder rejects a quantity which isn't an int.
+ *
+ * @param quantity The json of the quantity.
+ * @return If the inventory holding it was rejected, true. Otherwise, false.
+ */
+static bool rejects(const char* quantity) {
+    char json[128] = {0};
+    snprintf(json, sizeof(json), "{\"inventory\":[{\"quantity\":%s}]}", quantity);
+
+    Inventory inventory;
+    bool parsed = parseInventory(json, &inventory);
+    destroyInventory(&inventory);
+
+    if(parsed) {
+        printf("Parsed %s as an int\n", quantity);
+    }
+    return !parsed;
+}
+
+/**
+ * Parse an inventory with the code libjsongen generated for tests/schemas/inventory.json,
+ * and print it back out, after checking that ints which are fractional or too big are rejected.
+ */
+int main(int argc, char** argv) {
+    FILE* fp = argc == 2 ? fopen(argv[1], "r") : NULL;
+    if(!fp) {
+        printf("Usage: ./libjsongentest inventory.json\n");
+        return 1;
+    }
+
+    char* raw = readFile(fp);
+    fclose(fp);
+    if(!raw) {
+        printf("Ran out of memory reading json\n");
+        return 1;
+    }
+
+    int status = 0;
+    status |= !rejects("2.5");
+    status |= !rejects("1e3");
+    status |= !rejects("99999999999999999999");
+    status |= !rejects("-99999999999999999999");
+
+    Inventory inventory;
+    if(parseInventory(raw, &inventory)) {
+        char* string = InventoryToString(&inventory);
+        printf("%s", string);
+        free(string);
+    } else {
+        printf("Failed to parse %s\n", argv[1]);
+        status = 1;
+    }
+    destroyInventory(&inventory);
+    free(raw);
+
+    return status;
+}